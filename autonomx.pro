@@ -14,3 +14,9 @@ sub_test_autonomx.target = sub_test_autonomx
 sub_test_autonomx.depends += sub_autonomx
 SUBDIRS += test_autonomx
 
+
+# bench_autonomx:
+sub_bench_autonomx.subdir = bench_autonomx
+sub_bench_autonomx.target = sub_bench_autonomx
+sub_bench_autonomx.depends += sub_autonomx
+SUBDIRS += bench_autonomx
@@ -14,12 +14,24 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <QDebug>
+#include <QFile>
+#include <QSettings>
 
 #include "AppModel.h"
 #include "SpikingNet.h"
 #include "WolframCA.h"
 #include "GameOfLife.h"
 
+bool AppModel::headless = false;
+
+void AppModel::setHeadless(bool headless) {
+    AppModel::headless = headless;
+}
+
+bool AppModel::isHeadless() {
+    return headless;
+}
+
 AppModel::AppModel() {
     if(flagDebug) {
         qDebug() << "constructor (AppModel): initializing lists";
@@ -42,7 +54,9 @@ AppModel::AppModel() {
     }
 
     // init data (unique elements)
-    generatorModel = QSharedPointer<GeneratorModel>(new GeneratorModel(generatorFacadesList, generatorFacadesHashMap));
+    if(!headless) {
+        generatorModel = QSharedPointer<GeneratorModel>(new GeneratorModel(generatorFacadesList, generatorFacadesHashMap));
+    }
 
     if(flagDebug) {
         qDebug() << "constructor (AppModel): initializing generatorMetaModel";
@@ -62,7 +76,10 @@ AppModel::AppModel() {
     // init engines
     computeEngine = QSharedPointer<ComputeEngine>(new ComputeEngine(generatorsList, generatorsHashMap));
     oscEngine = QSharedPointer<OscEngine>(new OscEngine());
-    oscEngineFacade = QSharedPointer<OscEngineFacade>(new OscEngineFacade(oscEngine));
+    if(!headless) {
+        oscEngineFacade = QSharedPointer<OscEngineFacade>(new OscEngineFacade(oscEngine));
+        statsFacade = QSharedPointer<StatsFacade>(new StatsFacade(computeEngine));
+    }
 
     if(flagDebug) {
         qDebug() << "constructor (AppModel): initializing threads";
@@ -76,11 +93,12 @@ AppModel::AppModel() {
         qDebug() << "constructor (AppModel): connecting engines";
     }
 
-    // connect compute engine data output to osc engine
-    connect(computeEngine.data(), &ComputeEngine::sendOscData, oscEngine.data(), &OscEngine::sendOscData, Qt::QueuedConnection);
+    // connect compute engine data output to osc engine. the frames themselves go through the queue, the signal only wakes up oscThread
+    oscEngine->setOutputQueue(computeEngine->getOutputQueue());
+    connect(computeEngine.data(), &ComputeEngine::outputFramesReady, oscEngine.data(), &OscEngine::drainOutputFrames, Qt::QueuedConnection);
 
-    // connect osc engine data reception to compute engine
-    connect(oscEngine.data(), &OscEngine::receiveOscData, computeEngine.data(), &ComputeEngine::receiveOscData, Qt::QueuedConnection);
+    // connect compute engine timings to osc engine, which replies to /autonomx/stats requests with them
+    connect(computeEngine.data(), &ComputeEngine::statsUpdated, oscEngine.data(), &OscEngine::updateStats, Qt::QueuedConnection);
 
     // connect signal for adding a generator to the data structures
     connect(this, &AppModel::addGenerator, computeEngine.data(), &ComputeEngine::addGenerator);
@@ -98,6 +116,15 @@ AppModel::AppModel() {
         qDebug() << "constructor (AppModel): starting computeThread";
     }
 
+    // loop settings saved in the application settings, see ComputeEngine::writeSettings. the headless command line can override them
+    QSettings settings;
+    settings.beginGroup("engine");
+    QVariantMap engineSettings;
+    for(const QString& key : settings.childKeys()) {
+        engineSettings.insert(key, settings.value(key));
+    }
+    computeEngine->writeSettings(engineSettings);
+
     computeThread->start(QThread::TimeCriticalPriority);
     computeEngine->moveToThread(computeThread.data());
 
@@ -137,6 +164,10 @@ QSharedPointer<OscEngineFacade> AppModel::getOscEngineFacade() const
     return oscEngineFacade;
 }
 
+QSharedPointer<StatsFacade> AppModel::getStatsFacade() const {
+    return statsFacade;
+}
+
 QSharedPointer<Generator> AppModel::createGenerator(QString type) {
     return createGenerator(type, true);
 }
@@ -148,12 +179,9 @@ QSharedPointer<Generator> AppModel::createGenerator(QString type, bool initRegio
     }
     // find a free ID for the new generator
     // create a temporary list of taken IDs
-    // we do this instead of using generatorsList because we will want to sort it, and this is thread-unsafe since computeEngine might be iterating generators it at any time
-    QList<int> takenIDs;
-    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-        int takenID = (*it)->getID();
-        takenIDs.append(takenID);
-    }
+    // we do this instead of using generatorsList because we will want to sort it, and this is thread-unsafe since computeEngine might be iterating generators it at any time.
+    // generatorsList is also only updated once computeThread gets to it, so generators created in a row (when loading a project) wouldn't see each other
+    QList<int> takenIDs = generatorsByID.keys();
     // we sort the taken IDs
     std::sort(takenIDs.begin(), takenIDs.end());
     // we search for a free ID by looking through the sorted taken IDs, incrementing the next ID if it is already taken
@@ -183,6 +211,8 @@ QSharedPointer<Generator> AppModel::createGenerator(QString type, bool initRegio
         generator = QSharedPointer<Generator>(new GameOfLife(nextID, generatorMetaModel->at("GameOfLife")));
     }
 
+    generatorsByID.insert(nextID, generator);
+
     // initialize regions
     if (initRegions)
         generator->initializeRegionSets();
@@ -211,6 +241,11 @@ QSharedPointer<Generator> AppModel::createGenerator(QString type, bool initRegio
     // we setup the osc engine to process data for the generator
     emit startGeneratorOsc(generator);
 
+    // nothing else is needed without a user interface
+    if(headless) {
+        return generator;
+    }
+
     if(flagDebug) {
         qDebug() << "createGenerator (AppModel): begin insertion at end of generatorModel";
     }
@@ -253,7 +288,11 @@ void AppModel::deleteGenerator(int id) {
     if(flagDebug) {
         qDebug() << "deleteGenerator (AppModel): getting generator by id: " << id;
     }
-    QSharedPointer<Generator> generator = generatorsHashMap->value(id);
+    QSharedPointer<Generator> generator = generatorsByID.value(id);
+    if(generator.isNull()) {
+        qWarning() << "deleteGenerator (AppModel): no generator with id" << id;
+        return;
+    }
 
     if(flagDebug) {
         qDebug() << "deleteGenerator (AppModel): removing generator from data structures later on computeThread";
@@ -270,6 +309,13 @@ void AppModel::deleteGenerator(int id) {
     // we ask the osc engine to stop processing data for this generator
     emit stopGeneratorOsc(generator);
 
+    generatorsByID.remove(id);
+
+    // nothing else is needed without a user interface
+    if(headless) {
+        return;
+    }
+
     if(flagDebug) {
         qDebug() << "createGenerator (AppModel): begin removal at specific id in generatorModel";
     }
@@ -319,8 +365,8 @@ bool AppModel::loadProject(QString uri)
 {
     // parse URI
     QUrl url(uri);
-    // create QFile at URI
-    QFile loadFile(url.toLocalFile());
+    // create QFile at URI. this is shared with the restoration of the generator states on computeThread, which reads from its mapping
+    QSharedPointer<QFile> loadFile(new QFile(url.toLocalFile()));
 
     // check validity of file contents;
     // we are reading from a binary MIME type
@@ -333,22 +379,55 @@ bool AppModel::loadProject(QString uri)
     }
 
     // try to open file
-    if (!loadFile.open(QIODevice::ReadOnly)) {
+    if (!loadFile->open(QIODevice::ReadOnly)) {
         qWarning() << "Couldn't open save file:" << uri;
         return false;
     }
 
-    // read file
-    QByteArray saveData = loadFile.readAll();
+    // map file, so that the states of large generators are copied from the page cache directly. read it if it can't be mapped
+    qint64 fileSize = loadFile->size();
+    const uchar* fileData = fileSize > 0 ? loadFile->map(0, fileSize) : nullptr;
+    QByteArray fileCopy;
+    if (fileData == nullptr) {
+        fileCopy = loadFile->readAll();
+        fileData = reinterpret_cast<const uchar*>(fileCopy.constData());
+        fileSize = fileCopy.size();
+    }
+
+    // the CBOR data is followed by the generator states, if the project was saved with them
+    QHash<int, QPair<qint64, qint64>> states;
+    qint64 cborSize = StateSnapshot::read(fileData, fileSize, states);
+
     // convert to JSON document
+    QByteArray saveData = QByteArray::fromRawData(reinterpret_cast<const char*>(fileData), cborSize);
     QJsonDocument loadDoc(QCborValue::fromCbor(saveData).toMap().toJsonObject());
 
     // read data
-    if (!readJson(loadDoc.object())) {
+    QList<QSharedPointer<Generator>> generators;
+    if (!readJson(loadDoc.object(), &generators)) {
         qWarning() << "Could not load project.";
         return false;
     };
 
+    // restore the generator states on computeThread. this is queued after the generators are added there, and after their parameters
+    // are applied, so each generator can check the state against them. states are found by the id the generator had when it was saved
+    QJsonArray generatorsData = loadDoc.object()["generators"].toArray();
+    for (int i = 0; i < generators.size(); i++) {
+        int savedId = generatorsData[i].toObject()["id"].toInt(-1);
+        if (!states.contains(savedId)) {
+            continue;
+        }
+
+        QSharedPointer<Generator> generator = generators[i];
+        QPair<qint64, qint64> state = states.value(savedId);
+        QMetaObject::invokeMethod(generator.data(), [generator, loadFile, fileCopy, fileData, state]() {
+            StateReader reader(fileData + state.first, state.second);
+            if (!generator->readState(reader)) {
+                qWarning() << "saved state of generator" << generator->getID() << "doesn't match its parameters, it starts from scratch.";
+            }
+        }, Qt::QueuedConnection);
+    }
+
     // success!
     return true;
 }
@@ -374,8 +453,29 @@ bool AppModel::saveProject(QString uri) {
         return false;
     }
 
-    // save to file
-    saveFile.write(QCborValue::fromJsonValue(saveObject).toCbor());
+    // the generator states are written on computeThread, between frames, since the generators are being computed there
+    QList<QPair<int, QByteArray>> states;
+    auto writeStates = [this, &states]() {
+        for (QSharedPointer<Generator> g : *generatorsList) {
+            StateWriter writer;
+            g->writeState(writer);
+            if (!writer.getData().isEmpty()) {
+                states.append(QPair<int, QByteArray>(g->getID(), writer.getData()));
+            }
+        }
+    };
+    if (QThread::currentThread() == computeThread.data()) {
+        writeStates();
+    } else {
+        QMetaObject::invokeMethod(computeEngine.data(), writeStates, Qt::BlockingQueuedConnection);
+    }
+
+    // save to file, followed by the states
+    QByteArray saveData = QCborValue::fromJsonValue(saveObject).toCbor();
+    if (saveFile.write(saveData) != saveData.size() || !StateSnapshot::write(saveFile, saveData.size(), states)) {
+        qWarning() << "Error writing to save file.";
+        return false;
+    }
 
     // success
     return true;
@@ -398,7 +498,7 @@ QSharedPointer<GeneratorMetaModel> AppModel::getGeneratorMetaModel() const
     return generatorMetaModel;
 }
 
-bool AppModel::readJson(const QJsonObject &json)
+bool AppModel::readJson(const QJsonObject &json, QList<QSharedPointer<Generator>>* createdGenerators)
 {
     // version check
     const QString version = QCoreApplication::applicationVersion();
@@ -421,6 +521,10 @@ bool AppModel::readJson(const QJsonObject &json)
 
         // send save data to Generator function
         generator->readJson(generatorData);
+
+        if (createdGenerators != nullptr) {
+            createdGenerators->append(generator);
+        }
     }
 
     // success
@@ -453,7 +557,9 @@ bool AppModel::writeJson(QJsonObject &json) const
 
 void AppModel::deleteAllGenerators()
 {
-    for (QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-        deleteGenerator((*it)->getID());
+    // iterate on a copy, since deleteGenerator removes ids from generatorsByID
+    QList<int> ids = generatorsByID.keys();
+    for (QList<int>::iterator it = ids.begin(); it != ids.end(); it++) {
+        deleteGenerator(*it);
     }
 }
@@ -24,6 +24,7 @@
 #include "ComputeEngine.h"
 #include "OscEngine.h"
 #include "OscEngineFacade.h"
+#include "StatsFacade.h"
 #include "Generator.h"
 #include "GeneratorFacade.h"
 #include "GeneratorModel.h"
@@ -36,6 +37,12 @@ public:
         static AppModel instance;
         return instance;
     }
+
+    // in headless mode, only the engines and their threads are created: no GeneratorModel, GeneratorFacade or other facades exist,
+    // and the corresponding getters return null pointers. this must be called before the first call to getInstance
+    static void setHeadless(bool headless);
+    static bool isHeadless();
+
     // these return shared pointers to avoid threading issues related to the deletion of these objects.
     // be careful! whenever a Generator or GeneratorFacade is accessed through one of these, the reference must go out of scope when the generator is removed so that the objects are actually deleted.
     QSharedPointer<QThread>             getComputeThread() const;
@@ -43,12 +50,14 @@ public:
     QSharedPointer<ComputeEngine>       getComputeEngine() const;
     QSharedPointer<OscEngine>           getOscEngine() const;
     QSharedPointer<OscEngineFacade>     getOscEngineFacade() const;
+    QSharedPointer<StatsFacade>         getStatsFacade() const;
     QSharedPointer<Generator>           getGenerator(int id) const;
     QSharedPointer<GeneratorFacade>     getGeneratorFacade(int id) const;
     QSharedPointer<GeneratorModel>      getGeneratorModel() const;
     QSharedPointer<GeneratorMetaModel>  getGeneratorMetaModel() const;
 
-    bool                                readJson(const QJsonObject &json);
+    // createdGenerators receives the generators created from the project, in the order of its "generators" array
+    bool                                readJson(const QJsonObject &json, QList<QSharedPointer<Generator>>* createdGenerators = nullptr);
     bool                                writeJson(QJsonObject &json) const;
 
     void                                deleteAllGenerators();
@@ -81,13 +90,18 @@ private:
     QSharedPointer<ComputeEngine> computeEngine;
     QSharedPointer<OscEngine> oscEngine;
     QSharedPointer<OscEngineFacade> oscEngineFacade;
+    QSharedPointer<StatsFacade> statsFacade;
 
     // threads
     QSharedPointer<QThread> computeThread;
     QSharedPointer<QThread> oscThread;
 
+    // generators created and not deleted yet, by id. generatorsList and generatorsHashMap can't be used from the main thread since they are only updated later on computeThread
+    QHash<int, QSharedPointer<Generator>> generatorsByID;
+
     // utility variables
     bool flagDebug = false;
+    static bool headless;
 signals:
     // connects to ComputeEngine::addGenerator for safe addition of generators to data structures
     void addGenerator(QSharedPointer<Generator> generator);
@@ -0,0 +1,43 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+#include <algorithm>
+
+// spans of cells in the bit-packed rows of the automata (GameOfLife, WolframCA): cell x of a row is bit x % 64 of word x / 64
+
+// writes the cells [x, x + count) of row as 0 or 1 in values
+static inline void readBits(const quint64* row, int x, int count, float* values) {
+    for(int i = 0; i < count; i++) {
+        values[i] = (row[(x + i) / 64] >> ((x + i) % 64)) & 1;
+    }
+}
+
+// sets or clears the cells [x, x + count) of row, a word at a time, masked to the cells of the span in the first and last word
+static inline void fillBits(quint64* row, int x, int count, bool set) {
+    int end = x + count;
+    for(int w = x / 64; w * 64 < end; w++) {
+        int first = std::max(x - w * 64, 0);
+        int last = std::min(end - w * 64, 64);
+        quint64 mask = (last == 64 ? ~(quint64) 0 : ((quint64) 1 << last) - 1) & ~(((quint64) 1 << first) - 1);
+        if(set) {
+            row[w] |= mask;
+        } else {
+            row[w] &= ~mask;
+        }
+    }
+}
@@ -17,11 +17,21 @@
 #include <chrono>
 #include <QDebug>
 #include <QThread>
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QDataStream>
 
 #include "ComputeEngine.h"
+#include "DeadlineClock.h"
 #include "AppModel.h"
 
-ComputeEngine::ComputeEngine(QSharedPointer<QList<QSharedPointer<Generator>>> generatorsList, QSharedPointer<QHash<int, QSharedPointer<Generator>>> generatorsHashMap) : randomUniform(0.0, 1.0) {
+// tick rate of a generator as the scheduler uses it. the schedule and the time step of the iterations must agree, or the simulation drifts
+static double clampedTickRate(const Generator* generator) {
+    return std::min<double>(1000.0, std::max<double>(0.01, generator->getTickRate()));
+}
+
+ComputeEngine::ComputeEngine(QSharedPointer<QList<QSharedPointer<Generator>>> generatorsList, QSharedPointer<QHash<int, QSharedPointer<Generator>>> generatorsHashMap) : stopRequested(false), randomUniform(0.0, 1.0) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
@@ -32,6 +42,13 @@ ComputeEngine::ComputeEngine(QSharedPointer<QList<QSharedPointer<Generator>>> ge
 
     this->generatorsList = generatorsList;
     this->generatorsHashMap = generatorsHashMap;
+
+    // leave a core for the main thread and oscThread, computeThread itself takes part in the computation
+    int workerCount = flagParallelCompute ? std::max(0, QThread::idealThreadCount() - 2) : 0;
+    workerPool = QSharedPointer<ComputeWorkerPool>(new ComputeWorkerPool(workerCount));
+
+    // a few frames of every generator, in case oscThread falls behind for a moment
+    outputQueue = QSharedPointer<OutputFrameQueue>(new OutputFrameQueue(1024));
 }
 
 ComputeEngine::~ComputeEngine() {
@@ -44,45 +61,6 @@ ComputeEngine::~ComputeEngine() {
     }
 }
 
-void ComputeEngine::receiveOscData(int id, QVariantList data) {
-    if(!generatorsHashMap->contains(id)) {
-        throw std::runtime_error("generator does not exist");
-    }
-    QSharedPointer<Generator> generator = generatorsHashMap->value(id);
-
-    QList<QVariant> dataAsList = data;
-
-    int argumentsTotal = data.size();
-    int argumentsValid = 0;
-
-    for(int i = 0; i < generator->getInputRegionSet()->rowCount(); i++) {
-        // set default to 0
-        double input = 0;
-        // check that the message's list is long enough
-        if(i < data.size()) {
-            // check the message's type can be cast to double
-            QMetaType::Type type = (QMetaType::Type) dataAsList.at(i).type();
-            if(type == QMetaType::Float || type == QMetaType::Double || type == QMetaType::Int || type == QMetaType::Long) {
-                input = dataAsList.at(i).toDouble();
-                argumentsValid++;
-            }
-        }
-        // write to input
-        generator->getInputRegionSet()->at(i)->writeIntensity(input);
-    }
-
-    // alerts loop that new value was received via inputOSC and can be reflected in lattice
-    inputValueReceived = true;
-
-    if(flagDebug) {
-        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                    std::chrono::system_clock::now().time_since_epoch()
-        );
-
-        qDebug() << "receiveOscData (ComputeEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << id << "\tdata = " << data << "\t(" << argumentsValid << " of " << argumentsTotal << " valid)";
-    }
-}
-
 void ComputeEngine::addGenerator(QSharedPointer<Generator> generator) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
@@ -94,6 +72,21 @@ void ComputeEngine::addGenerator(QSharedPointer<Generator> generator) {
 
     generatorsList->append(generator);
     generatorsHashMap->insert(generator->getID(), generator);
+    generator->setWorkerPool(workerPool);
+
+    // the first iteration is due right away
+    qint64 deadline = DeadlineClock::now();
+    generatorDeadlines.insert(generator->getID(), deadline);
+    schedule.push({deadline, generator->getID()});
+
+    // the rate of GameOfLife and WolframCA also follows timeScale
+    int id = generator->getID();
+    connect(generator.data(), &Generator::tickRateChanged, this, [this, id]() {
+        rescheduleGenerator(id);
+    });
+    connect(generator.data(), &Generator::timeScaleChanged, this, [this, id]() {
+        rescheduleGenerator(id);
+    });
 }
 
 void ComputeEngine::removeGenerator(QSharedPointer<Generator> generator) {
@@ -107,6 +100,26 @@ void ComputeEngine::removeGenerator(QSharedPointer<Generator> generator) {
 
     generatorsList->removeOne(generator);
     generatorsHashMap->remove(generator->getID());
+    generatorCosts.remove(generator->getID());
+    truncatedOutputs.remove(generator->getID());
+
+    // the entry left in schedule is discarded when it is popped
+    generatorDeadlines.remove(generator->getID());
+    disconnect(generator.data(), nullptr, this, nullptr);
+    generator->setWorkerPool(QSharedPointer<ComputeWorkerPool>());
+}
+
+void ComputeEngine::rescheduleGenerator(int id) {
+    if(!generatorDeadlines.contains(id)) {
+        return;
+    }
+
+    // a lower rate applies from the deadline already scheduled on
+    qint64 deadline = DeadlineClock::now() + (qint64) (1000000000.0 / clampedTickRate(generatorsHashMap->value(id).data()));
+    if(deadline < generatorDeadlines.value(id)) {
+        generatorDeadlines.insert(id, deadline);
+        schedule.push({deadline, id});
+    }
 }
 
 void ComputeEngine::start() {
@@ -117,12 +130,237 @@ void ComputeEngine::start() {
     timer.singleShot(0, this, &ComputeEngine::loop);
 }
 
+void ComputeEngine::stop() {
+    // this is called from an external thread. the loop picks it up at the next frame and returns to computeThread's event loop
+    stopRequested.store(true);
+}
+
+void ComputeEngine::writeFrequency(double frequency) {
+    // the loop picks up the new period on its next frame
+    this->frequency = std::min<double>(1000.0, std::max<double>(1.0, frequency));
+}
+
+void ComputeEngine::writeCatchUpPolicy(CatchUpPolicy catchUpPolicy) {
+    this->catchUpPolicy = catchUpPolicy;
+}
+
+void ComputeEngine::writeInputPolicy(InputPolicy inputPolicy) {
+    this->inputPolicy = inputPolicy;
+}
+
+void ComputeEngine::writeSettings(const QVariantMap& settings) {
+    if(settings.contains("frequency")) {
+        writeFrequency(settings.value("frequency").toDouble());
+    }
+
+    if(settings.contains("catchUpPolicy")) {
+        QString catchUpPolicy = settings.value("catchUpPolicy").toString();
+        if(catchUpPolicy == "skip") {
+            writeCatchUpPolicy(CatchUpPolicy::Skip);
+        } else if(catchUpPolicy == "substep") {
+            writeCatchUpPolicy(CatchUpPolicy::Substep);
+        } else {
+            qWarning() << "unknown catch-up policy" << catchUpPolicy << "ignored, expected skip or substep";
+        }
+    }
+
+    if(settings.contains("inputPolicy")) {
+        QString inputPolicy = settings.value("inputPolicy").toString();
+        if(inputPolicy == "lastWins") {
+            writeInputPolicy(InputPolicy::LastWins);
+        } else if(inputPolicy == "frameAccurate") {
+            writeInputPolicy(InputPolicy::FrameAccurate);
+        } else {
+            qWarning() << "unknown input policy" << inputPolicy << "ignored, expected lastWins or frameAccurate";
+        }
+    }
+}
+
+QSharedPointer<OutputFrameQueue> ComputeEngine::getOutputQueue() const {
+    return outputQueue;
+}
+
+quint64 ComputeEngine::getMissedDeadlines() const {
+    return missedDeadlines;
+}
+
+qint64 ComputeEngine::getLatenessLast() const {
+    return latenessLast;
+}
+
+qint64 ComputeEngine::getLatenessMax() const {
+    return latenessMax;
+}
+
+double ComputeEngine::getLatenessMean() const {
+    return wakeups == 0 ? 0 : (double) latenessTotal / wakeups;
+}
+
 void ComputeEngine::loop() {
+    // this runs on computeThread until stop() is called. the thread's event queue isn't serviced by QThread::exec while this runs,
+    // so queued calls (property writes, lattice requests, generator addition / removal) are processed between frames instead
+    while(!stopRequested.load()) {
+        // the lateness of the generators is measured from here, so that the time spent on queued events isn't charged to them
+        qint64 wakeTime = DeadlineClock::now();
+
+        // process everything that was queued on computeThread since the last frame
+        QCoreApplication::processEvents(QEventLoop::AllEvents);
+
+        // generators rebuilt in the background switch to their new state here, never in the middle of a frame
+        for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+            (*it)->commitInitialize(false);
+        }
+
+        // only the generators that are due are computed, the others keep their state untouched until their next deadline
+        collectDueGenerators(wakeTime, DeadlineClock::now());
+        if(!frameGenerators.empty() && !flagDisableProcessing) {
+            computeFrame();
+        }
+        trimInputRings();
+
+        if(DeadlineClock::now() - statsLastPublished >= statsInterval) {
+            publishStats();
+        }
+
+        // sleep until the earliest deadline, but wake up at the loop frequency at least so that queued events don't wait on slow generators
+        qint64 nextWakeTime = DeadlineClock::now() + (qint64) (1000000000.0 / frequency);
+        if(!schedule.empty()) {
+            nextWakeTime = std::min(nextWakeTime, schedule.top().deadline);
+        }
+
+        DeadlineClock::sleepUntil(nextWakeTime);
+    }
+}
+
+void ComputeEngine::collectDueGenerators(qint64 wakeTime, qint64 now) {
+    frameGenerators.clear();
+    frameCosts.clear();
+    frameIterations.clear();
+    framePeriods.clear();
+    frameTime = now;
+
+    while(!schedule.empty() && schedule.top().deadline <= now) {
+        ScheduleEntry entry = schedule.top();
+        schedule.pop();
+
+        // stale entry, the generator was removed or rescheduled since
+        if(!generatorDeadlines.contains(entry.id) || generatorDeadlines.value(entry.id) != entry.deadline) {
+            continue;
+        }
+        Generator* generator = generatorsHashMap->value(entry.id).data();
+
+        // the tick rate is read every time so that parameter changes apply from the next deadline
+        qint64 period = (qint64) (1000000000.0 / clampedTickRate(generator));
+        // a deadline that passed while the events were processed isn't late
+        qint64 lateness = std::max<qint64>(0, wakeTime - entry.deadline);
+
+        // number of deadlines of this generator that passed entirely while the loop was busy
+        qint64 missed = (now - entry.deadline) / period;
+
+        latenessLast = lateness;
+        latenessMax = std::max(latenessMax, lateness);
+        latenessTotal += lateness;
+        missedDeadlines += missed;
+        wakeups++;
+
+        // with Substep, the generator runs the iterations it missed to stay on the clock, up to maxSubsteps so an overloaded engine can't spiral.
+        // with Skip, the missed iterations are dropped and the simulation slows down instead
+        int iterations = catchUpPolicy == CatchUpPolicy::Substep ? (int) std::min<qint64>(missed + 1, maxSubsteps) : 1;
+
+        // move to the next deadline on the generator's grid that is still in the future
+        qint64 deadline = entry.deadline + (missed + 1) * period;
+        generatorDeadlines.insert(entry.id, deadline);
+        schedule.push({deadline, entry.id});
+
+        frameGenerators.push_back(generator);
+        frameCosts.push_back(generatorCosts.value(entry.id, 0));
+        frameIterations.push_back(iterations);
+        framePeriods.push_back(period);
+
+        if(flagDebug) {
+            std::chrono::nanoseconds time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()
+            );
+
+            qDebug() << "collectDueGenerators (ComputeEngine):\tt = " << time.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << entry.id << "\tlateness (ms) = " << lateness / 1000000.0 << "\titerations = " << iterations;
+        }
+    }
+}
+
+void ComputeEngine::computeGenerator(Generator* generator, int iterations, qint64 period) {
+    GeneratorLatency* latency = generator->getLatency();
+    double deltaTime = 1.0 / clampedTickRate(generator);
+    qint64 computeTime = 0;
+
+    for(int i = 0; i < iterations; i++) {
+        qint64 time = DeadlineClock::now();
+
+        // apply the input values received before this iteration
+        if(applyInputFrames(generator, frameTime - (iterations - 1 - i) * period)) {
+            generator->applyInputRegion();
+
+            qint64 timePrevious = time;
+            time = DeadlineClock::now();
+            latency->input.record(time - timePrevious);
+        }
+
+        // do the computation
+        generator->computeIteration(deltaTime);
+        computeTime += DeadlineClock::now() - time;
+    }
+
+    latency->compute.record(computeTime);
+    qint64 time = DeadlineClock::now();
 
-    if(flagDisableProcessing) {
+    // apply output values
+    generator->applyOutputRegion();
+
+    latency->output.record(DeadlineClock::now() - time);
+}
+
+bool ComputeEngine::applyInputFrames(Generator* generator, qint64 time) {
+    InputFrameRing* inputRing = generator->getInputRing().data();
+
+    // frames are in reception order, so only the ones at the front can be due
+    const InputFrame* frame = inputRing->front();
+    if(frame == nullptr || frame->timestamp > time) {
+        return false;
+    }
+
+    if(inputPolicy == InputPolicy::LastWins) {
+        // skip to the newest frame received before time
+        const InputFrame* next;
+        while((next = inputRing->peek(1)) != nullptr && next->timestamp <= time) {
+            inputRing->pop();
+            frame = next;
+        }
+    }
+
+    // values missing from the message set the region to 0
+    GeneratorRegionSet* inputRegionSet = generator->getInputRegionSet();
+    for(int i = 0; i < inputRegionSet->rowCount(); i++) {
+        inputRegionSet->at(i)->writeIntensity(i < frame->count ? frame->values[i] : 0);
+    }
+
+    inputRing->pop();
+    return true;
+}
+
+void ComputeEngine::trimInputRings() {
+    if(inputPolicy != InputPolicy::LastWins) {
         return;
     }
 
+    // the workers are done at this point, so computeThread is the only consumer
+    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+        InputFrameRing* inputRing = (*it)->getInputRing().data();
+        for(size_t size = inputRing->size(); size > 1; size--) {
+            inputRing->pop();
+        }
+    }
+}
+
+void ComputeEngine::computeFrame() {
     double millisCompute;   // time in nanoseconds taken by computation
     double millisLastFrame; // time in nanoseconds since last frame
 
@@ -137,92 +375,246 @@ void ComputeEngine::loop() {
     // restart the timer to measure frame time and compute time
     elapsedTimer.restart();
     elapsedTimer.start();
+    qint64 frameStart = DeadlineClock::now();
 
-    // check if input value received via OSC this loop
-    if(inputValueReceived) {
-        // apply input values
-        for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-            (*it)->applyInputRegion();
-        }
+    // run the input -> compute -> output pipeline of every due generator. generators are independent, so their pipelines run concurrently.
+    // this returns once all of them are done, so everything below sees the complete frame
+    workerPool->run((int) frameGenerators.size(), frameCosts, [this](int index) {
+        QElapsedTimer pipelineTimer;
+        pipelineTimer.start();
 
-        // reset check to prevent values being erased on every loop
-        inputValueReceived = false;
-    }
+        computeGenerator(frameGenerators[index], frameIterations[index], framePeriods[index]);
 
-    // do the computation
-    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-        (*it)->computeIteration(1.0 / frequency);
-    }
+        // each job only writes to its own entry
+        frameCosts[index] = pipelineTimer.nsecsElapsed();
+    });
 
-    // apply output values
-    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-        (*it)->applyOutputRegion();
+    // smooth the measured costs so a single slow frame doesn't throw off the balancing
+    for(size_t i = 0; i < frameGenerators.size(); i++) {
+        int id = frameGenerators[i]->getID();
+        qint64 previousCost = generatorCosts.value(id, frameCosts[i]);
+        generatorCosts.insert(id, (3 * previousCost + frameCosts[i]) / 4);
     }
 
-    // write to history
-    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+    // write to history. generators that weren't computed keep their previous value
+    qint64 historyStart = DeadlineClock::now();
+    for(Generator* generator : frameGenerators) {
         double historyLatest = 0;
-        for(int i = 0; i < (*it)->getOutputRegionSet()->rowCount(); i++) {
-            historyLatest += (*it)->getOutputRegionSet()->at(i)->getIntensity();
+        for(int i = 0; i < generator->getOutputRegionSet()->rowCount(); i++) {
+            historyLatest += generator->getOutputRegionSet()->at(i)->getIntensity();
         }
         if(flagDummyOutputMonitor) {
             // random output
             historyLatest = randomUniform(randomGenerator);
         } else {
             // dumb averaging
-            historyLatest /= (*it)->getOutputRegionSet()->rowCount();
+            historyLatest /= generator->getOutputRegionSet()->rowCount();
             // saturation polynomial
             historyLatest = (1.0 - pow(1.0 - historyLatest, 3));
         }
         // write value
-        (*it)->writeHistoryLatest(historyLatest);
+        generator->writeHistoryLatest(historyLatest);
         // flip refresher to force update on QML side
-        (*it)->flipHistoryRefresher();
+        generator->flipHistoryRefresher();
     }
 
-    // send output messages to osc engine
-    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
-        QList<QVariant> oscOutputsList;
-        QList<QVariant> oscOutputRegion;
-
-        for(int i = 0; i < (*it)->getOutputRegionSet()->rowCount(); i++) {
-            double value = flagDummyOutputMonitor ? randomUniform(randomGenerator) : (*it)->getOutputRegionSet()->at(i)->getIntensity();
-            if(flagCastOutputToFloat) {
-                oscOutputsList.append((float)value);
-                oscOutputRegion.append((float)value);
-            } else {
-                oscOutputsList.append(value);
-                oscOutputRegion.append(value);
-            }
-
-            // write and send individual output region osc messages
-            // format is: "/[generator_name]/output/[output_region_number]/float"
-            QString outputRegionNumber = QString::number(i+1);
-            oscOutputRegion.prepend("/" + (*it)->getGeneratorName() + "/output/" + outputRegionNumber);
-            emit sendOscData((*it)->getID(), oscOutputRegion);
-            oscOutputRegion.clear();
+    qint64 oscEmitStart = DeadlineClock::now();
+    latencyHistory.record(oscEmitStart - historyStart);
+
+    // send output values to osc engine. the frames are written in place in the queue, so nothing is allocated here
+    for(Generator* generator : frameGenerators) {
+        OutputFrame* frame = outputQueue->ring.acquire();
+        frame->generatorId = generator->getID();
+        frame->frameNumber = frameNumber;
+        frame->count = std::min(generator->getOutputRegionSet()->rowCount(), (int) OutputFrame::maxValues);
+        if(frame->count < generator->getOutputRegionSet()->rowCount() && !truncatedOutputs.contains(frame->generatorId)) {
+            truncatedOutputs.insert(frame->generatorId);
+            qWarning() << "generator" << frame->generatorId << "has" << generator->getOutputRegionSet()->rowCount()
+                       << "output regions, only the first" << OutputFrame::maxValues << "are sent over OSC";
         }
+        for(int i = 0; i < frame->count; i++) {
+            double value = flagDummyOutputMonitor ? randomUniform(randomGenerator) : generator->getOutputRegionSet()->at(i)->getIntensity();
+            frame->values[i] = (float) value;
+        }
+        outputQueue->ring.publish();
+    }
+    frameNumber++;
 
-        // write generator info to osc output list message
-        // format is: "/[generator_name]/output/float float float float" (or however many floats are needed to express every output region)
-        oscOutputsList.prepend("/" + (*it)->getGeneratorName() + "/output");
-
-        // send osc output list message
-        emit sendOscData((*it)->getID(), oscOutputsList);
+    // wake up oscThread, unless it wasn't done with the previous notification yet
+    if(!outputQueue->drainPending.exchange(true)) {
+        emit outputFramesReady();
     }
 
+    qint64 frameEnd = DeadlineClock::now();
+    latencyOscEmit.record(frameEnd - oscEmitStart);
+    latencyFrame.record(frameEnd - frameStart);
+
     // measure the time used to do the computation
     millisCompute = elapsedTimer.nsecsElapsed() / 1000000.0;
 
-    QTimer timer;
-    timer.setTimerType(Qt::PreciseTimer);
-    timer.singleShot((int) std::min<double>(1.0 / frequency * 1000.0, std::max<double>(1.0 / frequency * 1000.0 - millisCompute, 0)), this, &ComputeEngine::loop);
+    if(flagDebug) {
+        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+        );
+
+        qDebug() << "computeFrame (ComputeEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\trefresh (ms) = " << millisLastFrame << "\tcompute (ms) = " << millisCompute;
+    }
+}
 
+void ComputeEngine::publishStats() {
+    statsLastPublished = DeadlineClock::now();
+
+    QVariantMap stats;
+    stats.insert("frame", latencyFrame.toVariantMap());
+    stats.insert("history", latencyHistory.toVariantMap());
+    stats.insert("oscEmit", latencyOscEmit.toVariantMap());
+    stats.insert("missedDeadlines", (double) missedDeadlines);
+    stats.insert("latenessMax", latenessMax / 1000000.0);
+    stats.insert("latenessMean", getLatenessMean() / 1000000.0);
+    stats.insert("outputDropped", (double) outputQueue->ring.getDropped());
+
+    // per generator stages, and the same stages over all generators
+    LatencyHistogram input;
+    LatencyHistogram compute;
+    LatencyHistogram output;
+    LatencyHistogram latticeExport;
+    QVariantList generators;
+
+    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+        GeneratorLatency* latency = (*it)->getLatency();
+        input.merge(latency->input);
+        compute.merge(latency->compute);
+        output.merge(latency->output);
+        latticeExport.merge(latency->latticeExport);
+
+        QVariantMap generator;
+        generator.insert("id", (*it)->getID());
+        generator.insert("generatorName", (*it)->getGeneratorName());
+        generator.insert("tickRate", (*it)->getTickRate());
+        generator.insert("input", latency->input.toVariantMap());
+        generator.insert("compute", latency->compute.toVariantMap());
+        generator.insert("output", latency->output.toVariantMap());
+        generator.insert("latticeExport", latency->latticeExport.toVariantMap());
+        generator.insert("inputDropped", (double) (*it)->getInputRing()->getDropped());
+        (*it)->writeStats(generator);
+        generators.append(generator);
+    }
+
+    stats.insert("input", input.toVariantMap());
+    stats.insert("compute", compute.toVariantMap());
+    stats.insert("output", output.toVariantMap());
+    stats.insert("latticeExport", latticeExport.toVariantMap());
+    stats.insert("generators", generators);
+
+    emit statsUpdated(stats);
+}
+
+void ComputeEngine::resetStats() {
+    latencyFrame.reset();
+    latencyHistory.reset();
+    latencyOscEmit.reset();
+
+    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+        GeneratorLatency* latency = (*it)->getLatency();
+        latency->input.reset();
+        latency->compute.reset();
+        latency->output.reset();
+        latency->latticeExport.reset();
+        (*it)->resetStats();
+    }
+
+    missedDeadlines = 0;
+    wakeups = 0;
+    latenessLast = 0;
+    latenessMax = 0;
+    latenessTotal = 0;
+}
+
+void ComputeEngine::render(QString path, int iterations, double deltaTime, bool writeLattice, bool seeded, quint32 seed) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
         );
 
-        qDebug() << "loop (ComputeEngine):\t\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\trefresh (ms) = " << millisLastFrame << "\tcompute (ms) = " << millisCompute;
+        qDebug() << "render (ComputeEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\titerations = " << iterations << "\tdeltaTime = " << deltaTime;
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "render (ComputeEngine): couldn't open" << path;
+        emit renderFinished(false);
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    // the file must start from the state matching the parameters, so wait for any background reinitialization
+    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+        (*it)->commitInitialize(true);
+    }
+
+    // same seed, same parameters, same file
+    if(seeded) {
+        for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+            (*it)->writeRandomSeed(seed + (*it)->getID());
+            (*it)->initialize();
+        }
+    }
+
+    std::vector<Generator*> generators;
+    std::vector<qint64> costs;
+    for(QList<QSharedPointer<Generator>>::iterator it = generatorsList->begin(); it != generatorsList->end(); it++) {
+        generators.push_back(it->data());
+        costs.push_back(generatorCosts.value((*it)->getID(), 0));
     }
+
+    stream.writeRawData("ATNXRNDR", 8);
+    stream << (quint32) 1 << (quint32) iterations << (float) deltaTime << (quint32) (writeLattice ? 1 : 0) << (quint32) generators.size();
+    for(Generator* generator : generators) {
+        stream << (qint32) generator->getID() << generator->getGeneratorName() << generator->getType();
+        stream << (quint32) generator->getOutputRegionSet()->rowCount() << (quint32) generator->getLatticeWidth() << (quint32) generator->getLatticeHeight();
+    }
+
+    qint64 renderStart = DeadlineClock::now();
+
+    for(int iteration = 0; iteration < iterations; iteration++) {
+        // generators are independent, so they can still be computed concurrently. the file only depends on their own state
+        workerPool->run((int) generators.size(), costs, [&generators, deltaTime](int index) {
+            generators[index]->computeIteration(deltaTime);
+            generators[index]->applyOutputRegion();
+        });
+
+        for(Generator* generator : generators) {
+            GeneratorRegionSet* outputRegionSet = generator->getOutputRegionSet();
+            for(int i = 0; i < outputRegionSet->rowCount(); i++) {
+                stream << (float) outputRegionSet->at(i)->getIntensity();
+            }
+
+            if(writeLattice) {
+                std::vector<float> row(generator->getLatticeWidth());
+                for(int y = 0; y < generator->getLatticeHeight(); y++) {
+                    generator->readLatticeRow(0, y, (int) row.size(), row.data());
+                    for(float value : row) {
+                        stream << value;
+                    }
+                }
+            }
+        }
+    }
+
+    file.close();
+
+    double seconds = (DeadlineClock::now() - renderStart) / 1000000000.0;
+    qDebug() << "render (ComputeEngine):" << iterations << "iterations in" << seconds << "s," << iterations / seconds << "iterations per second";
+
+    // the generators went through many iterations without the clock, so start their schedule over from now instead of catching up
+    qint64 now = DeadlineClock::now();
+    for(Generator* generator : generators) {
+        generatorDeadlines.insert(generator->getID(), now);
+        schedule.push({now, generator->getID()});
+    }
+
+    emit renderFinished(stream.status() == QDataStream::Ok);
 }
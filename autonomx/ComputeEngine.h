@@ -20,38 +20,138 @@
 #include <QElapsedTimer>
 #include <QList>
 #include <QHash>
+#include <QSet>
 #include <QSharedPointer>
 #include <random>
+#include <atomic>
+#include <queue>
+#include <vector>
 
 #include "Generator.h"
+#include "ComputeWorkerPool.h"
+#include "LatencyHistogram.h"
+#include "OutputFrame.h"
 
 
 class ComputeEngine : public QObject {
     Q_OBJECT
+public:
+    // what the loop does when a generator overruns its deadline
+    enum class CatchUpPolicy {
+        Skip,       // drop the missed iterations, the simulation slows down
+        Substep     // compute the missed iterations back to back, the simulation stays on the clock
+    };
+
+    // how the input frames received over OSC are applied to a generator
+    enum class InputPolicy {
+        LastWins,       // only the newest frame received before the iteration is applied, older ones are discarded
+        FrameAccurate   // frames are applied in order, at most one per iteration, to the first iteration scheduled after they were received
+    };
 private:
+    // entry of the schedule. entries are never removed from the queue directly, instead they are discarded when popped
+    // if they don't match generatorDeadlines anymore (generator removed, or rescheduled)
+    struct ScheduleEntry {
+        qint64 deadline;
+        int id;
+
+        // std::priority_queue is a max heap, so the earliest deadline must compare as the greatest
+        bool operator<(const ScheduleEntry& other) const {
+            return deadline > other.deadline;
+        }
+    };
+
     QSharedPointer<QList<QSharedPointer<Generator>>> generatorsList;
     QSharedPointer<QHash<int, QSharedPointer<Generator>>> generatorsHashMap;
     QElapsedTimer elapsedTimer;
-    double frequency = 60;
+    QSharedPointer<ComputeWorkerPool> workerPool;
+    QSharedPointer<OutputFrameQueue> outputQueue;   // output values on their way to OscEngine
+    QSet<int> truncatedOutputs;                 // generators already warned about having more output regions than OutputFrame::maxValues
+    quint64 frameNumber = 0;
+    QHash<int, qint64> generatorCosts;          // compute time of each generator's pipeline in nanoseconds, smoothed over previous frames. used for load balancing
+    std::priority_queue<ScheduleEntry> schedule;   // next deadline of every generator, earliest first
+    QHash<int, qint64> generatorDeadlines;      // current deadline of each generator, in DeadlineClock time. this is the reference for schedule
+    std::vector<Generator*> frameGenerators;    // generators that are due during the current frame
+    std::vector<qint64> frameCosts;             // expected cost of each entry of frameGenerators, updated with the measured cost once the frame is done
+    std::vector<int> frameIterations;           // number of iterations to compute for each entry of frameGenerators
+    std::vector<qint64> framePeriods;           // period of each entry of frameGenerators, in nanoseconds
+    qint64 frameTime = 0;                       // time at which the due generators were collected. the last iteration of every generator is considered to happen then
+    double frequency = 60;                      // rate at which the loop wakes up at least to process queued events, in Hz
+    CatchUpPolicy catchUpPolicy = CatchUpPolicy::Skip;
+    InputPolicy inputPolicy = InputPolicy::LastWins;
+    int maxSubsteps = 4;                        // maximum iterations computed in a row by CatchUpPolicy::Substep
+    std::atomic<bool> stopRequested;
+
+    // brings the deadline of a generator forward if its tick rate went up, so that the new rate applies right away rather than after the current period
+    void rescheduleGenerator(int id);
     bool firstFrame = true;
-    bool inputValueReceived = false;
+
+    // deadline counters. lateness is how far past its deadline a generator was computed, in nanoseconds
+    quint64 missedDeadlines = 0;
+    quint64 wakeups = 0;
+    qint64 latenessLast = 0;
+    qint64 latenessMax = 0;
+    qint64 latenessTotal = 0;
+
+    // stage timings that don't belong to a single generator. the per generator ones are in Generator::getLatency
+    LatencyHistogram latencyFrame;              // whole frame, from the pipelines to the osc emission
+    LatencyHistogram latencyHistory;
+    LatencyHistogram latencyOscEmit;
+    qint64 statsInterval = 1000000000;          // time between two statsUpdated signals, in nanoseconds
+    qint64 statsLastPublished = 0;
     bool flagDebug = false;
     bool flagDummyOutputMonitor = false;
     bool flagDummyOscOutput = false;
     bool flagDisableProcessing = false;
-    bool flagCastOutputToFloat = true; // needed for Max as it doesn't support doubles
+    bool flagParallelCompute = true;    // runs the generators' input -> compute -> output pipelines on workerPool
     std::mt19937 randomGenerator;
 std::uniform_real_distribution<> randomUniform;
+
+    // applies the input frames and regions (if needed), computes the given number of iterations and applies the output regions of a single generator.
+    // the iterations are considered to happen one period apart, the last one at frameTime.
+    // this only touches the given generator, and is called concurrently for different generators from workerPool
+    void computeGenerator(Generator* generator, int iterations, qint64 period);
+
+    // pops the input frames received before time from the generator's ring according to inputPolicy, and writes them to the input region intensities.
+    // returns false if there was nothing to apply
+    bool applyInputFrames(Generator* generator, qint64 time);
+
+    // with InputPolicy::LastWins, drops every input frame but the newest from the rings of generators that aren't due, so that slow generators don't fill their ring
+    void trimInputRings();
+
+    // pops the generators whose deadline has passed by now from the schedule, reschedules them and fills the frame vectors.
+    // their lateness is measured at wakeTime, when the loop woke up, before the queued events were processed
+    void collectDueGenerators(qint64 wakeTime, qint64 now);
+
+    // does the computation for a single frame: pipelines of the due generators, history and osc output
+    void computeFrame();
+
+    // gathers the timings into a map and emits it through statsUpdated
+    void publishStats();
 public:
     ComputeEngine(QSharedPointer<QList<QSharedPointer<Generator>>> generatorsList, QSharedPointer<QHash<int, QSharedPointer<Generator>>> generatorsHashMap);
     ~ComputeEngine();
+
+    // queue read by OscEngine, see AppModel
+    QSharedPointer<OutputFrameQueue> getOutputQueue() const;
+
+    quint64 getMissedDeadlines() const;
+    qint64 getLatenessLast() const;
+    qint64 getLatenessMax() const;
+    double getLatenessMean() const;
 signals:
-    // sends data through OscEngine::sendOscData
-    void sendOscData(int id, QVariantList data);
-public slots:
-    // handles data received from OscEngine::receiveOscData
-    void receiveOscData(int id, QVariantList data);
+    // tells OscEngine::drainOutputFrames that output frames are waiting. this is emitted at most once until OscEngine starts draining
+    void outputFramesReady();
 
+    // emitted by render once the file is written, or if it couldn't be
+    void renderFinished(bool success);
+
+    // timing summary, emitted every statsInterval. times are in milliseconds. the layout is:
+    // { "frame", "history", "oscEmit", "input", "compute", "output", "latticeExport": histogram summary (see LatencyHistogram::toVariantMap),
+    //   "missedDeadlines", "latenessMax", "latenessMean", "outputDropped": numbers,
+    //   "generators": list of { "id", "generatorName", "tickRate", "input", "compute", "output", "latticeExport", "inputDropped",
+    //                           and whatever Generator::writeStats adds } }
+    void statsUpdated(QVariantMap stats);
+public slots:
     // adds a generator to the list and hash map
     void addGenerator(QSharedPointer<Generator> generator);
 
@@ -61,6 +161,37 @@ public slots:
     // starts the compute loop
     void start();
 
-    // does the computation and schedules itself for the next iteration
+    // asks the compute loop to return. this is thread-safe, and must be called before computeThread is exited
+    void stop();
+
+    // runs until stop() is called. every generator is computed on its own grid of absolute deadlines, set by its tick rate,
+    // and the loop sleeps until the earliest one
     void loop();
+
+    // sets the minimum wake-up frequency of the loop in Hz, clamped to [1, 1000]
+    void writeFrequency(double frequency);
+
+    void writeCatchUpPolicy(CatchUpPolicy catchUpPolicy);
+
+    void writeInputPolicy(InputPolicy inputPolicy);
+
+    // applies the loop settings found in settings, by name: frequency (in Hz), catchUpPolicy ("skip" or "substep") and inputPolicy
+    // ("lastWins" or "frameAccurate"). they come from the "engine" group of the application settings, or from the headless command line.
+    // unknown values are ignored with a warning. this must be called on computeThread, or before it starts
+    void writeSettings(const QVariantMap& settings);
+
+    // clears every timing histogram and counter, including the generators' ones
+    void resetStats();
+
+    // offline render. computes the given number of iterations of every generator back to back, with a fixed deltaTime and without waiting
+    // for any deadline, and writes the output values of every iteration to the file at path. OSC input is ignored and nothing is sent.
+    // if seeded, every generator is reinitialized first with seed + its id (see Generator::writeRandomSeed), so that the file can be compared
+    // between runs. this blocks computeThread until it is done, then emits renderFinished.
+    //
+    // the file is written with QDataStream, little endian, floats in single precision:
+    //
+    //    header:       "ATNXRNDR" (8 bytes), version (quint32, 1), iterations (quint32), deltaTime (float), flags (quint32, bit 0 = lattice), generator count (quint32)
+    //    generators:   id (qint32), generatorName (QString), type (QString), output count (quint32), lattice width (quint32), lattice height (quint32)
+    //    iterations:   for every generator in the above order, its output values, then its lattice values (index = x + y * width) if the lattice flag is set
+    void render(QString path, int iterations, double deltaTime, bool writeLattice, bool seeded, quint32 seed);
 };
@@ -0,0 +1,253 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "ComputeWorkerPool.h"
+
+ComputeWorkerPool::ComputeWorkerPool(int workerCount) : jobsRemaining(0), currentJob(nullptr) {
+    workerCount = std::max(0, workerCount);
+
+    // one queue per spawned thread, plus one for the calling thread
+    for(int i = 0; i < workerCount + 1; i++) {
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+    loads.resize(queues.size(), 0);
+
+    for(int i = 1; i < workerCount + 1; i++) {
+        QThread* thread = QThread::create([this, i]() {
+            workerLoop(i);
+        });
+        thread->start(QThread::TimeCriticalPriority);
+        threads.push_back(thread);
+    }
+}
+
+ComputeWorkerPool::~ComputeWorkerPool() {
+    frameMutex.lock();
+    quitting = true;
+    frameStarted.wakeAll();
+    frameMutex.unlock();
+
+    for(QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+int ComputeWorkerPool::getWorkerCount() const {
+    return (int) threads.size();
+}
+
+void ComputeWorkerPool::run(int jobCount, const std::vector<qint64>& costs, const std::function<void(int)>& job) {
+    if(jobCount <= 0) {
+        return;
+    }
+
+    // nothing to gain from waking up other threads
+    if(threads.empty() || jobCount == 1) {
+        for(int i = 0; i < jobCount; i++) {
+            job(i);
+        }
+        return;
+    }
+
+    // sort jobs by decreasing cost
+    order.resize(jobCount);
+    for(int i = 0; i < jobCount; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&costs](int a, int b) {
+        return costs[a] > costs[b];
+    });
+
+    // this must be visible before any job is queued, since a worker still draining the previous frame could pick up a job right away
+    currentJob.store(&job);
+    jobsRemaining.store(jobCount);
+
+    // greedily assign the most expensive remaining job to the least loaded queue
+    std::fill(loads.begin(), loads.end(), 0);
+    for(int i = 0; i < jobCount; i++) {
+        int target = (int) (std::min_element(loads.begin(), loads.end()) - loads.begin());
+        // unmeasured jobs still count for something so they get spread out
+        loads[target] += std::max<qint64>(costs[order[i]], 1);
+
+        QMutexLocker locker(&queues[target]->mutex);
+        queues[target]->jobs.push_back(order[i]);
+    }
+
+    // wake up the workers
+    frameMutex.lock();
+    frameNumber++;
+    frameStarted.wakeAll();
+    frameMutex.unlock();
+
+    // the calling thread works too
+    drain(0);
+
+    // frame barrier
+    frameMutex.lock();
+    while(jobsRemaining.load() > 0) {
+        frameCompleted.wait(&frameMutex);
+    }
+    frameMutex.unlock();
+
+    currentJob.store(nullptr);
+}
+
+void ComputeWorkerPool::parallelFor(int count, const std::function<void(int)>& body) {
+    if(count <= 0) {
+        return;
+    }
+
+    if(threads.empty() || count == 1) {
+        for(int i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+
+    NestedLoop loop = {&body, count, 0, count};
+    nestedMutex.lock();
+    nestedLoops.push_back(&loop);
+    nestedMutex.unlock();
+
+    // wake up the workers waiting for a frame. the ones busy with a job will help once they run out of jobs
+    frameMutex.lock();
+    nestedNumber++;
+    frameStarted.wakeAll();
+    frameMutex.unlock();
+
+    // the calling thread works on its own loop first
+    nestedMutex.lock();
+    NestedLoop* current = &loop;
+    int index;
+    while(takeNested(current, index)) {
+        nestedMutex.unlock();
+        body(index);
+        nestedMutex.lock();
+        completeNested(current);
+    }
+
+    // wait for the indices taken by the workers. they don't touch loop anymore once remaining is 0
+    while(loop.remaining > 0) {
+        nestedCompleted.wait(&nestedMutex);
+    }
+    nestedMutex.unlock();
+}
+
+void ComputeWorkerPool::workerLoop(int index) {
+    quint64 frameSeen = 0;
+    quint64 nestedSeen = 0;
+    while(true) {
+        frameMutex.lock();
+        while(frameSeen == frameNumber && nestedSeen == nestedNumber && !quitting) {
+            frameStarted.wait(&frameMutex);
+        }
+        frameSeen = frameNumber;
+        nestedSeen = nestedNumber;
+        bool quit = quitting;
+        frameMutex.unlock();
+
+        if(quit) {
+            return;
+        }
+
+        drain(index);
+    }
+}
+
+void ComputeWorkerPool::drain(int index) {
+    int job;
+    while(take(index, job)) {
+        (*currentJob.load())(job);
+
+        if(jobsRemaining.fetch_sub(1) == 1) {
+            // last job of the frame, release the calling thread
+            frameMutex.lock();
+            frameCompleted.wakeAll();
+            frameMutex.unlock();
+        }
+    }
+
+    // no job left to take, help the jobs still running with their nested loops
+    helpNested();
+}
+
+bool ComputeWorkerPool::take(int index, int& job) {
+    // own queue first, oldest job first
+    {
+        QMutexLocker locker(&queues[index]->mutex);
+        if(!queues[index]->jobs.empty()) {
+            job = queues[index]->jobs.front();
+            queues[index]->jobs.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other queues
+    int queueCount = (int) queues.size();
+    for(int offset = 1; offset < queueCount; offset++) {
+        WorkerQueue* victim = queues[(index + offset) % queueCount].get();
+        QMutexLocker locker(&victim->mutex);
+        if(!victim->jobs.empty()) {
+            job = victim->jobs.back();
+            victim->jobs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ComputeWorkerPool::helpNested() {
+    nestedMutex.lock();
+    NestedLoop* loop = nullptr;
+    int index;
+    while(takeNested(loop, index)) {
+        nestedMutex.unlock();
+        (*loop->body)(index);
+        nestedMutex.lock();
+        completeNested(loop);
+        loop = nullptr;
+    }
+    nestedMutex.unlock();
+}
+
+bool ComputeWorkerPool::takeNested(NestedLoop*& loop, int& index) {
+    if(loop == nullptr) {
+        if(nestedLoops.empty()) {
+            return false;
+        }
+        loop = nestedLoops.front();
+    }
+    if(loop->next >= loop->count) {
+        return false;
+    }
+
+    index = loop->next++;
+    if(loop->next == loop->count) {
+        // last index handed out, nobody else needs to find this loop
+        nestedLoops.erase(std::find(nestedLoops.begin(), nestedLoops.end(), loop));
+    }
+    return true;
+}
+
+void ComputeWorkerPool::completeNested(NestedLoop* loop) {
+    loop->remaining--;
+    if(loop->remaining == 0) {
+        nestedCompleted.wakeAll();
+    }
+}
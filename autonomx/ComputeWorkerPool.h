@@ -0,0 +1,101 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// work-stealing pool used by ComputeEngine to run independent generator pipelines at the same time.
+//
+// jobs are identified by their index. before a frame starts, they are distributed over one queue per worker using the
+// longest-processing-time-first heuristic, using the cost measured for each job on previous frames.
+// each worker pops jobs from the front of its own queue, and steals from the back of other queues once its own is empty.
+//
+// the calling thread takes part in the computation as the first worker, and run() only returns once every job is done.
+// this acts as the frame barrier that ComputeEngine relies on before writing history and emitting OSC.
+//
+// a job can split its own work with parallelFor. the workers left without jobs help with it, so that a single large
+// generator uses the idle cores without adding threads on top of the pool.
+class ComputeWorkerPool {
+public:
+    // workerCount is the number of threads spawned in addition to the calling thread. 0 runs everything on the calling thread.
+    ComputeWorkerPool(int workerCount);
+    ~ComputeWorkerPool();
+
+    // runs job(i) for every i in [0, jobCount). costs holds the expected cost of each job (in any unit, usually nanoseconds).
+    // job must be safe to call concurrently for different indices.
+    void run(int jobCount, const std::vector<qint64>& costs, const std::function<void(int)>& job);
+
+    // runs body(i) for every i in [0, count) on the calling thread, with the help of the workers that have no job left.
+    // it can be called from a job of run, or from any thread, and only returns once every index is done.
+    // body must be safe to call concurrently for different indices.
+    void parallelFor(int count, const std::function<void(int)>& body);
+
+    int getWorkerCount() const;
+private:
+    struct WorkerQueue {
+        QMutex mutex;
+        std::deque<int> jobs;
+    };
+
+    // a parallelFor in progress. it lives on the stack of its caller, which waits for remaining to reach 0 before returning
+    struct NestedLoop {
+        const std::function<void(int)>* body;
+        int count;
+        int next;                               // next index to hand out
+        int remaining;                          // indices not done yet
+    };
+
+    // main loop of the spawned threads. index 0 is reserved for the calling thread
+    void workerLoop(int index);
+    // executes jobs until there is nothing left to take or steal
+    void drain(int index);
+    // pops from the worker's own queue, or steals from another one
+    bool take(int index, int& job);
+    // runs indices of the nested loops until none is left to hand out
+    void helpNested();
+    // hands out the next index of loop, or of any nested loop if loop is null. nestedMutex must be locked
+    bool takeNested(NestedLoop*& loop, int& index);
+    // marks an index of loop as done. nestedMutex must be locked
+    void completeNested(NestedLoop* loop);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<QThread*> threads;
+
+    QMutex frameMutex;
+    QWaitCondition frameStarted;
+    QWaitCondition frameCompleted;
+    quint64 frameNumber = 0;
+    quint64 nestedNumber = 0;                   // incremented by parallelFor to wake up the waiting workers
+    bool quitting = false;
+
+    QMutex nestedMutex;
+    QWaitCondition nestedCompleted;
+    std::vector<NestedLoop*> nestedLoops;       // loops with indices left to hand out
+
+    std::atomic<int> jobsRemaining;
+    std::atomic<const std::function<void(int)>*> currentJob;
+
+    // scratch space for job distribution, kept around to avoid allocating every frame
+    std::vector<int> order;
+    std::vector<qint64> loads;
+};
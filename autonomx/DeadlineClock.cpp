@@ -0,0 +1,50 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <chrono>
+#include <thread>
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include "DeadlineClock.h"
+
+qint64 DeadlineClock::now() {
+#ifdef Q_OS_LINUX
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (qint64) time.tv_sec * 1000000000 + time.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+#endif
+}
+
+void DeadlineClock::sleepUntil(qint64 deadline) {
+#ifdef Q_OS_LINUX
+    timespec time;
+    time.tv_sec = deadline / 1000000000;
+    time.tv_nsec = deadline % 1000000000;
+    // restart the sleep if a signal interrupted it, the deadline is absolute so nothing needs to be recomputed
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+#endif
+}
@@ -0,0 +1,30 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+
+// monotonic clock used to schedule the compute loop on absolute deadlines.
+// all times are in nanoseconds, on an arbitrary epoch that is shared by every thread of the application.
+class DeadlineClock {
+public:
+    // current time
+    static qint64 now();
+
+    // blocks the calling thread until the clock reaches deadline. returns immediately if the deadline is already passed.
+    // on Linux this uses clock_nanosleep with TIMER_ABSTIME so that the time spent before the call doesn't accumulate as drift.
+    static void sleepUntil(qint64 deadline);
+};
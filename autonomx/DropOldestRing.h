@@ -0,0 +1,115 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+// bounded lock-free queue for one producer thread and one consumer thread that never blocks the producer.
+// when the queue is full, the producer discards the oldest element to make room for the new one, and counts it as dropped.
+//
+// every slot carries a sequence number telling whether it is free, holds an element, or is being read, in the manner of Vyukov's bounded queue.
+// the consumer claims an element by moving head forward with a compare-and-swap before reading it. the producer discards the oldest element
+// the same way, so both sides never touch the same slot at the same time: if the consumer claimed the slot the producer needs, the producer waits
+// for the consumer's release(), which only takes the time of a copy.
+//
+// elements are preallocated and written in place, nothing is allocated once the queue is built.
+template <typename T>
+class DropOldestRing {
+public:
+    // capacity is rounded up to a power of two
+    DropOldestRing(int capacity) : head(0), tail(0), dropped(0) {
+        size = 1;
+        while(size < (size_t) capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+
+        cells.reset(new Cell[size]);
+        for(size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // producer side. returns the element to write to, discarding the oldest one if needed
+    T* acquire() {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Cell& cell = cells[position & mask];
+
+        while(cell.sequence.load(std::memory_order_acquire) != position) {
+            // the cell still holds the element that came size places earlier. if it wasn't claimed yet, discard it
+            size_t oldest = position - size;
+            if(head.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                cell.sequence.store(position, std::memory_order_release);
+                break;
+            }
+            // the consumer is reading it, wait for release()
+            QThread::yieldCurrentThread();
+        }
+
+        return &cell.value;
+    }
+
+    // producer side. makes the element returned by acquire() visible to the consumer
+    void publish() {
+        size_t position = tail.load(std::memory_order_relaxed);
+        cells[position & mask].sequence.store(position + 1, std::memory_order_release);
+        tail.store(position + 1, std::memory_order_release);
+    }
+
+    // consumer side. claims the oldest element and returns it, or returns nullptr if the queue is empty.
+    // the element stays valid until release() is called
+    const T* claim() {
+        size_t position = head.load(std::memory_order_relaxed);
+        while(true) {
+            Cell& cell = cells[position & mask];
+            if(cell.sequence.load(std::memory_order_acquire) != position + 1) {
+                return nullptr;
+            }
+            // this fails if the producer discarded the element in the mean time, in which case position is updated to the new head
+            if(head.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel)) {
+                claimed = position;
+                return &cell.value;
+            }
+        }
+    }
+
+    // consumer side. gives the element returned by claim() back to the producer
+    void release() {
+        cells[claimed & mask].sequence.store(claimed + size, std::memory_order_release);
+    }
+
+    // number of elements discarded to make room for newer ones. this can be read from any thread
+    quint64 getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t size;
+    size_t mask;
+    size_t claimed = 0;                     // position of the element held by the consumer between claim() and release()
+    alignas(64) std::atomic<size_t> head;   // next position to read, moved by the consumer and by the producer when it discards
+    alignas(64) std::atomic<size_t> tail;   // next position to write, only moved by the producer
+    alignas(64) std::atomic<quint64> dropped;
+};
@@ -1,9 +1,13 @@
 #include <chrono>
 #include <QThread>
 #include <QDebug>
+#include <QtAlgorithms>
 #include <time.h>
+#include <random>
+#include <algorithm>
 
 #include "GameOfLife.h"
+#include "BitRow.h"
 
 GameOfLife::GameOfLife(int id, GeneratorMeta * meta) : Generator(id, meta)
 {
@@ -29,10 +33,18 @@ void GameOfLife::initialize()
 
     // re-initialize algorithm here
 
+    // the random pattern is drawn from the generator's seed so that runs can be reproduced
+    seedRandomGenerator();
+
     // resize cells vector for current lattice size
-    cells.resize(latticeHeight * latticeWidth);
-    //maintain a temporary cell to overwrite
-    temp_cells.resize(latticeHeight * latticeWidth);
+    wordsPerRow = (latticeWidth + 63) / 64;
+    cells.assign(latticeHeight * wordsPerRow, 0);
+    // the next generation is written here, then swapped with cells
+    nextCells.assign(latticeHeight * wordsPerRow, 0);
+
+    // the unbounded world starts over from the pattern, which is copied to it on the next iteration
+    world.clear();
+    renderedCells.assign(latticeHeight * wordsPerRow, 0);
 
     // draw pattern when initializing
     drawPattern(GOLPattern);
@@ -44,17 +56,20 @@ void GameOfLife::initialize()
 
 void GameOfLife::drawPattern(GOLPatternType type) {
 
+    // every pattern starts from an empty lattice
+    std::fill(cells.begin(), cells.end(), 0);
+
     switch (type) {
         // Random
         case GOLPatternType::Random: {
+            std::uniform_real_distribution<> randomUniform(0.0, 1.0);
+
             // initialize cell values
             for(int i = 0; i < (latticeHeight * latticeWidth); ++i) {
-            double magic = (float) rand()/RAND_MAX;
+            double magic = randomUniform(randomGenerator);
 
             if (magic>0.5)
-                cells[i]=1;
-            else
-                cells[i]=0;
+                setCell(i);
             }
             break;
         }
@@ -62,17 +77,13 @@ void GameOfLife::drawPattern(GOLPatternType type) {
         // Glider
         case GOLPatternType::Glider: {
 
-            // initialize all cell values to zero initially
-            for(int i = 0; i < (latticeHeight * latticeWidth); ++i) {
-                cells[i] = 0;
-            }
             // assign cell values to 1 to make a glider in the middle of the lattice
             int indexTop = (latticeWidth/2) % latticeWidth + latticeHeight/2  * latticeWidth;
             int indexMiddle = indexTop+latticeWidth;
             int indexBottom = indexMiddle+latticeWidth;
-            cells[indexTop]=1; cells[indexTop+1]=1; cells[indexTop+2]=1;
-            cells[indexMiddle]=1;
-            cells[indexBottom+1]=1;
+            setCell(indexTop); setCell(indexTop+1); setCell(indexTop+2);
+            setCell(indexMiddle);
+            setCell(indexBottom+1);
 
             break;
         }
@@ -80,11 +91,6 @@ void GameOfLife::drawPattern(GOLPatternType type) {
         // SpaceShip
         case GOLPatternType::SpaceShip: {
 
-            // initialize all cell values to zero initially
-            for(int i = 0; i < (latticeHeight * latticeWidth); ++i) {
-                cells[i] = 0;
-            }
-
             // assign cell values to 1 to make a SpaceShip in the middle of the lattice
             int indexTop = (latticeWidth/2) % latticeWidth + latticeHeight/2  * latticeWidth;
             int indexMiddle = indexTop+latticeWidth;
@@ -92,46 +98,39 @@ void GameOfLife::drawPattern(GOLPatternType type) {
             int indexBottom2 = indexBottom+latticeWidth;
             int indexBottom3 = indexBottom2+latticeWidth;
 
-            cells[indexTop+1]=1; cells[indexTop+2]=1; cells[indexTop+3]=1;
-            cells[indexMiddle]=1; cells[indexMiddle+3]=1;
-            cells[indexBottom+3]=1;
-            cells[indexBottom2+3]=1;
-            cells[indexBottom3]=1; cells[indexBottom3+2]=1;
+            setCell(indexTop+1); setCell(indexTop+2); setCell(indexTop+3);
+            setCell(indexMiddle); setCell(indexMiddle+3);
+            setCell(indexBottom+3);
+            setCell(indexBottom2+3);
+            setCell(indexBottom3); setCell(indexBottom3+2);
             break;
         }
 
         // RPentoMino
         case GOLPatternType::RPentoMino: {
 
-            // initialize all cell values to zero initially
-            for(int i = 0; i < (latticeHeight * latticeWidth); ++i) {
-                cells[i] = 0;
-            }
             // assign cell values to 1 to make a RPentoMino in the middle of the lattice
             int indexTop = (latticeWidth/2) % latticeWidth + latticeHeight/2  * latticeWidth;
             int indexMiddle = indexTop+latticeWidth;
             int indexBottom = indexMiddle+latticeWidth;
-            cells[indexTop+1]=1; cells[indexTop+2]=1;
-            cells[indexMiddle]=1; cells[indexMiddle+1]=1;
-            cells[indexBottom+1]=1;
+            setCell(indexTop+1); setCell(indexTop+2);
+            setCell(indexMiddle); setCell(indexMiddle+1);
+            setCell(indexBottom+1);
 
             break;
         }
 
         // Pentadecathlon
         case GOLPatternType::Pentadecathlon: {
-            for(int i = 0; i < (latticeHeight * latticeWidth); ++i) {
-                cells[i] = 0;
-            }
 
             // assign cell values to 1 to make a Pentadecathlon in the middle of the lattice
             //index top here would refer to the leftmost cell of the middle rectangle here
             int indexTop = (latticeWidth/2) % latticeWidth + latticeHeight/2  * latticeWidth;
             int indexMiddle = indexTop+latticeWidth;
             int indexBottom = indexMiddle+latticeWidth;
-            cells[indexTop] = 1; cells[indexTop+1]=1; cells[indexTop+3]=1;cells[indexTop+6]=1;cells[indexTop] = 1; cells[indexTop-1]=1; cells[indexTop-3]=1;cells[indexTop-6]=1;
-            cells[indexMiddle]=1; cells[indexMiddle+1]=1; cells[indexMiddle+3]=1; cells[indexMiddle+4]=1; cells[indexMiddle+5]=1; cells[indexMiddle+6]=1;cells[indexMiddle]=1; cells[indexMiddle-1]=1; cells[indexMiddle-3]=1; cells[indexMiddle-4]=1; cells[indexMiddle-5]=1; cells[indexMiddle-6]=1;
-            cells[indexBottom] = 1; cells[indexBottom+1]=1; cells[indexBottom+3]=1;cells[indexBottom+6]=1;cells[indexBottom] = 1; cells[indexBottom-1]=1; cells[indexBottom-3]=1;cells[indexBottom-6]=1;
+            setCell(indexTop); setCell(indexTop+1); setCell(indexTop+3);setCell(indexTop+6);setCell(indexTop); setCell(indexTop-1); setCell(indexTop-3);setCell(indexTop-6);
+            setCell(indexMiddle); setCell(indexMiddle+1); setCell(indexMiddle+3); setCell(indexMiddle+4); setCell(indexMiddle+5); setCell(indexMiddle+6);setCell(indexMiddle); setCell(indexMiddle-1); setCell(indexMiddle-3); setCell(indexMiddle-4); setCell(indexMiddle-5); setCell(indexMiddle-6);
+            setCell(indexBottom); setCell(indexBottom+1); setCell(indexBottom+3);setCell(indexBottom+6);setCell(indexBottom); setCell(indexBottom-1); setCell(indexBottom-3);setCell(indexBottom-6);
             break;
         }
     }
@@ -139,86 +138,296 @@ void GameOfLife::drawPattern(GOLPatternType type) {
 
 void GameOfLife::computeIteration(double deltaTime)
 {
-    temp_cells = cells;
-
-    // compute iteration here
-    if (iterationNumber % (100 - (int)(timeScale) + 1) == 0) {
-        for (int i = 1; i < latticeHeight - 1; i++) {
-            for (int j = 1; j < latticeWidth - 1; j++) {
-
-                // find index of the main cell, the cell just above it, and cell just below it; once we do that we can easily find the cells adjacent to those cells
-                //int index = i % latticeWidth + j * latticeWidth;
-                int index = i * latticeWidth + j;
-                int index_above = index-latticeWidth;
-                int index_below = index+latticeWidth;
-                //qDebug()<<"Top cell value" <<index;
-                // qDebug()<<"Middle cell value" <<index_above;
-                // int index_above = (i-1) % latticeWidth + j * latticeWidth;
-                // int index_below = (i+1) % latticeWidth + j * latticeWidth;
-
-                // finding the total value of all the neighbors near to the main cell
-                int neighbors = cells[index_above-1] + cells[index_above] + cells[index_above+1]
-                        + cells[index-1] + cells[index+1]
-                        + cells[index_below-1] + cells[index_below] + cells[index_below+1];
-
-                /* int neighbors = cells[index - latticeWidth - 1] + cells[index - latticeWidth] + cells[index - latticeWidth + 1]
-                        + cells[index - 1] + cells[index] + cells[index + 1]
-                        + cells[index + latticeWidth - 1] + cells[index + latticeWidth] + cells[index + latticeWidth + 1]; */
-
-                /*   // declare the cell alive or dead based on the rule below
-                if      ((cells[index] == 1) && (neighbors <  2)) cells[index] = 0;
-                //TO DO: Here neighbors should be 3 infront of 4 in the just below line. However, changed to 4 to make the GOL look decent. Artistic Lisence. Can discuss.
-                else if ((cells[index] == 1) && (neighbors >  3)) cells[index] = 0;
-                else if ((cells[index] == 0) && (neighbors == 3)) cells[index] = 1; */
-
-                // declare the cell alive or dead based on the rule below
-                if ((cells[index] == 1) && (neighbors < 2)) temp_cells[index] = 0;
-                //TO DO: Here neighbors should be 3 infront of 4 in the just below line. However, changed to 4 to make the GOL look decent. Artistic Lisence. Can discuss.
-                else if ((cells[index] == 1) && (neighbors >  3)) temp_cells[index] = 0;
-                else if ((cells[index] == 0) && (neighbors == 3)) temp_cells[index] = 1;
-                else temp_cells[index] = cells[index];
-
-                //qDebug()<<"The value of index is "<<index<<" and the value of temp_cell is"<<temp_cells[index];
-            }
+    if(isWorldRunning()) {
+        syncWorld();
+        world.step(hashLifeSpeed);
+        renderWorld();
+        iterationNumber++;
+        return;
+    }
+
+    // compute iteration here. the speed set by timeScale is handled by getTickRate, so every call is a generation.
+    // large lattices are split in bands of rows, computed at the same time since each only writes its own rows of nextCells.
+    // the bands run on the workers of ComputeEngine that have no generator left to compute, so no thread is added
+    int bandCount = 1;
+    if(workerPool && latticeWidth * latticeHeight >= parallelCellCount) {
+        bandCount = std::max(1, std::min(workerPool->getWorkerCount() + 1, latticeHeight / minimumBandHeight));
+    }
+
+    // rules of radius above 1 count their neighbourhoods from a table of the whole lattice, built before the bands
+    bool large = lifeRule.radius > 1;
+    if(large) {
+        computeNeighbourSums();
+    }
+    auto compute = [this, large](int begin, int end) {
+        if(large) {
+            computeRowsLarge(begin, end);
+        } else {
+            computeRows(begin, end);
         }
+    };
+
+    if(bandCount == 1) {
+        compute(0, latticeHeight);
+    } else {
+        workerPool->parallelFor(bandCount, [this, bandCount, &compute](int band) {
+            compute(latticeHeight * band / bandCount, latticeHeight * (band + 1) / bandCount);
+        });
     }
 
     //TO DO: write a logic to reinitialize if all the cells are zero or may be if there is no change in pattern
-    //check if all the cells are zero to re-iterate
 
-    /* int check = 0;
-    for (int i = 0; i < latticeWidth * latticeHeight; i++) {
-        if (temp_cells[i] > 0) {
-            check = 1;
-            qDebug()<<"cell no"<<i;
+    iterationNumber++;
+    std::swap(cells, nextCells);
+}
+
+void GameOfLife::computeRows(int begin, int end)
+{
+    // without wrapping, the cells on the border of the lattice are never updated
+    int lastBit = (latticeWidth - 1) % 64;
+    quint64 firstColumn = 1;
+    quint64 lastColumn = (quint64) 1 << lastBit;
+    quint64 lastWordMask = latticeWidth % 64 == 0 ? ~(quint64) 0 : ((quint64) 1 << (latticeWidth % 64)) - 1;
+
+    // bits shifted in past the left and right edges: dead cells, or with wrapping the cells of the opposite edge
+    auto edgeLeft = [&](const quint64* row) -> quint64 {
+        return toroidal ? (row[wordsPerRow - 1] >> lastBit) & 1 : 0;
+    };
+    auto edgeRight = [&](const quint64* row) -> quint64 {
+        return toroidal ? (row[0] & 1) << lastBit : 0;
+    };
+
+    for(int y = begin; y < end; y++) {
+        const quint64* row = &cells[y * wordsPerRow];
+        quint64* next = &nextCells[y * wordsPerRow];
+
+        if(!toroidal && (y == 0 || y == latticeHeight - 1)) {
+            std::copy(row, row + wordsPerRow, next);
+            continue;
+        }
+
+        const quint64* above = &cells[((y + latticeHeight - 1) % latticeHeight) * wordsPerRow];
+        const quint64* below = &cells[((y + 1) % latticeHeight) * wordsPerRow];
+        quint64 aboveEdgeLeft = edgeLeft(above), aboveEdgeRight = edgeRight(above);
+        quint64 rowEdgeLeft = edgeLeft(row), rowEdgeRight = edgeRight(row);
+        quint64 belowEdgeLeft = edgeLeft(below), belowEdgeRight = edgeRight(below);
+
+        for(int w = 0; w < wordsPerRow; w++) {
+            // the 8 neighbours of the 64 cells of the word, as bit masks. left and right take the edge bit of the adjacent words
+            quint64 aboveLeft = (above[w] << 1) | (w > 0 ? above[w - 1] >> 63 : aboveEdgeLeft);
+            quint64 aboveRight = (above[w] >> 1) | (w < wordsPerRow - 1 ? above[w + 1] << 63 : aboveEdgeRight);
+            quint64 left = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : rowEdgeLeft);
+            quint64 right = (row[w] >> 1) | (w < wordsPerRow - 1 ? row[w + 1] << 63 : rowEdgeRight);
+            quint64 belowLeft = (below[w] << 1) | (w > 0 ? below[w - 1] >> 63 : belowEdgeLeft);
+            quint64 belowRight = (below[w] >> 1) | (w < wordsPerRow - 1 ? below[w + 1] << 63 : belowEdgeRight);
+
+            next[w] = lifeRule.stepWord<quint64>(aboveLeft, above[w], aboveRight, left, row[w], right, belowLeft, below[w], belowRight);
+        }
+
+        next[wordsPerRow - 1] &= lastWordMask;
+        if(!toroidal) {
+            next[0] = (next[0] & ~firstColumn) | (row[0] & firstColumn);
+            next[wordsPerRow - 1] = (next[wordsPerRow - 1] & ~lastColumn) | (row[wordsPerRow - 1] & lastColumn);
+        }
+    }
+}
+
+void GameOfLife::computeNeighbourSums()
+{
+    int radius = lifeRule.radius;
+    int paddedWidth = latticeWidth + 2 * radius;
+    int paddedHeight = latticeHeight + 2 * radius;
+    int stride = paddedWidth + 1;
+    neighbourSums.assign((size_t) stride * (paddedHeight + 1), 0);
+
+    for(int py = 0; py < paddedHeight; py++) {
+        // cells past the edges are dead, or wrap around, as many times as needed if the radius is larger than the lattice
+        int y = py - radius;
+        if(toroidal) {
+            y = (y % latticeHeight + latticeHeight) % latticeHeight;
+        }
+        const quint64* row = y >= 0 && y < latticeHeight ? &cells[y * wordsPerRow] : nullptr;
+        const quint32* sumsAbove = &neighbourSums[(size_t) py * stride];
+        quint32* sums = &neighbourSums[(size_t) (py + 1) * stride];
+
+        quint32 rowSum = 0;
+        for(int px = 0; px < paddedWidth; px++) {
+            int x = px - radius;
+            if(toroidal) {
+                x = (x % latticeWidth + latticeWidth) % latticeWidth;
+            }
+            if(row != nullptr && x >= 0 && x < latticeWidth) {
+                rowSum += (row[x / 64] >> (x % 64)) & 1;
+            }
+            sums[px + 1] = sumsAbove[px + 1] + rowSum;
         }
     }
+}
+
+void GameOfLife::computeRowsLarge(int begin, int end)
+{
+    int span = 2 * lifeRule.radius + 1;
+    int stride = latticeWidth + span;
 
-    //check if all the cells are zero
-    if (check == 0)
-        initialize();
-    */
+    for(int y = begin; y < end; y++) {
+        const quint64* row = &cells[y * wordsPerRow];
+        quint64* next = &nextCells[y * wordsPerRow];
+
+        if(!toroidal && (y == 0 || y == latticeHeight - 1)) {
+            std::copy(row, row + wordsPerRow, next);
+            continue;
+        }
 
-    iterationNumber++;;
-    cells = temp_cells;
+        // the neighbourhood of cell (x, y) is padded cells [x, x + span) x [y, y + span)
+        const quint32* top = &neighbourSums[(size_t) y * stride];
+        const quint32* bottom = &neighbourSums[(size_t) (y + span) * stride];
+        std::fill(next, next + wordsPerRow, 0);
+
+        for(int x = 0; x < latticeWidth; x++) {
+            quint32 alive = (row[x / 64] >> (x % 64)) & 1;
+            quint32 count = bottom[x + span] - bottom[x] - top[x + span] + top[x] - alive;
+            if(alive ? lifeRule.survival[count] : lifeRule.birth[count]) {
+                next[x / 64] |= (quint64) 1 << (x % 64);
+            }
+        }
+
+        if(!toroidal) {
+            int lastX = latticeWidth - 1;
+            quint64 lastColumn = (quint64) 1 << (lastX % 64);
+            next[0] = (next[0] & ~(quint64) 1) | (row[0] & 1);
+            next[lastX / 64] = (next[lastX / 64] & ~lastColumn) | (row[lastX / 64] & lastColumn);
+        }
+    }
+}
+
+bool GameOfLife::isWorldRunning() const
+{
+    return flagHashLife && lifeRule.isHashLifeCompatible();
+}
+
+
+qint64 GameOfLife::getViewportLeft() const
+{
+    return (qint64) viewportX - latticeWidth / 2;
 }
 
+qint64 GameOfLife::getViewportTop() const
+{
+    return (qint64) viewportY - latticeHeight / 2;
+}
 
-double GameOfLife::getLatticeValue(int x, int y)
+void GameOfLife::syncWorld()
 {
-    int index = x % latticeWidth + y * latticeWidth;
-//  std::cout << "Index = " + index;
-    return cells[index];
+    qint64 left = getViewportLeft();
+    qint64 top = getViewportTop();
+    for(int y = 0; y < latticeHeight; y++) {
+        for(int w = 0; w < wordsPerRow; w++) {
+            quint64 changed = cells[y * wordsPerRow + w] ^ renderedCells[y * wordsPerRow + w];
+            while(changed != 0) {
+                int bit = qCountTrailingZeroBits(changed);
+                changed &= changed - 1;
+                world.setCell(left + 64 * w + bit, top + y, (cells[y * wordsPerRow + w] >> bit) & 1);
+            }
+        }
+    }
+}
+
+void GameOfLife::renderWorld()
+{
+    world.render(getViewportLeft(), getViewportTop(), latticeWidth, latticeHeight, cells.data(), wordsPerRow);
+    renderedCells = cells;
+}
+
+double GameOfLife::getTickRate() const
+{
+    // timeScale 100 runs a generation on every frame of the default rate, lower values slow down linearly in frame count
+    return tickRate / (100 - (int)(timeScale) + 1);
+}
+
+void GameOfLife::readLatticeRow(int x, int y, int count, float* values)
+{
+    readBits(&cells[y * wordsPerRow], x, count, values);
+}
+
+void GameOfLife::fillLatticeRow(int x, int y, int count, double value)
+{
+    // write values to lattice. cells are either dead or alive, so inputs above one half bring a cell to life
+    fillBits(&cells[y * wordsPerRow], x, count, value >= 0.5);
+}
+
+void GameOfLife::setCell(int index)
+{
+    if(index < 0 || index >= latticeWidth * latticeHeight) {
+        return;
+    }
+    int x = index % latticeWidth;
+    int y = index / latticeWidth;
+    cells[y * wordsPerRow + x / 64] |= (quint64) 1 << (x % 64);
+}
+
+void GameOfLife::writeState(StateWriter& writer)
+{
+    writer.writeValue(stateVersion);
+    writer.writeValue(latticeWidth);
+    writer.writeValue(latticeHeight);
+    writer.writeValue(iterationNumber);
+    writer.writeArray(cells.data(), cells.size());
+    writer.writeValue(isWorldRunning());
+    if(isWorldRunning()) {
+        world.writeState(writer);
+        writer.writeArray(renderedCells.data(), renderedCells.size());
+    }
 }
 
-void GameOfLife::writeLatticeValue(int x, int y, double value)
+bool GameOfLife::readState(StateReader& reader)
 {
-    // write values to lattice
-    int index = x % latticeWidth + y * latticeWidth;
-    cells[index] = value;
+    quint32 version;
+    int width;
+    int height;
+    int iterationNumber;
+    if(!reader.readValue(version) || version != stateVersion || !reader.readValue(width) || !reader.readValue(height) ||
+       !reader.readValue(iterationNumber)) {
+        return false;
+    }
+    if(width != requestedLatticeWidth || height != requestedLatticeHeight) {
+        return false;
+    }
+    int savedWordsPerRow = (width + 63) / 64;
+    const quint64* savedCells = reader.readArray<quint64>((qint64) savedWordsPerRow * height);
+    if(savedCells == nullptr) {
+        return false;
+    }
+
+    // the world is only saved while it is used
+    bool savedWorldRunning;
+    if(!reader.readValue(savedWorldRunning) || savedWorldRunning != isWorldRunning()) {
+        return false;
+    }
+    const quint64* savedRenderedCells = nullptr;
+    if(savedWorldRunning) {
+        if(!world.readState(reader) || (savedRenderedCells = reader.readArray<quint64>((qint64) savedWordsPerRow * height)) == nullptr) {
+            world.clear();
+            return false;
+        }
+    }
+
+    latticeWidth = width;
+    latticeHeight = height;
+    wordsPerRow = savedWordsPerRow;
+    cells.assign(savedCells, savedCells + wordsPerRow * height);
+    nextCells.assign(cells.size(), 0);
+    if(savedRenderedCells != nullptr) {
+        renderedCells.assign(savedRenderedCells, savedRenderedCells + wordsPerRow * height);
+    } else {
+        world.clear();
+        renderedCells.assign(cells.size(), 0);
+    }
+    this->iterationNumber = iterationNumber;
+
+    return true;
 }
 
-int GameOfLife::getRule()
+QString GameOfLife::getRule() const
 {
     return rule;
 }
@@ -227,7 +436,7 @@ GOLPatternType GameOfLife::getGOLPattern() const {
     return GOLPattern;
 }
 
-void GameOfLife::writeRule(int rule)
+void GameOfLife::writeRule(QString rule)
 { if(this->rule == rule)
         return;
 
@@ -239,12 +448,64 @@ void GameOfLife::writeRule(int rule)
         qDebug() << "Rule:\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
 
+    // invalid rules (including the numbers of older projects) keep the current one, and the facade is brought back to it
+    LifeRule lifeRule;
+    if(!LifeRule::parse(rule, lifeRule)) {
+        qWarning() << "GameOfLife: invalid rule" << rule << "ignored";
+        emit valueChanged("rule", this->rule);
+        return;
+    }
+
+    if(requestedFlagHashLife && !lifeRule.isHashLifeCompatible()) {
+        qWarning() << "GameOfLife: rule" << rule << "can't run on the unbounded world, running it on the lattice";
+    }
+
     this->rule = rule;
+    applyRule(lifeRule);
+
     // make sure you follow this signal structure when you write a property!
     emit ruleChanged(rule);
     emit valueChanged("rule", rule);
 }
 
+void GameOfLife::applyRule(const LifeRule& lifeRule)
+{
+    // the tables are read by the threads computing the rows, and the nodes of the world by its step
+    if(QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, lifeRule]() {
+            applyRule(lifeRule);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // the world can only run rules of radius 1 that leave empty space empty, the lattice runs the others.
+    // when the world runs again, it starts over from the lattice
+    bool wasWorldRunning = isWorldRunning();
+    this->lifeRule = lifeRule;
+    if(lifeRule.isHashLifeCompatible()) {
+        world.setRule(lifeRule);
+        if(flagHashLife && !wasWorldRunning) {
+            world.clear();
+            std::fill(renderedCells.begin(), renderedCells.end(), 0);
+        }
+    }
+}
+
+bool GameOfLife::getToroidal() const
+{
+    return toroidal;
+}
+
+void GameOfLife::writeToroidal(bool toroidal)
+{
+    if(this->toroidal == toroidal)
+        return;
+
+    this->toroidal = toroidal;
+    emit toroidalChanged(toroidal);
+    emit valueChanged("toroidal", toroidal);
+}
+
 void GameOfLife::writeGOLPattern(GOLPatternType GOLPattern){
     if(this->GOLPattern == GOLPattern)
            return;
@@ -264,3 +525,102 @@ void GameOfLife::writeGOLPattern(GOLPatternType GOLPattern){
     emit GOLPatternChanged(GOLPattern);
     emit valueChanged("GOLPattern", QVariant(GOLPattern));
 }
+
+int GameOfLife::getHashLifeSpeed() const
+{
+    return hashLifeSpeed;
+}
+
+void GameOfLife::writeHashLifeSpeed(int hashLifeSpeed)
+{
+    // beyond a billion generations per iteration, the world would need more room than HashLife gives it
+    hashLifeSpeed = std::max(0, std::min(hashLifeSpeed, 30));
+    if(this->hashLifeSpeed == hashLifeSpeed)
+        return;
+
+    this->hashLifeSpeed = hashLifeSpeed;
+    emit hashLifeSpeedChanged(hashLifeSpeed);
+    emit valueChanged("hashLifeSpeed", hashLifeSpeed);
+}
+
+bool GameOfLife::getFlagHashLife() const
+{
+    return requestedFlagHashLife;
+}
+
+void GameOfLife::writeFlagHashLife(bool flagHashLife)
+{
+    if(requestedFlagHashLife == flagHashLife)
+        return;
+
+    requestedFlagHashLife = flagHashLife;
+    applyWorldParameters();
+
+    emit flagHashLifeChanged(flagHashLife);
+    emit valueChanged("flag_hashLifeSpeed", flagHashLife);
+}
+
+int GameOfLife::getViewportX() const
+{
+    return requestedViewportX;
+}
+
+void GameOfLife::writeViewportX(int viewportX)
+{
+    if(requestedViewportX == viewportX)
+        return;
+
+    requestedViewportX = viewportX;
+    applyWorldParameters();
+
+    emit viewportXChanged(viewportX);
+    emit valueChanged("viewportX", viewportX);
+}
+
+int GameOfLife::getViewportY() const
+{
+    return requestedViewportY;
+}
+
+void GameOfLife::writeViewportY(int viewportY)
+{
+    if(requestedViewportY == viewportY)
+        return;
+
+    requestedViewportY = viewportY;
+    applyWorldParameters();
+
+    emit viewportYChanged(viewportY);
+    emit valueChanged("viewportY", viewportY);
+}
+
+void GameOfLife::applyWorldParameters()
+{
+    if(QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() {
+            applyWorldParameters();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // the world starts from what the lattice shows, copied to it on the next iteration. when turned off, the lattice simply goes on from there
+    if(flagHashLife != requestedFlagHashLife) {
+        if(requestedFlagHashLife) {
+            world.clear();
+            std::fill(renderedCells.begin(), renderedCells.end(), 0);
+        }
+        flagHashLife = requestedFlagHashLife;
+    }
+
+    if(viewportX != requestedViewportX || viewportY != requestedViewportY) {
+        // cells written to the lattice since the last iteration belong to the previous position
+        if(isWorldRunning()) {
+            syncWorld();
+        }
+        viewportX = requestedViewportX;
+        viewportY = requestedViewportY;
+        if(isWorldRunning()) {
+            renderWorld();
+        }
+    }
+}
@@ -17,38 +17,99 @@
 
 #include "Generator.h"
 #include "GOLPatternType.h"
+#include "HashLife.h"
+#include "LifeRule.h"
 
 class GameOfLife : public Generator
 {
     Q_OBJECT
 
-    Q_PROPERTY(int rule READ getRule WRITE writeRule NOTIFY ruleChanged)
+    Q_PROPERTY(QString rule READ getRule WRITE writeRule NOTIFY ruleChanged)
+    Q_PROPERTY(bool toroidal READ getToroidal WRITE writeToroidal NOTIFY toroidalChanged)
     Q_PROPERTY(GOLPatternType GOLPattern READ getGOLPattern WRITE writeGOLPattern NOTIFY GOLPatternChanged)
+    Q_PROPERTY(int hashLifeSpeed READ getHashLifeSpeed WRITE writeHashLifeSpeed NOTIFY hashLifeSpeedChanged)
+    Q_PROPERTY(bool flag_hashLifeSpeed READ getFlagHashLife WRITE writeFlagHashLife NOTIFY flagHashLifeChanged)
+    Q_PROPERTY(int viewportX READ getViewportX WRITE writeViewportX NOTIFY viewportXChanged)
+    Q_PROPERTY(int viewportY READ getViewportY WRITE writeViewportY NOTIFY viewportYChanged)
 
 private:
 
     // Debugging
     bool  flagDebug = false;
 
-    // computation variables here etc etc
-    std::vector<double> cells;
-    std::vector<double> temp_cells;
+    // cells, bit-packed: each row is wordsPerRow words, and bit i of word w is the cell at x = 64 * w + i. bits past latticeWidth are always 0.
+    // a generation is computed from cells into nextCells, then the two are swapped
+    std::vector<quint64> cells;
+    std::vector<quint64> nextCells;
+    int wordsPerRow = 0;
 
-    // properties and rules
-    int rule = 102;
+    // lattices with at least this many cells are computed in bands of rows, on the idle workers of ComputeEngine
+    static const int parallelCellCount = 1 << 20;
+    // smallest band given to a thread, in rows
+    static const int minimumBandHeight = 64;
+
+    // properties and rules. rule is the text given by the user, see LifeRule for the notations, and lifeRule its compiled tables
+    QString rule = "B3/S23";
+    LifeRule lifeRule;
+    // whether the lattice wraps around its edges. otherwise, the cells on its border are never updated
+    bool toroidal = false;
+
+    // summed-area table of the live cells for rules of radius above 1, on the lattice padded by the radius on every side (with wrapped cells,
+    // or dead ones). entry (x, y) is the number of live cells above and left of padded cell (x, y), so the count of any neighbourhood
+    // takes four lookups whatever the radius. sums are unsigned so that differences stay exact even if a sum overflows
+    std::vector<quint32> neighbourSums;
 
     //pattern name
     GOLPatternType GOLPattern = GOLPatternType::Random;
 
+    // unbounded world. when flagHashLife is set and the rule allows it, the cells are simulated on the infinite plane of world instead, 2^hashLifeSpeed generations
+    // per iteration, and the lattice shows the part of it centered on (viewportX, viewportY). renderedCells is what was last rendered to the
+    // lattice, so that cells changed in between (inputs, patterns) can be copied to the world
+    HashLife world;
+    bool flagHashLife = false;
+    int hashLifeSpeed = 0;
+    int viewportX = 0;
+    int viewportY = 0;
+    std::vector<quint64> renderedCells;
+    // flagHashLife and the viewport written to the properties. they are applied by applyWorldParameters on the thread of the generator,
+    // since they change the world and the lattice
+    bool requestedFlagHashLife = false;
+    int requestedViewportX = 0;
+    int requestedViewportY = 0;
+
     // global iteration counter
     int iterationNumber;
 
+    // layout of writeState, increased whenever it changes
+    static constexpr quint32 stateVersion = 3;
+
     // GOL specific variables
     int currentGeneration;
     int lastGeneration;
     bool gameOver = false;
 
 
+    // sets the cell at a row-major index, as used by drawPattern. indices outside of the lattice are ignored
+    void setCell(int index);
+    // computes rows [begin, end) of the next generation, with the bit-sliced radius 1 rules
+    void computeRows(int begin, int end);
+    // the same for rules of radius above 1, from neighbourSums
+    void computeNeighbourSums();
+    void computeRowsLarge(int begin, int end);
+    // whether the world runs, rather than the lattice
+    bool isWorldRunning() const;
+    // brings flagHashLife and the viewport to their requested values, on the thread of the generator. readJson writes them from the main thread
+    void applyWorldParameters();
+    // replaces lifeRule and the rule of the world, on the thread of the generator
+    void applyRule(const LifeRule& lifeRule);
+
+    // cell of the world at the top left of the lattice
+    qint64 getViewportLeft() const;
+    qint64 getViewportTop() const;
+    // copies the cells changed on the lattice since the last render to the world, then renders the world to the lattice
+    void syncWorld();
+    void renderWorld();
+
 public:
      GameOfLife(int id, GeneratorMeta * meta);
     ~GameOfLife();
@@ -57,20 +118,38 @@ public:
 
     // overrides
     void computeIteration(double deltaTime) override;
+    double getTickRate() const override;
     void initialize() override;
     //void resetParameters() override;
-    double getLatticeValue(int x, int y) override;
-    void writeLatticeValue(int x, int y, double value) override;
+    void readLatticeRow(int x, int y, int count, float* values) override;
+    void fillLatticeRow(int x, int y, int count, double value) override;
+    void writeState(StateWriter& writer) override;
+    bool readState(StateReader& reader) override;
 
     // prop hooks
-    int getRule();
-    void writeRule(int rule);
+    QString getRule() const;
+    void writeRule(QString rule);
+    bool getToroidal() const;
+    void writeToroidal(bool toroidal);
     GOLPatternType getGOLPattern() const;
     void writeGOLPattern(GOLPatternType GOLPattern);
+    int getHashLifeSpeed() const;
+    void writeHashLifeSpeed(int hashLifeSpeed);
+    bool getFlagHashLife() const;
+    void writeFlagHashLife(bool flagHashLife);
+    int getViewportX() const;
+    void writeViewportX(int viewportX);
+    int getViewportY() const;
+    void writeViewportY(int viewportY);
 
 signals:
     // QML signals
     void randSeedChanged(double randSeed);
-    void ruleChanged(int rule);
+    void ruleChanged(QString rule);
+    void toroidalChanged(bool toroidal);
     void GOLPatternChanged(GOLPatternType GOLPattern);
+    void hashLifeSpeedChanged(int hashLifeSpeed);
+    void flagHashLifeChanged(bool flagHashLife);
+    void viewportXChanged(int viewportX);
+    void viewportYChanged(int viewportY);
 };
@@ -13,7 +13,9 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <QThread>
 #include <QTimer>
 #include <QDebug>
@@ -22,6 +24,7 @@
 
 #include "Generator.h"
 #include "AppModel.h"
+#include "DeadlineClock.h"
 
 Generator::Generator(int id, GeneratorMeta * meta) {
     this->id = id;
@@ -45,6 +48,9 @@ Generator::Generator(int id, GeneratorMeta * meta) {
     inputRegionSet = QSharedPointer<GeneratorRegionSet>(new GeneratorRegionSet(0));
     outputRegionSet = QSharedPointer<GeneratorRegionSet>(new GeneratorRegionSet(1));
 
+    // room for a few seconds of input at typical OSC rates, frames are drained every time the generator is computed
+    inputRing = QSharedPointer<InputFrameRing>(new InputFrameRing(256));
+
     // connect row count signals
     // we need to do this as a proxy measure
     // because directly accessing a Qt property from GeneratorRegionSet throws an error
@@ -104,6 +110,10 @@ bool Generator::getHistoryRefresher() {
     return historyRefresher;
 }
 
+double Generator::getInitializeProgress() const {
+    return initializeProgress;
+}
+
 int Generator::getOscInputPort() {
     return oscInputPort;
 }
@@ -135,11 +145,19 @@ int Generator::getOutputCount() const
 }
 
 int Generator::getLatticeWidth() {
-    return latticeWidth;
+    return requestedLatticeWidth;
 }
 
 int Generator::getLatticeHeight() {
-    return latticeHeight;
+    return requestedLatticeHeight;
+}
+
+double Generator::getTickRate() const {
+    return tickRate;
+}
+
+double Generator::getBaseTickRate() const {
+    return tickRate;
 }
 
 double Generator::getTimeScale() const
@@ -315,7 +333,7 @@ void Generator::writeOscOutputAddressTarget(QString oscOutputAddressTarget) {
 }
 
 void Generator::writeLatticeWidth(int latticeWidth) {
-    if(this->latticeWidth == latticeWidth) {
+    if(requestedLatticeWidth == latticeWidth) {
         return;
     }
 
@@ -327,17 +345,17 @@ void Generator::writeLatticeWidth(int latticeWidth) {
         qDebug() << "writeLatticeWidth (Generator)\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << id << "\t value = " << latticeWidth;
     }
 
-    // update property locally
-    this->latticeWidth = latticeWidth;
+    // update property locally, the lattice itself is resized by the reinitialization
+    requestedLatticeWidth = latticeWidth;
     // re-initialize network
-    initialize();
+    reinitialize();
 
     emit valueChanged("latticeWidth", latticeWidth);
     emit latticeWidthChanged(latticeWidth);
 }
 
 void Generator::writeLatticeHeight(int latticeHeight) {
-    if(this->latticeHeight == latticeHeight) {
+    if(requestedLatticeHeight == latticeHeight) {
         return;
     }
 
@@ -349,10 +367,10 @@ void Generator::writeLatticeHeight(int latticeHeight) {
         qDebug() << "writeLatticeHeight (Generator)\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << id << "\t value = " << latticeHeight;
     }
 
-    // update property locally
-    this->latticeHeight = latticeHeight;
+    // update property locally, the lattice itself is resized by the reinitialization
+    requestedLatticeHeight = latticeHeight;
     // re-initialize network
-    initialize();
+    reinitialize();
 
     emit valueChanged("latticeHeight", latticeHeight);
     emit latticeHeightChanged(latticeHeight);
@@ -371,6 +389,20 @@ void Generator::writeTimeScale(double timeScale)
     emit timeScaleChanged(timeScale);
 }
 
+void Generator::writeTickRate(double tickRate)
+{
+    tickRate = std::min(1000.0, std::max(0.01, tickRate));
+    if (this->tickRate == tickRate) {
+        return;
+    }
+
+    // ComputeEngine reschedules the generator on tickRateChanged
+    this->tickRate = tickRate;
+
+    emit valueChanged("tickRate", tickRate);
+    emit tickRateChanged(tickRate);
+}
+
 void Generator::readJson(const QJsonObject &json)
 {
     // 000. GENERAL DATA
@@ -577,12 +609,11 @@ void Generator::writeLatticeData(float** latticeData, int* allocatedWidth, int*
         }
 
         // write to the lattice data
-        for(int x = 0; x < latticeWidth; x++) {
-            for(int y = 0; y < latticeHeight; y++) {
-                int index = x % latticeWidth + y * latticeWidth;
-                (*latticeData)[index] = (float) getLatticeValue(x, y);
-            }
+        qint64 exportStart = DeadlineClock::now();
+        for(int y = 0; y < latticeHeight; y++) {
+            readLatticeRow(0, y, latticeWidth, *latticeData + y * latticeWidth);
         }
+        latency.latticeExport.record(DeadlineClock::now() - exportStart);
 
         if(flagDebug) {
             qDebug() << "writeLatticeData (Generator): write done";
@@ -600,6 +631,92 @@ void Generator::writeLatticeData(float** latticeData, int* allocatedWidth, int*
     }
 }
 
+GeneratorLatency* Generator::getLatency() {
+    return &latency;
+}
+
+QSharedPointer<InputFrameRing> Generator::getInputRing() {
+    return inputRing;
+}
+
+void Generator::setWorkerPool(QSharedPointer<ComputeWorkerPool> workerPool) {
+    this->workerPool = workerPool;
+}
+
+void Generator::writeStats(QVariantMap& stats) {
+    Q_UNUSED(stats);
+}
+
+void Generator::resetStats() {
+}
+
+void Generator::writeRandomSeed(quint32 randomSeed) {
+    this->randomSeed = randomSeed;
+    flagRandomSeed = true;
+}
+
+void Generator::clearRandomSeed() {
+    flagRandomSeed = false;
+}
+
+bool Generator::hasRandomSeed() const {
+    return flagRandomSeed;
+}
+
+quint32 Generator::getRandomSeed() const {
+    return randomSeed;
+}
+
+void Generator::seedRandomGenerator() {
+    if(flagRandomSeed) {
+        randomGenerator.seed(randomSeed);
+    } else {
+        std::random_device random;
+        randomGenerator.seed(random());
+    }
+}
+
+void Generator::reinitialize() {
+    // readJson writes the parameters from the main thread, the lattice must only be resized between frames of computeThread
+    if(QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() {
+            reinitialize();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    latticeWidth = requestedLatticeWidth;
+    latticeHeight = requestedLatticeHeight;
+    initialize();
+}
+
+void Generator::commitInitialize(bool wait) {
+    Q_UNUSED(wait);
+}
+
+void Generator::writeState(StateWriter& writer) {
+    Q_UNUSED(writer);
+}
+
+bool Generator::readState(StateReader& reader) {
+    Q_UNUSED(reader);
+    return false;
+}
+
+void Generator::writeInitializeProgress(double initializeProgress) {
+    // the facade doesn't need every step of a rebuild
+    if(initializeProgress != 0 && initializeProgress != 1 && std::abs(initializeProgress - this->initializeProgress) < 0.01) {
+        return;
+    }
+    if(this->initializeProgress == initializeProgress) {
+        return;
+    }
+
+    this->initializeProgress = initializeProgress;
+    emit valueChanged("initializeProgress", initializeProgress);
+    emit initializeProgressChanged(initializeProgress);
+}
+
 void Generator::lockLatticeDataMutex() {
     latticeDataMutex.lock();
 }
@@ -608,19 +725,19 @@ void Generator::unlockLatticeDataMutex() {
     latticeDataMutex.unlock();
 }
 
+QRect Generator::getLatticeRect(GeneratorRegion* region) const {
+    return region->getRect().intersected(QRect(0, 0, latticeWidth, latticeHeight));
+}
+
 void Generator::applyInputRegion() {
     // iterate over input regions
     for(int i = 0; i < inputRegionSet->rowCount(); i++) {
         GeneratorRegion* region = inputRegionSet->at(i);
-
-        int xMax = region->getRect().x() + region->getRect().width();
-        int yMax = region->getRect().y() + region->getRect().height();
+        QRect rect = getLatticeRect(region);
 
         // write region activation onto lattice in rect area
-        for(int x = region->getRect().x(); x < xMax; x++) {
-            for(int y = region->getRect().y(); y < yMax; y++) {
-                writeLatticeValue(x, y, region->getIntensity());
-            }
+        for(int y = rect.y(); y < rect.y() + rect.height(); y++) {
+            fillLatticeRow(rect.x(), y, rect.width(), region->getIntensity());
         }
     }
 }
@@ -629,21 +746,25 @@ void Generator::applyOutputRegion() {
     // iterate over output regions
     for(int i = 0; i < outputRegionSet->rowCount(); i++) {
         GeneratorRegion* region = outputRegionSet->at(i);
-
-        int xMax = region->getRect().x() + region->getRect().width();
-        int yMax = region->getRect().y() + region->getRect().height();
+        QRect rect = getLatticeRect(region);
+        if(rect.isEmpty()) {
+            region->writeIntensity(0);
+            continue;
+        }
 
         double sum = 0;
 
         // collect lattice activations in rect area
-        for(int x = region->getRect().x(); x < xMax; x++) {
-            for(int y = region->getRect().y(); y < yMax; y++) {
-                sum += getLatticeValue(x, y);
+        regionRowValues.resize(rect.width());
+        for(int y = rect.y(); y < rect.y() + rect.height(); y++) {
+            readLatticeRow(rect.x(), y, rect.width(), regionRowValues.data());
+            for(float value : regionRowValues) {
+                sum += value;
             }
         }
 
         // apply averaging
-        sum /= (double) (region->getRect().width() * region->getRect().height());
+        sum /= (double) (rect.width() * rect.height());
 
         // write to region intensity
         region->writeIntensity(sum);
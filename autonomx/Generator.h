@@ -21,10 +21,26 @@
 #include <QVector>
 #include <QSharedPointer>
 #include <QMutex>
+#include <random>
 #include <vector>
 
+#include "ComputeWorkerPool.h"
 #include "GeneratorRegionSet.h"
 #include "GeneratorMeta.h"
+#include "LatencyHistogram.h"
+#include "SpscRing.h"
+#include "StateSnapshot.h"
+
+// input values carried by a single OSC message, in the order of the input regions
+struct InputFrame {
+    static const int maxValues = 64;            // values past this are ignored, OscEngine warns once per generator
+
+    qint64 timestamp;                           // reception time, in DeadlineClock time
+    int count;
+    float values[maxValues];
+};
+
+typedef SpscRing<InputFrame> InputFrameRing;
 
 class Generator : public QObject {
     Q_OBJECT
@@ -41,6 +57,7 @@ class Generator : public QObject {
     Q_PROPERTY(QString userNotes READ getUserNotes WRITE writeUserNotes NOTIFY userNotesChanged)
     Q_PROPERTY(double historyLatest READ getHistoryLatest NOTIFY historyLatestChanged)
     Q_PROPERTY(bool historyRefresher READ getHistoryRefresher NOTIFY historyRefresherChanged)
+    Q_PROPERTY(double initializeProgress READ getInitializeProgress NOTIFY initializeProgressChanged)
 
     Q_PROPERTY(int oscInputPort READ getOscInputPort WRITE writeOscInputPort NOTIFY oscReceiverPortChanged)
     Q_PROPERTY(QString oscInputAddress READ getOscInputAddress WRITE writeOscInputAddress NOTIFY oscInputAddressChanged)
@@ -56,6 +73,7 @@ class Generator : public QObject {
     Q_PROPERTY(int latticeWidth READ getLatticeWidth WRITE writeLatticeWidth NOTIFY latticeWidthChanged)
     Q_PROPERTY(int latticeHeight READ getLatticeHeight WRITE writeLatticeHeight NOTIFY latticeHeightChanged)
     Q_PROPERTY(double timeScale READ getTimeScale WRITE writeTimeScale NOTIFY timeScaleChanged)
+    Q_PROPERTY(double tickRate READ getBaseTickRate WRITE writeTickRate NOTIFY tickRateChanged)
 public:
     // enum used by GeneratorModel
     // essentially, these are the properties we want to have ready
@@ -92,6 +110,10 @@ public:
     // this also doesn't take care of retrieving output values on the lattice, as this is handled by ComputeEngine after this call.
     virtual void computeIteration(double deltaTime) = 0;
 
+    // number of iterations per second that ComputeEngine schedules for this generator. deltaTime is 1 / tickRate.
+    // derived classes can override this to derive their rate from their own parameters.
+    virtual double getTickRate() const;
+
     // this is the mutex used by writeLatticeData. GeneratorLatticeRenderer will lock it while using *latticeData in its render method.
     void lockLatticeDataMutex();
     void unlockLatticeDataMutex();
@@ -106,6 +128,7 @@ public:
     GeneratorMeta* getMeta() const;
     double getHistoryLatest();
     bool getHistoryRefresher();
+    double getInitializeProgress() const;
 
     int getOscInputPort();
     QString getOscInputAddress();
@@ -120,6 +143,8 @@ public:
     int getLatticeWidth();
     int getLatticeHeight();
     double getTimeScale() const;
+    // tick rate written to the property. getTickRate is the rate actually scheduled, which some generators derive from it
+    double getBaseTickRate() const;
 
     // methods to write properties
     void writeGeneratorName(QString generatorName);
@@ -138,18 +163,44 @@ public:
     void writeLatticeWidth(int latticeWidth);
     void writeLatticeHeight(int latticeHeight);
     void writeTimeScale(double timeScale);
+    // clamped to [0.01, 1000] Hz, the rates ComputeEngine can schedule
+    void writeTickRate(double tickRate);
 
     // serialization methods
     void readJson(const QJsonObject &json);
     void writeJson(QJsonObject &json) const;
 
-    // these are implemented by the derived class and allow reading / writing to the lattice.
-    // this is called by applyInputRegion / applyOutputRegion
-    virtual double getLatticeValue(int x, int y) = 0;
-    virtual void writeLatticeValue(int x, int y, double value) = 0;
+    // these are implemented by the derived class and allow reading / writing to the lattice, a span of a row at a time: cells [x, x + count)
+    // of row y, which always lie in the lattice. readLatticeRow writes their values to values, fillLatticeRow writes value to all of them.
+    // this is called by writeLatticeData / applyInputRegion / applyOutputRegion, once per row rather than once per cell
+    virtual void readLatticeRow(int x, int y, int count, float* values) = 0;
+    virtual void fillLatticeRow(int x, int y, int count, double value) = 0;
 
     // reinitialize generator
     virtual void initialize() = 0;
+
+    // reinitialization after a parameter change, used by the property setters. the default implementation applies the requested lattice size
+    // and calls initialize. derived classes with a slow initialize can instead build the new state in the background, keep computing with
+    // the current one, and swap it in from commitInitialize. the progress of such a rebuild is exposed as initializeProgress, which is 1 otherwise.
+    // it runs on the thread of the generator: a call from another thread (readJson on the main thread) is queued there
+    virtual void reinitialize();
+    // called by ComputeEngine on computeThread between frames. swaps in the state built by reinitialize if it is ready, or waits for it if wait is set.
+    // the default implementation does nothing
+    virtual void commitInitialize(bool wait);
+
+    // simulation state saved in project files next to the parameters (see StateSnapshot), so that a loaded project resumes where it was saved.
+    // these are called on computeThread. readState is called after readJson, with the lattice size and parameters of the project already set,
+    // and returns false if the state doesn't match them, in which case the generator keeps its initialized state.
+    // the default implementations save nothing
+    virtual void writeState(StateWriter& writer);
+    virtual bool readState(StateReader& reader);
+
+    // seed used by initialize and the following iterations. when a seed is set, the same seed and parameters always give the same run,
+    // otherwise a new seed is drawn from std::random_device on every initialize. this doesn't reinitialize the generator by itself
+    void writeRandomSeed(quint32 randomSeed);
+    void clearRandomSeed();
+    bool hasRandomSeed() const;
+    quint32 getRandomSeed() const;
     void resetParameters();
     void resetRegions();
 
@@ -159,10 +210,29 @@ public:
     // this updates the lattice / region from the corresponding region / lattice. this is called before / after the call to computeIteration from ComputeEngine
     void applyInputRegion();
     void applyOutputRegion();
+    // cells of a region's rect that lie in the lattice, which may have been resized since the region was placed
+    QRect getLatticeRect(GeneratorRegion* region) const;
 
     GeneratorRegionSet* getInputRegionSet();
     GeneratorRegionSet* getOutputRegionSet();
 
+    // timing of this generator's pipeline. input, compute and output are recorded by ComputeEngine, lattice export by writeLatticeData.
+    // this must only be accessed from computeThread, or from the worker computing this generator during a frame
+    GeneratorLatency* getLatency();
+
+    // statistics specific to the derived class, added by ComputeEngine to the entry of this generator in statsUpdated.
+    // these are called from computeThread between frames. the default implementations do nothing
+    virtual void writeStats(QVariantMap& stats);
+    virtual void resetStats();
+
+    // input frames received over OSC and not applied yet. OscEngine is the producer (oscThread), ComputeEngine is the consumer (computeThread or its workers).
+    // this is a shared pointer so that OscEngine can keep using it safely if the generator is deleted first
+    QSharedPointer<InputFrameRing> getInputRing();
+
+    // pool of ComputeEngine, set on computeThread when the generator is added. computeIteration can split its work on it
+    // with parallelFor, and must run on a single thread while it is null
+    void setWorkerPool(QSharedPointer<ComputeWorkerPool> workerPool);
+
     // OSC experiments
 //    QVector<int> OSCPorts;
 //    int createOSCInputPort();
@@ -170,6 +240,20 @@ protected:
     int latticeWidth = 50;                      // lattice width
     int latticeHeight = 50;                     // lattice height
     double timeScale = 100;
+    double tickRate = 60;                       // iterations per second, see getTickRate
+
+    int requestedLatticeWidth = 50;             // lattice size written to the properties. it differs from latticeWidth / latticeHeight
+    int requestedLatticeHeight = 50;            // until a background reinitialization is committed
+
+    std::mt19937 randomGenerator;               // source of every random number drawn by the derived class
+
+    QSharedPointer<ComputeWorkerPool> workerPool;   // see setWorkerPool
+
+    // seeds randomGenerator according to writeRandomSeed. derived classes call this at the start of initialize
+    void seedRandomGenerator();
+
+    // updates initializeProgress, in [0, 1]
+    void writeInitializeProgress(double initializeProgress);
 private:
     int id;                                     // generator id, generated automatically by ComputeEngine in constructor
 
@@ -178,6 +262,7 @@ private:
     QString userNotes;                          // user notes, modifiable
     double historyLatest = 0;                   // latest value for the history graph
     bool historyRefresher = false;              // bool that flips every time history latest is refreshed. this is an ugly workaround to prevent Qt from ignoring updates of historyLatest where the value doesn't change.
+    double initializeProgress = 1.0;            // see reinitialize
 
     int oscInputPort = 6668;                           // generator osc input port, assigned by user
     QString oscInputAddress = "/input";         // generator osc input address, assigned by user (this is an osc destination)
@@ -188,7 +273,15 @@ private:
 
     bool flagDebug = false;                     // enables debug
 
+    quint32 randomSeed = 0;                     // see writeRandomSeed
+    bool flagRandomSeed = false;                // whether randomSeed is used instead of std::random_device
+
     QMutex latticeDataMutex;                    // mutex used by writeLatticeData
+    std::vector<float> regionRowValues;         // row span read by applyOutputRegion
+
+    GeneratorLatency latency;                   // stage timings, see getLatency
+
+    QSharedPointer<InputFrameRing> inputRing;   // see getInputRing
 
     QSharedPointer<GeneratorRegionSet> inputRegionSet;
     QSharedPointer<GeneratorRegionSet> outputRegionSet;
@@ -238,6 +331,7 @@ signals:
     void userNotesChanged(QString userNotes);
     void historyLatestChanged(double historyLatest);
     void historyRefresherChanged(bool historyRefresher);
+    void initializeProgressChanged(double initializeProgress);
 
     void oscReceiverPortChanged(int oscInputPort);
     void oscInputAddressChanged(QString oscInputAddress);
@@ -252,6 +346,7 @@ signals:
     void latticeWidthChanged(int latticeWidth);
     void latticeHeightChanged(int latticeHeight);
     void timeScaleChanged(double timeScale);
+    void tickRateChanged(double tickRate);
 
     // tells the GeneratorLatticeCommunicator that the previously created writeLatticeData request is completed, and that a new one can be started at the end of the current render frame.
     //
@@ -116,7 +116,10 @@ GeneratorRegionSet* GeneratorFacade::getOutputRegionModel() {
 // i'll be quite frank... this is rather dumb
 void GeneratorFacade::initialize()
 {
-    generator->initialize();
+    // the generator lives on computeThread, where this rebuilds it in the background
+    QMetaObject::invokeMethod(generator, [=]() {
+        generator->reinitialize();
+    }, Qt::QueuedConnection);
 }
 
 void GeneratorFacade::resetParameters()
@@ -0,0 +1,483 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "HashLife.h"
+
+HashLife::HashLife() {
+    clear();
+}
+
+void HashLife::clear() {
+    nodes.clear();
+    buckets.assign(1 << 16, -1);
+    freeList = -1;
+    nodeCount = 0;
+
+    emptyNodes.assign(maxLevel + 1, -1);
+    emptyNodes[leafLevel] = leaf(0);
+    for(int level = leafLevel + 1; level <= maxLevel; level++) {
+        int child = emptyNodes[level - 1];
+        emptyNodes[level] = join(child, child, child, child);
+    }
+
+    // the smallest root that isPadded can check
+    root = empty(leafLevel + 2);
+    generation = 0;
+}
+
+void HashLife::setRule(const LifeRule& rule) {
+    this->rule = rule;
+    for(Node& node : nodes) {
+        node.result = -1;
+        node.resultStep = -1;
+    }
+}
+
+quint64 HashLife::hashLeaf(quint64 bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return bits;
+}
+
+quint64 HashLife::hashNode(const int children[4]) {
+    quint64 hash = 0;
+    for(int i = 0; i < 4; i++) {
+        hash = (hash + (quint32) children[i]) * 0x9e3779b97f4a7c15ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+int HashLife::allocate() {
+    int index;
+    if(freeList >= 0) {
+        index = freeList;
+        freeList = nodes[index].next;
+        nodes[index] = Node();
+    } else {
+        index = (int) nodes.size();
+        nodes.emplace_back();
+    }
+    nodeCount++;
+    return index;
+}
+
+void HashLife::insertBucket(int index, quint64 hash) {
+    int bucket = (int) (hash & (buckets.size() - 1));
+    nodes[index].next = buckets[bucket];
+    buckets[bucket] = index;
+}
+
+void HashLife::growBuckets() {
+    buckets.assign(buckets.size() * 2, -1);
+    for(int i = 0; i < (int) nodes.size(); i++) {
+        if(nodes[i].level >= leafLevel) {
+            insertBucket(i, nodes[i].level == leafLevel ? hashLeaf(nodes[i].bits) : hashNode(nodes[i].children));
+        }
+    }
+}
+
+int HashLife::leaf(quint64 bits) {
+    quint64 hash = hashLeaf(bits);
+    for(int i = buckets[hash & (buckets.size() - 1)]; i >= 0; i = nodes[i].next) {
+        if(nodes[i].level == leafLevel && nodes[i].bits == bits) {
+            return i;
+        }
+    }
+
+    int index = allocate();
+    nodes[index].level = leafLevel;
+    nodes[index].bits = bits;
+    insertBucket(index, hash);
+    if(nodeCount > (int) buckets.size()) {
+        growBuckets();
+    }
+    return index;
+}
+
+int HashLife::join(int nw, int ne, int sw, int se) {
+    int children[4] = {nw, ne, sw, se};
+    quint64 hash = hashNode(children);
+    for(int i = buckets[hash & (buckets.size() - 1)]; i >= 0; i = nodes[i].next) {
+        const Node& node = nodes[i];
+        if(node.level > leafLevel && node.children[0] == nw && node.children[1] == ne && node.children[2] == sw && node.children[3] == se) {
+            return i;
+        }
+    }
+
+    int level = nodes[nw].level + 1;
+    int index = allocate();
+    nodes[index].level = level;
+    std::copy(children, children + 4, nodes[index].children);
+    insertBucket(index, hash);
+    if(nodeCount > (int) buckets.size()) {
+        growBuckets();
+    }
+    return index;
+}
+
+// the 16x16 cells of a node of level leafLevel + 1, one row of 16 bits per entry
+static void readBlock(quint64 nw, quint64 ne, quint64 sw, quint64 se, quint32 rows[16]) {
+    for(int y = 0; y < 8; y++) {
+        rows[y] = ((nw >> (8 * y)) & 0xff) | (((ne >> (8 * y)) & 0xff) << 8);
+        rows[y + 8] = ((sw >> (8 * y)) & 0xff) | (((se >> (8 * y)) & 0xff) << 8);
+    }
+}
+
+// the 8x8 cells at the center of a 16x16 block
+static quint64 centerOfBlock(const quint32 rows[16]) {
+    quint64 bits = 0;
+    for(int y = 0; y < 8; y++) {
+        bits |= (quint64) ((rows[y + 4] >> 4) & 0xff) << (8 * y);
+    }
+    return bits;
+}
+
+int HashLife::centered(int node) {
+    const Node& n = nodes[node];
+    if(n.level == leafLevel + 1) {
+        quint32 rows[16];
+        readBlock(nodes[n.children[0]].bits, nodes[n.children[1]].bits, nodes[n.children[2]].bits, nodes[n.children[3]].bits, rows);
+        return leaf(centerOfBlock(rows));
+    }
+
+    int nw = nodes[n.children[0]].children[3];
+    int ne = nodes[n.children[1]].children[2];
+    int sw = nodes[n.children[2]].children[1];
+    int se = nodes[n.children[3]].children[0];
+    return join(nw, ne, sw, se);
+}
+
+int HashLife::advanceBase(int node, int stepLog) {
+    const Node& n = nodes[node];
+    quint32 rows[16];
+    readBlock(nodes[n.children[0]].bits, nodes[n.children[1]].bits, nodes[n.children[2]].bits, nodes[n.children[3]].bits, rows);
+
+    // same bit-sliced neighbour count as GameOfLife::computeRows, on rows of 16 cells. cells outside of the block are dead, which only
+    // affects cells up to one cell further in per generation with a radius 1 rule, so the center stays exact for the 4 generations a block can advance
+    for(int generation = 0; generation < (1 << stepLog); generation++) {
+        quint32 next[16];
+        for(int y = 0; y < 16; y++) {
+            quint32 above = y > 0 ? rows[y - 1] : 0;
+            quint32 below = y < 15 ? rows[y + 1] : 0;
+            quint32 row = rows[y];
+
+            next[y] = rule.stepWord<quint32>(above << 1, above, above >> 1, row << 1, row, row >> 1, below << 1, below, below >> 1) & 0xffff;
+        }
+        std::copy(next, next + 16, rows);
+    }
+
+    return leaf(centerOfBlock(rows));
+}
+
+int HashLife::advance(int node, int stepLog) {
+    if(nodes[node].result >= 0 && nodes[node].resultStep == stepLog) {
+        return nodes[node].result;
+    }
+
+    int level = nodes[node].level;
+    int result;
+
+    if(level == leafLevel + 1) {
+        result = advanceBase(node, stepLog);
+    } else {
+        // nodes may move when the pool grows, so everything needed is copied first
+        int c[4];
+        int g[4][4];
+        std::copy(nodes[node].children, nodes[node].children + 4, c);
+        for(int i = 0; i < 4; i++) {
+            std::copy(nodes[c[i]].children, nodes[c[i]].children + 4, g[i]);
+        }
+
+        // the 9 overlapping nodes of level - 1 on a 3x3 grid, each a quarter of the node apart
+        int n[3][3] = {
+            {c[0], join(g[0][1], g[1][0], g[0][3], g[1][2]), c[1]},
+            {join(g[0][2], g[0][3], g[2][0], g[2][1]), join(g[0][3], g[1][2], g[2][1], g[3][0]), join(g[1][2], g[1][3], g[3][0], g[3][1])},
+            {c[2], join(g[2][1], g[3][0], g[2][3], g[3][2]), c[3]}
+        };
+
+        // at full speed, both rounds advance by half of the step. slower steps only advance in the second round
+        bool fullSpeed = stepLog == level - 2;
+        int r[3][3];
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) {
+                r[i][j] = fullSpeed ? advance(n[i][j], level - 3) : centered(n[i][j]);
+            }
+        }
+
+        int secondStep = fullSpeed ? level - 3 : stepLog;
+        int nw = advance(join(r[0][0], r[0][1], r[1][0], r[1][1]), secondStep);
+        int ne = advance(join(r[0][1], r[0][2], r[1][1], r[1][2]), secondStep);
+        int sw = advance(join(r[1][0], r[1][1], r[2][0], r[2][1]), secondStep);
+        int se = advance(join(r[1][1], r[1][2], r[2][1], r[2][2]), secondStep);
+        result = join(nw, ne, sw, se);
+    }
+
+    nodes[node].result = result;
+    nodes[node].resultStep = stepLog;
+    return result;
+}
+
+void HashLife::expand() {
+    int level = nodes[root].level;
+    int e = empty(level - 1);
+    int c[4];
+    std::copy(nodes[root].children, nodes[root].children + 4, c);
+
+    root = join(join(e, e, e, c[0]), join(e, e, c[1], e), join(e, c[2], e, e), join(c[3], e, e, e));
+}
+
+bool HashLife::isPadded() const {
+    // the grandchild of each child that touches the center is the only one allowed to hold cells
+    const int inner[4] = {3, 2, 1, 0};
+    for(int i = 0; i < 4; i++) {
+        const Node& child = nodes[nodes[root].children[i]];
+        for(int j = 0; j < 4; j++) {
+            if(j != inner[i] && child.children[j] != empty(child.level - 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void HashLife::step(int stepLog) {
+    if(nodeCount > nodeBudget) {
+        collectGarbage();
+    }
+
+    // the result of the root is its center half, so the root is first grown until the world fits in its center quarter with room for the step.
+    // patterns in life grow by at most half a cell per generation, so one more expansion keeps everything they can reach inside the result
+    while((!isPadded() || nodes[root].level < stepLog + 2) && nodes[root].level < maxLevel) {
+        expand();
+    }
+    if(nodes[root].level < maxLevel) {
+        expand();
+    }
+
+    root = advance(root, std::min(stepLog, nodes[root].level - 2));
+    generation += (quint64) 1 << stepLog;
+}
+
+int HashLife::setCell(int node, qint64 x, qint64 y, bool alive) {
+    const Node& n = nodes[node];
+    if(n.level == leafLevel) {
+        quint64 bit = (quint64) 1 << (8 * y + x);
+        return leaf(alive ? n.bits | bit : n.bits & ~bit);
+    }
+
+    qint64 half = (qint64) 1 << (n.level - 1);
+    int c[4];
+    std::copy(n.children, n.children + 4, c);
+    int quadrant = (y >= half ? 2 : 0) + (x >= half ? 1 : 0);
+    c[quadrant] = setCell(c[quadrant], x % half, y % half, alive);
+    return join(c[0], c[1], c[2], c[3]);
+}
+
+void HashLife::setCell(qint64 x, qint64 y, bool alive) {
+    qint64 half = (qint64) 1 << (nodes[root].level - 1);
+    while((x < -half || x >= half || y < -half || y >= half) && nodes[root].level < maxLevel) {
+        expand();
+        half *= 2;
+    }
+    if(x < -half || x >= half || y < -half || y >= half) {
+        return;
+    }
+    root = setCell(root, x + half, y + half, alive);
+}
+
+bool HashLife::getCell(qint64 x, qint64 y) const {
+    qint64 half = (qint64) 1 << (nodes[root].level - 1);
+    if(x < -half || x >= half || y < -half || y >= half) {
+        return false;
+    }
+    x += half;
+    y += half;
+
+    int node = root;
+    while(nodes[node].level > leafLevel) {
+        half = (qint64) 1 << (nodes[node].level - 1);
+        node = nodes[node].children[(y >= half ? 2 : 0) + (x >= half ? 1 : 0)];
+        x %= half;
+        y %= half;
+    }
+    return (nodes[node].bits >> (8 * y + x)) & 1;
+}
+
+void HashLife::render(int node, qint64 nodeX, qint64 nodeY, qint64 x, qint64 y, int width, int height, quint64* rows, int wordsPerRow) const {
+    const Node& n = nodes[node];
+    qint64 size = (qint64) 1 << n.level;
+    if(node == empty(n.level) || nodeX >= x + width || nodeY >= y + height || nodeX + size <= x || nodeY + size <= y) {
+        return;
+    }
+
+    if(n.level == leafLevel) {
+        for(int row = 0; row < 8; row++) {
+            qint64 cellY = nodeY + row - y;
+            if(cellY < 0 || cellY >= height) {
+                continue;
+            }
+            for(int column = 0; column < 8; column++) {
+                qint64 cellX = nodeX + column - x;
+                if(((n.bits >> (8 * row + column)) & 1) && cellX >= 0 && cellX < width) {
+                    rows[cellY * wordsPerRow + cellX / 64] |= (quint64) 1 << (cellX % 64);
+                }
+            }
+        }
+        return;
+    }
+
+    qint64 half = size / 2;
+    render(n.children[0], nodeX, nodeY, x, y, width, height, rows, wordsPerRow);
+    render(n.children[1], nodeX + half, nodeY, x, y, width, height, rows, wordsPerRow);
+    render(n.children[2], nodeX, nodeY + half, x, y, width, height, rows, wordsPerRow);
+    render(n.children[3], nodeX + half, nodeY + half, x, y, width, height, rows, wordsPerRow);
+}
+
+void HashLife::render(qint64 x, qint64 y, int width, int height, quint64* rows, int wordsPerRow) const {
+    std::fill(rows, rows + height * wordsPerRow, 0);
+    qint64 half = (qint64) 1 << (nodes[root].level - 1);
+    render(root, -half, -half, x, y, width, height, rows, wordsPerRow);
+}
+
+void HashLife::mark(int node) {
+    if(nodes[node].marked) {
+        return;
+    }
+    nodes[node].marked = true;
+    if(nodes[node].level > leafLevel) {
+        for(int i = 0; i < 4; i++) {
+            mark(nodes[node].children[i]);
+        }
+    }
+}
+
+void HashLife::collectGarbage() {
+    mark(root);
+    for(int node : emptyNodes) {
+        if(node >= 0) {
+            mark(node);
+        }
+    }
+
+    // results of the remaining nodes are kept when they survive too
+    for(Node& node : nodes) {
+        if(node.marked && node.result >= 0 && !nodes[node.result].marked) {
+            node.result = -1;
+        }
+    }
+
+    std::fill(buckets.begin(), buckets.end(), -1);
+    freeList = -1;
+    nodeCount = 0;
+    for(int i = (int) nodes.size() - 1; i >= 0; i--) {
+        Node& node = nodes[i];
+        if(node.marked) {
+            node.marked = false;
+            insertBucket(i, node.level == leafLevel ? hashLeaf(node.bits) : hashNode(node.children));
+            nodeCount++;
+        } else {
+            node.level = -1;
+            node.next = freeList;
+            freeList = i;
+        }
+    }
+}
+
+// a node of a saved world. children are indices in the saved list, which always come before their parent. reserved fills the
+// padding before bits, so that the saved bytes are all written
+struct SavedHashLifeNode {
+    qint32 level;
+    qint32 children[4];
+    qint32 reserved;
+    quint64 bits;
+};
+static_assert(sizeof(SavedHashLifeNode) == 32, "SavedHashLifeNode must not have padding");
+
+void HashLife::writeState(StateWriter& writer) const {
+    // reachable nodes in post-order, so that children are restored first
+    std::vector<SavedHashLifeNode> saved;
+    std::vector<int> savedIndex(nodes.size(), -1);
+    std::vector<std::pair<int, int>> stack = {{root, 0}};
+    while(!stack.empty()) {
+        int node = stack.back().first;
+        int& visited = stack.back().second;
+        const Node& n = nodes[node];
+        if(savedIndex[node] >= 0) {
+            stack.pop_back();
+        } else if(n.level > leafLevel && visited < 4) {
+            stack.push_back({n.children[visited++], 0});
+        } else {
+            SavedHashLifeNode entry = {n.level, {-1, -1, -1, -1}, 0, n.bits};
+            if(n.level > leafLevel) {
+                for(int i = 0; i < 4; i++) {
+                    entry.children[i] = savedIndex[n.children[i]];
+                }
+            }
+            savedIndex[node] = (int) saved.size();
+            saved.push_back(entry);
+            stack.pop_back();
+        }
+    }
+
+    writer.writeValue(generation);
+    writer.writeValue((qint32) saved.size());
+    writer.writeArray(saved.data(), (qint64) saved.size());
+}
+
+bool HashLife::readState(StateReader& reader) {
+    clear();
+
+    quint64 savedGeneration;
+    qint32 count;
+    if(!reader.readValue(savedGeneration) || !reader.readValue(count) || count <= 0) {
+        return false;
+    }
+    const SavedHashLifeNode* saved = reader.readArray<SavedHashLifeNode>(count);
+    if(saved == nullptr) {
+        return false;
+    }
+
+    std::vector<int> restored(count);
+    for(int i = 0; i < count; i++) {
+        const SavedHashLifeNode& entry = saved[i];
+        if(entry.level == leafLevel) {
+            restored[i] = leaf(entry.bits);
+            continue;
+        }
+        if(entry.level <= leafLevel || entry.level > maxLevel) {
+            clear();
+            return false;
+        }
+        for(int j = 0; j < 4; j++) {
+            if(entry.children[j] < 0 || entry.children[j] >= i || saved[entry.children[j]].level != entry.level - 1) {
+                clear();
+                return false;
+            }
+        }
+        restored[i] = join(restored[entry.children[0]], restored[entry.children[1]], restored[entry.children[2]], restored[entry.children[3]]);
+    }
+
+    if(saved[count - 1].level < leafLevel + 2) {
+        clear();
+        return false;
+    }
+    root = restored[count - 1];
+    generation = savedGeneration;
+    return true;
+}
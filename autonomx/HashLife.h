@@ -0,0 +1,115 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QtGlobal>
+#include <vector>
+
+#include "LifeRule.h"
+#include "StateSnapshot.h"
+
+// a life-like rule (Conway's B3/S23 unless set otherwise) on an unbounded plane, with Gosper's HashLife algorithm.
+//
+// the plane is a quadtree centered on (0, 0). identical subtrees are stored once: nodes are canonical, looked up by their children in a hash
+// table before being created, so repetitive or empty areas cost almost nothing. each node memoizes its result, the center half of the node
+// advanced by 2^stepLog generations, so a pattern that repeats in space or time is only computed once, and large step sizes skip
+// generations that would have to be computed one by one otherwise.
+//
+// the leaves are 8x8 blocks of cells stored as bits (bit 8 * y + x). nodes are stored in a pool and referred to by index.
+// once the pool holds more than nodeBudget nodes, step collects the nodes that can't be reached from the current world, so memory stays
+// constant for patterns that don't keep growing.
+class HashLife {
+public:
+    HashLife();
+
+    // removes every cell
+    void clear();
+
+    void setCell(qint64 x, qint64 y, bool alive);
+    bool getCell(qint64 x, qint64 y) const;
+
+    // rule applied from now on, which must be HashLife compatible (see LifeRule::isHashLifeCompatible). memoized results are forgotten
+    void setRule(const LifeRule& rule);
+
+    // advances the world by 2^stepLog generations
+    void step(int stepLog);
+    quint64 getGeneration() const { return generation; }
+
+    // writes the cells of [x, x + width) x [y, y + height) to rows of wordsPerRow words, bit-packed 64 cells per word as GameOfLife does
+    void render(qint64 x, qint64 y, int width, int height, quint64* rows, int wordsPerRow) const;
+
+    int getNodeCount() const { return nodeCount; }
+
+    // the world and its generation, see Generator::writeState. readState leaves the world empty if the state can't be read
+    void writeState(StateWriter& writer) const;
+    bool readState(StateReader& reader);
+private:
+    static const int leafLevel = 3;             // leaves are 2^3 cells wide
+    static const int maxLevel = 60;             // the plane is 2^60 cells wide at most
+    static const int nodeBudget = 1 << 20;      // nodes kept before collecting garbage
+
+    struct Node {
+        int level = 0;
+        int children[4] = {-1, -1, -1, -1};     // nw, ne, sw, se, for levels above leafLevel
+        quint64 bits = 0;                       // cells, for leaves
+        int result = -1;                        // memoized result for resultStep, or -1
+        int resultStep = -1;
+        int next = -1;                          // next node in the same hash bucket, or in the free list
+        bool marked = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> buckets;
+    int freeList = -1;
+    int nodeCount = 0;
+    std::vector<int> emptyNodes;                // canonical empty node of each level
+
+    int root;
+    quint64 generation = 0;
+    LifeRule rule;
+
+    static quint64 hashLeaf(quint64 bits);
+    static quint64 hashNode(const int children[4]);
+
+    int allocate();
+    void insertBucket(int index, quint64 hash);
+    void growBuckets();
+
+    // canonical nodes
+    int leaf(quint64 bits);
+    int join(int nw, int ne, int sw, int se);
+    int empty(int level) const { return emptyNodes[level]; }
+
+    // the node of level - 1 at the center of a node
+    int centered(int node);
+    // the center half of a node advanced by 2^stepLog generations, stepLog being at most its level - 2
+    int advance(int node, int stepLog);
+    // base case, for nodes of level leafLevel + 1
+    int advanceBase(int node, int stepLog);
+
+    // doubles the size of the root, keeping the world in its center
+    void expand();
+    // whether everything outside of the center quarter of the root is empty
+    bool isPadded() const;
+
+    int setCell(int node, qint64 x, qint64 y, bool alive);
+    void render(int node, qint64 nodeX, qint64 nodeY, qint64 x, qint64 y, int width, int height, quint64* rows, int wordsPerRow) const;
+
+    // frees the nodes that can't be reached from the root
+    void collectGarbage();
+    void mark(int node);
+};
@@ -13,185 +13,259 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <random>
 
 #include "Izhikevich.h"
 
+// the kernels are written once for any batch type B of SimdBatch.h. counts and range bounds are always multiples of the batch width
+
+// integrates v and u over [begin, end) then resets the neurons above the threshold, repeated substeps times on each register before it is
+// stored. the threshold is checked after every substep, and a neuron fires on the iteration if it crossed it in any of them.
+// spikes receives the firing indices below spikeLimit, the padding past it is left out. returns the number of spikes added
+template<typename B, typename T>
+static int stepKernel(T* v, T* u, T* I, const T* a, const T* b, const T* c, const T* d, quint8* firing, int* spikes,
+                      int begin, int end, int spikeLimit, int substeps, T halfStep, T step, T potentialThreshold) {
+    typedef typename B::Register Register;
+    const Register k0_04 = B::set(0.04);
+    const Register k5 = B::set(5);
+    const Register k140 = B::set(140);
+    const Register zero = B::set(0);
+    const Register h = B::set(halfStep);
+    const Register dt = B::set(step);
+    const Register threshold = B::set(potentialThreshold);
+    int spikeCount = 0;
+
+    for(int i = begin; i < end; i += B::width) {
+        Register vi = B::load(v + i);
+        Register ui = B::load(u + i);
+        Register Ii = B::load(I + i);
+        Register ai = B::load(a + i);
+        Register bi = B::load(b + i);
+        Register ci = B::load(c + i);
+        Register di = B::load(d + i);
+        int bits = 0;
+
+        // the input current is held over the whole iteration
+        for(int substep = 0; substep < substeps; substep++) {
+            vi = B::add(vi, B::multiply(h, B::add(B::subtract(B::add(B::add(B::multiply(B::multiply(k0_04, vi), vi), B::multiply(k5, vi)), k140), ui), Ii)));
+            vi = B::add(vi, B::multiply(h, B::add(B::subtract(B::add(B::add(B::multiply(B::multiply(k0_04, vi), vi), B::multiply(k5, vi)), k140), ui), Ii)));
+            ui = B::add(ui, B::multiply(B::multiply(dt, ai), B::subtract(B::multiply(bi, vi), ui)));
+
+            typename B::Mask isFiring = B::greater(vi, threshold);
+            vi = B::select(isFiring, ci, vi);
+            ui = B::select(isFiring, B::add(ui, di), ui);
+            bits |= B::bits(isFiring);
+        }
+
+        B::store(v + i, vi);
+        B::store(u + i, ui);
+        B::store(I + i, zero);
+
+        for(int lane = 0; lane < B::width; lane++) {
+            firing[i + lane] = (bits >> lane) & 1;
+        }
+
+        if(bits != 0) {
+            for(int lane = 0; lane < B::width; lane++) {
+                if(((bits >> lane) & 1) && i + lane < spikeLimit) {
+                    spikes[spikeCount++] = i + lane;
+                }
+            }
+        }
+    }
+
+    return spikeCount;
+}
+
+template<typename B, typename T>
+static void normalizeKernel(const T* v, const T* c, T* output, int count, T potentialThreshold) {
+    typedef typename B::Register Register;
+    const Register threshold = B::set(potentialThreshold);
+    const Register zero = B::set(0);
+    const Register one = B::set(1);
+
+    for(int i = 0; i < count; i += B::width) {
+        Register ci = B::load(c + i);
+        Register value = B::divide(B::subtract(B::load(v + i), ci), B::subtract(threshold, ci));
+        B::store(output + i, B::min(one, B::max(zero, value)));
+    }
+}
+
 Izhikevich::Izhikevich() {
-    
-    firing = false;
-    
-    //set param as default Ne.
-    setNeuronType(NeuronType::SpikingNeuronRandomized);
-    u = b * v;
-    I = 0.;
-    potentialThreshold = 20.;
 }
 
 Izhikevich::~Izhikevich() {
 }
 
-void Izhikevich::setParam(NeuronType type, double a, double b, double c, double d, double u, double v, double I) {
-    this->type = type;
-    this->a = a;
-    this->b = b;
-    this->c = c;
-    this->d = d;
-    this->u = u;
-    this->v = v;
-    this->I = I;
+void Izhikevich::resize(int size) {
+    int previousPaddedCount = paddedCount;
+    count = size;
+    paddedCount = (size + simdPadding - 1) / simdPadding * simdPadding;
+
+    v.resize(paddedCount);
+    u.resize(paddedCount);
+    I.resize(paddedCount);
+    a.resize(paddedCount);
+    b.resize(paddedCount);
+    c.resize(paddedCount);
+    d.resize(paddedCount);
+    // nothing is firing in a resized population
+    firing.assign(paddedCount, 0);
+    spikes.resize(paddedCount);
+    spikeCount = 0;
+    types.resize(paddedCount);
+
+    // the padding is made of real neurons at rest, so the kernels can run over it without special cases. it is never read
+    for(int i = previousPaddedCount; i < paddedCount; i++) {
+        setNeuronType(i, NeuronType::SpikingNeuronRandomized);
+    }
 }
 
-void Izhikevich::setNeuronType(NeuronType type) {
-    this->type = type;
+int Izhikevich::size() const {
+    return count;
+}
+
+int Izhikevich::getPaddedSize() const {
+    return paddedCount;
+}
+
+void Izhikevich::setNeuronType(int index, NeuronType type) {
+    types[index] = type;
     switch(type) {
         case NeuronType::SpikingNeuron: {
-            a = 0.02;
-            b = 0.2;
-            c = -65.;
-            d = 8.;
+            a[index] = 0.02;
+            b[index] = 0.2;
+            c[index] = -65.;
+            d[index] = 8.;
             break;
         }
         case NeuronType::SpikingNeuronRandomized: {
             std::mt19937 randomGenerator;
             std::uniform_real_distribution<> randomUniform(0.0, 1.0);
             double random = randomUniform(randomGenerator);
-            a = 0.02;
-            b = 0.2;
-            c = -65. + 15. * random * random;
-            d = 8. - 6.* random * random;
+            a[index] = 0.02;
+            b[index] = 0.2;
+            c[index] = -65. + 15. * random * random;
+            d[index] = 8. - 6.* random * random;
             break;
         }
         case NeuronType::ResonatorNeuron: {
-            a = 0.1;
-            b = 0.2;
-            c = -65.;
-            d = 2.;
+            a[index] = 0.1;
+            b[index] = 0.2;
+            c[index] = -65.;
+            d[index] = 2.;
             break;
         }
         case NeuronType::ResonatorNeuronRandomized: {
             std::mt19937 randomGenerator;
             std::uniform_real_distribution<> randomUniform(0.0, 1.0);
             double random = randomUniform(randomGenerator);
-            a = 0.02 + 0.08 * random;
-            b = 0.25 - 0.05 * random;
-            c = -65.;
-            d = 2.;
+            a[index] = 0.02 + 0.08 * random;
+            b[index] = 0.25 - 0.05 * random;
+            c[index] = -65.;
+            d[index] = 2.;
             break;
         }
         case NeuronType::ChatteringNeuron: {
-            a = 0.02;
-            b = 0.2;
-            c = -50.;
-            d = 2.;
+            a[index] = 0.02;
+            b[index] = 0.2;
+            c[index] = -50.;
+            d[index] = 2.;
             break;
         }
-        // pretty sure none of these are really necessary,
-        // less so used in the actual GUI ........
-//        case NeuronType::InhibitoryNeuron: {
-//            a = 0.1;
-//            b = 0.2;
-//            c = -65.;
-//            d = 2.;
-//            break;
-//        }
-//        case NeuronType::InhibitoryNeuronRandomized: {
-//            std::mt19937 randomGenerator;
-//            std::uniform_real_distribution<> randomUniform(0.0, 1.0);
-//            double random = randomUniform(randomGenerator);
-//            a = 0.1;
-//            b = 0.25 - 0.05 * random;
-//            c = -65.;
-//            d = 2.;
-//            break;
-//        }
-//        case NeuronType::ExcitatoryNeuron : {
-//            a = 0.02;
-//            b = 0.2;
-//            c = -50.;
-//            d = 2.;
-//            break;
-//        }
-//        case NeuronType::ExcitatoryNeuronRandomized : {
-//            std::mt19937 randomGenerator;
-//            std::uniform_real_distribution<> randomUniform(0.0, 1.0);
-//            double random = randomUniform(randomGenerator);
-//            a = 0.02;
-//            b = 0.2;
-//            c = -65. + 15. * random * random;
-//            d = 8. - 6. * random * random;
-//            break;
-//        }
     }
-    v = -65.;
-    u = d;
-    I = 0.;
+    v[index] = -65.;
+    u[index] = d[index];
+    I[index] = 0.;
 }
 
-
-void Izhikevich::update(double deltaTime) { 
-    double deltaTimeMillis = deltaTime * 1000.0;
-    v += deltaTimeMillis * 0.5 * (0.04 * v * v + 5 * v + 140 - u + I);
-    v += deltaTimeMillis * 0.5 * (0.04 * v * v + 5 * v + 140 - u + I);
-    u += deltaTimeMillis * a * (b * v - u);
+NeuronType Izhikevich::getNeuronType(int index) const {
+    return types[index];
 }
 
-bool Izhikevich::applyFiring() {
-    
-    if(v > potentialThreshold) {
-        firing = true;
-        v = c;
-        u = u + d;
-    } else {
-        firing = false;
-    }
-    return(firing);
+void Izhikevich::step(int begin, int end, double deltaTime, int substeps) {
+    double substepMillis = deltaTime * 1000.0 / substeps;
+    spikeCount += stepKernel<SimdBatch<Scalar>, Scalar>(v.data(), u.data(), I.data(), a.data(), b.data(), c.data(), d.data(), firing.data(), spikes.data() + spikeCount,
+                                                       begin, end, count, substeps, substepMillis * 0.5, substepMillis, potentialThreshold);
 }
 
-NeuronType Izhikevich::getNeuronType() {
-    return(type);
+void Izhikevich::clearSpikes() {
+    spikeCount = 0;
 }
 
-bool Izhikevich::isFiring() {
-    return(this->firing);
-}
+void Izhikevich::writeState(StateWriter& writer) const {
+    writer.writeValue((quint32) sizeof(Scalar));
+    writer.writeValue(count);
+    writer.writeValue(potentialThreshold);
+    writer.writeValue(spikeCount);
 
-double Izhikevich::getA() {
-    return(this->a);
-}
-
-double Izhikevich::getB() {
-    return(this->b);
+    // the padding is saved as well, so that the kernels find it as they left it
+    for(const AlignedVector<Scalar>* values : {&v, &u, &I, &a, &b, &c, &d}) {
+        writer.writeArray(values->data(), paddedCount);
+    }
+    writer.writeArray(firing.data(), paddedCount);
+    writer.writeArray(spikes.data(), spikeCount);
+    writer.writeArray(types.data(), paddedCount);
 }
 
-double Izhikevich::getC() {
-    return(this->c);
+// spikes must be the neurons below count that fire, in increasing order, and firing must only hold 0 or 1
+static bool checkSpikes(const quint8* firing, const int* spikes, int spikeCount, int count, int paddedCount) {
+    int spike = 0;
+    for(int i = 0; i < paddedCount; i++) {
+        if(firing[i] > 1) {
+            return false;
+        }
+        bool listed = spike < spikeCount && spikes[spike] == i;
+        if(listed) {
+            spike++;
+        }
+        if(i < count && listed != (firing[i] == 1)) {
+            return false;
+        }
+    }
+    return spike == spikeCount;
 }
 
-double Izhikevich::getD() {
-    return(this->d);
-}
+bool Izhikevich::readState(StateReader& reader, int expectedSize) {
+    quint32 scalarSize;
+    int savedCount;
+    Scalar savedThreshold;
+    int savedSpikeCount;
+    if(!reader.readValue(scalarSize) || scalarSize != sizeof(Scalar) || !reader.readValue(savedCount) || savedCount != expectedSize ||
+       !reader.readValue(savedThreshold) || !reader.readValue(savedSpikeCount) || savedSpikeCount < 0 || savedSpikeCount > savedCount) {
+        return false;
+    }
 
-double Izhikevich::getU() {
-    return(u);
-}
+    resize(savedCount);
+    potentialThreshold = savedThreshold;
 
-double Izhikevich::getV() {
-    return(v);
-}
+    for(AlignedVector<Scalar>* values : {&v, &u, &I, &a, &b, &c, &d}) {
+        const Scalar* saved = reader.readArray<Scalar>(paddedCount);
+        if(saved == nullptr) {
+            return false;
+        }
+        std::copy(saved, saved + paddedCount, values->data());
+    }
 
-double Izhikevich::getI() {
-    return(this->I);
-}
+    const quint8* savedFiring = reader.readArray<quint8>(paddedCount);
+    const int* savedSpikes = savedFiring != nullptr ? reader.readArray<int>(savedSpikeCount) : nullptr;
+    const NeuronType* savedTypes = savedSpikes != nullptr ? reader.readArray<NeuronType>(paddedCount) : nullptr;
+    if(savedTypes == nullptr || !checkSpikes(savedFiring, savedSpikes, savedSpikeCount, count, paddedCount)) {
+        return false;
+    }
+    std::copy(savedFiring, savedFiring + paddedCount, firing.begin());
+    std::copy(savedSpikes, savedSpikes + savedSpikeCount, spikes.begin());
+    spikeCount = savedSpikeCount;
+    std::copy(savedTypes, savedTypes + paddedCount, types.begin());
 
-double Izhikevich::getPotentialThreshold() {
-    return(this->potentialThreshold);
+    return true;
 }
 
-void Izhikevich::setI(double I) {
-    this->I = I;
+void Izhikevich::computeNormalizedPotentials(Scalar* output) const {
+    normalizeKernel<SimdBatch<Scalar>, Scalar>(v.data(), c.data(), output, paddedCount, potentialThreshold);
 }
 
-void Izhikevich::addToI(double deltaI) {
-    this->I = this->I + deltaI;
+Izhikevich::Scalar Izhikevich::getPotentialThreshold() const {
+    return potentialThreshold;
 }
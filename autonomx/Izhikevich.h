@@ -15,47 +15,89 @@
 
 #pragma once
 
-#include <iostream>
+#include <QtGlobal>
 #include <vector>
 
 #include "NeuronType.h"
+#include "SimdBatch.h"
+#include "StateSnapshot.h"
 
-class Izhikevich {
-private:
-    double potentialThreshold;
-    double u;
-    double v;
-    NeuronType type;
-    double I;
-    double a, b, c, d;
+// precision of the neuron state. double by default, float with CONFIG += neuron_float32 in autonomx.pro,
+// which halves the memory traffic and doubles the number of neurons per SIMD register
+#ifdef AUTONOMX_NEURON_FLOAT
+typedef float NeuronScalar;
+#else
+typedef double NeuronScalar;
+#endif
 
+// population of Izhikevich neurons.
+//
+// the state of the neurons is stored as one aligned array per variable (structure of arrays), so that step and computeNormalizedPotentials
+// are single loops over whole SIMD registers (see SimdBatch.h). neurons are addressed by index.
+class Izhikevich {
 public:
+    typedef NeuronScalar Scalar;
+
     Izhikevich();
     ~Izhikevich();
 
-    void update(double deltaTime);
-    void setParam(NeuronType type, double a, double b, double c, double d, double u, double v, double I);
-    void setNeuronType(NeuronType type);
-    bool applyFiring(); // checks if the neuron is firing and updates the differential equationa accordingly
-    NeuronType getNeuronType();
-    bool isFiring();
-    
-    void setA(double a){ this->a = a; };
-    void setB(double b){ this->b = b; }
-    void setC(double c){ this->c = c; }
-    void setD(double d){ this->d = d; }
-
-    double getA();
-    double getB();
-    double getC();
-    double getD();
-    double getU();
-    double getV();
-    double getI();
-    double getPotentialThreshold();
-    void setI(double I);
-    void addToI(double deltaI);
-    
-    bool firing;
+    // changes the number of neurons. new neurons are randomized spiking neurons at rest
+    void resize(int size);
+    int size() const;
+    // size of the arrays, a multiple of simdPadding. buffers given to computeNormalizedPotentials must have this size
+    int getPaddedSize() const;
+
+    // sets the parameters of a neuron from a preset and puts it back at rest
+    void setNeuronType(int index, NeuronType type);
+    NeuronType getNeuronType(int index) const;
+
+    // integrates the neurons in [begin, end) over deltaTime (in seconds), two half steps for v and one step for u, then resets the neurons
+    // above the potential threshold and sets their firing status. the input currents are cleared afterwards. begin and end must be multiples
+    // of simdPadding, or end getPaddedSize(). the indices of the firing neurons are appended to the spikes (see getSpikes) in increasing order,
+    // so the ranges of an iteration must come in increasing order after clearSpikes.
+    // deltaTime is split into substeps equal steps, with the threshold checked after each. large steps make v diverge before it is checked,
+    // so callers pick substeps to keep every step small, see SpikingNet::integrationStep
+    void step(int begin, int end, double deltaTime, int substeps = 1);
+    void clearSpikes();
+
+    // writes (v - c) / (threshold - c), clamped to [0, 1], for every neuron. output must hold getPaddedSize() values and be aligned on simdAlignment
+    void computeNormalizedPotentials(Scalar* output) const;
+
+    bool isFiring(int index) const { return firing[index] != 0; }
+
+    // neurons that fired since the last clearSpikes, in increasing order
+    const int* getSpikes() const { return spikes.data(); }
+    int getSpikeCount() const { return spikeCount; }
+    void addToI(int index, Scalar deltaI) { I[index] += deltaI; }
+
+    Scalar getA(int index) const { return a[index]; }
+    Scalar getB(int index) const { return b[index]; }
+    Scalar getC(int index) const { return c[index]; }
+    Scalar getD(int index) const { return d[index]; }
+    Scalar getU(int index) const { return u[index]; }
+    Scalar getV(int index) const { return v[index]; }
+    Scalar getI(int index) const { return I[index]; }
+    Scalar getPotentialThreshold() const;
+
+    // the whole state of the population, see Generator::writeState. readState fails if the state was saved with another Scalar type,
+    // for another number of neurons than expectedSize or is inconsistent, in which case the population is left in an unspecified state
+    void writeState(StateWriter& writer) const;
+    bool readState(StateReader& reader, int expectedSize);
+
+private:
+    int count = 0;
+    int paddedCount = 0;
+    Scalar potentialThreshold = 20.;
 
+    AlignedVector<Scalar> v;
+    AlignedVector<Scalar> u;
+    AlignedVector<Scalar> I;
+    AlignedVector<Scalar> a;
+    AlignedVector<Scalar> b;
+    AlignedVector<Scalar> c;
+    AlignedVector<Scalar> d;
+    std::vector<quint8> firing;
+    std::vector<int> spikes;
+    int spikeCount = 0;
+    std::vector<NeuronType> types;
 };
@@ -0,0 +1,124 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <QtAlgorithms>
+
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+    counts.resize((maxValueBits - subBucketBits + 2) * subBucketCount, 0);
+}
+
+int LatencyHistogram::bucketIndex(qint64 value) {
+    quint64 clamped = (quint64) std::min<qint64>(std::max<qint64>(value, 0), ((qint64) 1 << maxValueBits) - 1);
+
+    // values below 2 * subBucketCount have their own bucket. above that, the lowest bits are dropped so that
+    // the value keeps subBucketBits + 1 significant bits
+    int magnitude = 63 - (int) qCountLeadingZeroBits(clamped | 1);
+    int shift = std::max(0, magnitude - subBucketBits);
+    return shift * subBucketCount + (int) (clamped >> shift);
+}
+
+qint64 LatencyHistogram::bucketUpperValue(int index) {
+    int shift = std::max(0, index / subBucketCount - 1);
+    qint64 subBucket = index - shift * subBucketCount;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 value) {
+    counts[bucketIndex(value)]++;
+
+    if(count == 0 || value < min) {
+        min = value;
+    }
+    if(count == 0 || value > max) {
+        max = value;
+    }
+    count++;
+    total += value;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    count = 0;
+    min = 0;
+    max = 0;
+    total = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if(other.count == 0) {
+        return;
+    }
+
+    for(size_t i = 0; i < counts.size(); i++) {
+        counts[i] += other.counts[i];
+    }
+
+    min = count == 0 ? other.min : std::min(min, other.min);
+    max = count == 0 ? other.max : std::max(max, other.max);
+    count += other.count;
+    total += other.total;
+}
+
+quint64 LatencyHistogram::getCount() const {
+    return count;
+}
+
+qint64 LatencyHistogram::getMin() const {
+    return min;
+}
+
+qint64 LatencyHistogram::getMax() const {
+    return max;
+}
+
+double LatencyHistogram::getMean() const {
+    return count == 0 ? 0 : total / count;
+}
+
+qint64 LatencyHistogram::getPercentile(double percentile) const {
+    if(count == 0) {
+        return 0;
+    }
+
+    // rank of the sample we're looking for, counting from 1
+    quint64 rank = std::max<quint64>(1, (quint64) (std::min(100.0, std::max(0.0, percentile)) / 100.0 * count + 0.5));
+
+    quint64 seen = 0;
+    for(size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if(seen >= rank) {
+            // the bucket's upper bound can overshoot the largest sample actually recorded
+            return std::min(bucketUpperValue((int) i), max);
+        }
+    }
+
+    return max;
+}
+
+QVariantMap LatencyHistogram::toVariantMap() const {
+    QVariantMap map;
+    map.insert("count", (double) count);
+    map.insert("mean", getMean() / 1000000.0);
+    map.insert("min", min / 1000000.0);
+    map.insert("p50", getPercentile(50) / 1000000.0);
+    map.insert("p90", getPercentile(90) / 1000000.0);
+    map.insert("p99", getPercentile(99) / 1000000.0);
+    map.insert("p999", getPercentile(99.9) / 1000000.0);
+    map.insert("max", max / 1000000.0);
+    return map;
+}
@@ -0,0 +1,70 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+#include <QVariantMap>
+#include <vector>
+
+// fixed-precision latency histogram in the spirit of HdrHistogram.
+// values are in nanoseconds and grouped in buckets whose width grows with the value: every power of two is split into
+// subBucketCount linear buckets, so the relative error of any reported value is below 1 / subBucketCount whatever the range.
+// recording is a couple of integer operations and never allocates, so this can stay enabled in production.
+//
+// this isn't thread-safe. each histogram must only be recorded to by one thread at a time, and read once that thread is done
+// (ComputeEngine reads them after the frame barrier).
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(qint64 value);
+    void reset();
+
+    // adds the samples of another histogram to this one
+    void merge(const LatencyHistogram& other);
+
+    quint64 getCount() const;
+    qint64 getMin() const;
+    qint64 getMax() const;
+    double getMean() const;
+
+    // value below which the given percentage of samples fall, percentile is in [0, 100]
+    qint64 getPercentile(double percentile) const;
+
+    // summary used by the stats facade and the osc reply. times are converted to milliseconds
+    QVariantMap toVariantMap() const;
+private:
+    static const int subBucketBits = 5;
+    static const int subBucketCount = 1 << subBucketBits;
+    static const int maxValueBits = 42;         // about 73 minutes, anything larger is clamped
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketUpperValue(int index);
+
+    std::vector<quint64> counts;
+    quint64 count = 0;
+    qint64 min = 0;
+    qint64 max = 0;
+    double total = 0;
+};
+
+// latency of each stage of a single generator's pipeline
+struct GeneratorLatency {
+    LatencyHistogram input;                     // applyInputRegion
+    LatencyHistogram compute;                   // computeIteration, all the iterations of a frame together
+    LatencyHistogram output;                    // applyOutputRegion
+    LatencyHistogram latticeExport;             // writeLatticeData
+};
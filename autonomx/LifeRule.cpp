@@ -0,0 +1,140 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <QRegularExpression>
+#include <QStringList>
+
+#include "LifeRule.h"
+
+LifeRule::LifeRule() {
+    parse("B3/S23", *this);
+}
+
+// digits of a life-like rule into a mask
+static quint16 parseDigits(const QString& digits) {
+    quint16 mask = 0;
+    for(QChar digit : digits) {
+        mask |= 1 << digit.digitValue();
+    }
+    return mask;
+}
+
+bool LifeRule::parse(const QString& text, LifeRule& rule) {
+    QString normalized = text.trimmed().toUpper().remove(' ');
+
+    QRegularExpressionMatch match;
+    quint16 birthMask = 0;
+    quint16 survivalMask = 0;
+    bool lifeLike = true;
+
+    if((match = QRegularExpression("^B([0-8]*)/S([0-8]*)$").match(normalized)).hasMatch()) {
+        birthMask = parseDigits(match.captured(1));
+        survivalMask = parseDigits(match.captured(2));
+    } else if((match = QRegularExpression("^S([0-8]*)/B([0-8]*)$").match(normalized)).hasMatch() ||
+              (match = QRegularExpression("^([0-8]*)/([0-8]*)$").match(normalized)).hasMatch()) {
+        survivalMask = parseDigits(match.captured(1));
+        birthMask = parseDigits(match.captured(2));
+    } else {
+        lifeLike = false;
+    }
+
+    if(lifeLike) {
+        rule.radius = 1;
+        rule.birthMask = birthMask;
+        rule.survivalMask = survivalMask;
+        rule.birth.assign(9, 0);
+        rule.survival.assign(9, 0);
+        for(int count = 0; count <= 8; count++) {
+            rule.birth[count] = (birthMask >> count) & 1;
+            rule.survival[count] = (survivalMask >> count) & 1;
+        }
+        return true;
+    }
+
+    // Larger than Life
+    int radius = -1;
+    int states = 2;
+    bool includeCenter = false;
+    int birthRange[2] = {-1, -1};
+    int survivalRange[2] = {-1, -1};
+    QRegularExpression rangeExpression("^(\\d+)\\.\\.(\\d+)$");
+
+    for(const QString& token : normalized.split(',')) {
+        if(token.size() < 2) {
+            return false;
+        }
+        QString value = token.mid(1);
+        bool valid = true;
+        switch(token[0].toLatin1()) {
+            case 'R':
+                radius = value.toInt(&valid);
+                break;
+            case 'C':
+                states = value.toInt(&valid);
+                break;
+            case 'M':
+                includeCenter = value.toInt(&valid) != 0;
+                break;
+            case 'N':
+                valid = value == "M";
+                break;
+            case 'S':
+            case 'B': {
+                QRegularExpressionMatch range = rangeExpression.match(value);
+                int* bounds = token[0] == 'S' ? survivalRange : birthRange;
+                if(range.hasMatch()) {
+                    bounds[0] = range.captured(1).toInt();
+                    bounds[1] = range.captured(2).toInt();
+                } else {
+                    bounds[0] = bounds[1] = value.toInt(&valid);
+                }
+                break;
+            }
+            default:
+                valid = false;
+        }
+        if(!valid) {
+            return false;
+        }
+    }
+
+    // radius is limited so that counts stay far from overflowing the summed-area table of GameOfLife
+    if(radius < 1 || radius > 500 || (states != 0 && states != 2) || birthRange[0] < 0 || survivalRange[0] < 0) {
+        return false;
+    }
+
+    rule.radius = radius;
+    int neighbourCount = rule.getNeighbourCount();
+    rule.birth.assign(neighbourCount + 1, 0);
+    rule.survival.assign(neighbourCount + 1, 0);
+    for(int count = 0; count <= neighbourCount; count++) {
+        // a live cell counting itself has one more live cell in its neighbourhood
+        int survivalCount = includeCenter ? count + 1 : count;
+        rule.birth[count] = count >= birthRange[0] && count <= birthRange[1];
+        rule.survival[count] = survivalCount >= survivalRange[0] && survivalCount <= survivalRange[1];
+    }
+
+    rule.birthMask = 0;
+    rule.survivalMask = 0;
+    if(radius == 1) {
+        for(int count = 0; count <= 8; count++) {
+            rule.birthMask |= rule.birth[count] << count;
+            rule.survivalMask |= rule.survival[count] << count;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,96 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// outer totalistic rule of a two state cellular automaton on a square (Moore) neighbourhood of any radius, as used by GameOfLife and HashLife.
+//
+// rules are given in one of these notations:
+//   B3/S23             life-like rule: numbers of live neighbours (0 to 8) for which a dead cell is born / a live cell survives
+//   S23/B3 or 23/3     the same, survival first
+//   R5,C0,M1,S34..58,B34..45,NM
+//                      Larger than Life (as in Golly): radius R, C the number of states (0 or 2), M whether the cell counts itself,
+//                      S and B ranges of live cells in the neighbourhood, N the neighbourhood, only M (Moore) is supported
+//
+// whatever the notation, the compiled tables exclude the cell itself from the count.
+struct LifeRule {
+    int radius = 1;
+    std::vector<quint8> birth;          // birth[n] is 1 if a dead cell with n live neighbours comes to life
+    std::vector<quint8> survival;       // survival[n] is 1 if a live cell with n live neighbours stays alive
+    quint16 birthMask = 0;              // the same as bits, for radius 1
+    quint16 survivalMask = 0;
+
+    // B3/S23
+    LifeRule();
+
+    // compiles text into rule and returns true, or returns false and leaves rule unchanged if text isn't a valid rule
+    static bool parse(const QString& text, LifeRule& rule);
+
+    int getNeighbourCount() const { return (2 * radius + 1) * (2 * radius + 1) - 1; }
+    bool isConway() const { return radius == 1 && birthMask == (1 << 3) && survivalMask == ((1 << 2) | (1 << 3)); }
+    // rules HashLife can run: radius 1, and nothing is born out of nothing so that the empty plane stays empty
+    bool isHashLifeCompatible() const { return radius == 1 && !(birthMask & 1); }
+
+    // next state of the cells of a word of radius 1 cells, given the masks of their 8 neighbours. every mask is a word of the same cells,
+    // shifted so that bit i holds the corresponding neighbour of cell i
+    template<typename Word>
+    Word stepWord(Word aboveLeft, Word above, Word aboveRight, Word left, Word center, Word right, Word belowLeft, Word below, Word belowRight) const {
+        // each row is summed into two bits (ones, twos), then the ones of the three rows are summed into bit 0 of the count and a carry of weight 2
+        Word aboveOnes = aboveLeft ^ above ^ aboveRight;
+        Word aboveTwos = (aboveLeft & above) | (aboveRight & (aboveLeft ^ above));
+        Word belowOnes = belowLeft ^ below ^ belowRight;
+        Word belowTwos = (belowLeft & below) | (belowRight & (belowLeft ^ below));
+        Word rowOnes = left ^ right;
+        Word rowTwos = left & right;
+
+        Word countBit0 = aboveOnes ^ belowOnes ^ rowOnes;
+        Word carry = (aboveOnes & belowOnes) | (rowOnes & (aboveOnes ^ belowOnes));
+
+        // the four terms of weight 2
+        Word pairA = aboveTwos ^ belowTwos;
+        Word pairB = rowTwos ^ carry;
+        Word bothA = aboveTwos & belowTwos;
+        Word bothB = rowTwos & carry;
+
+        if(isConway()) {
+            // the count is 2 or 3 when exactly one of the terms of weight 2 is set. B3/S23: born with 3, survives with 2 or 3
+            Word exactlyOneTwo = (pairA ^ pairB) & ~(bothA | bothB);
+            return exactlyOneTwo & (countBit0 | center);
+        }
+
+        Word countBit1 = pairA ^ pairB;
+        Word carryFour = pairA & pairB;
+        Word countBit2 = bothA ^ bothB ^ carryFour;
+        Word countBit3 = (bothA & bothB) | (carryFour & (bothA ^ bothB));
+
+        Word next = 0;
+        for(int count = 0; count <= 8; count++) {
+            bool born = (birthMask >> count) & 1;
+            bool survives = (survivalMask >> count) & 1;
+            if(!born && !survives) {
+                continue;
+            }
+            Word match = (count & 1 ? countBit0 : ~countBit0) & (count & 2 ? countBit1 : ~countBit1) &
+                         (count & 4 ? countBit2 : ~countBit2) & (count & 8 ? countBit3 : ~countBit3);
+            next |= match & ((born ? ~center : 0) | (survives ? center : 0));
+        }
+        return next;
+    }
+};
@@ -14,10 +14,14 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <chrono>
+#include <climits>
+#include <cstdio>
+#include <algorithm>
 #include <QDebug>
 #include <QThread>
 
 #include "OscEngine.h"
+#include "DeadlineClock.h"
 
 OscEngine::OscEngine() {
     if(flagDebug) {
@@ -26,6 +30,8 @@ OscEngine::OscEngine() {
         );
         qDebug() << "constructor (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
+
+    outputMessageAddress = oscReceiverAddress.toUtf8();
 }
 
 OscEngine::~OscEngine() {
@@ -37,7 +43,7 @@ OscEngine::~OscEngine() {
     }
 }
 
-void OscEngine::connectReceiver(int generatorId) {
+void OscEngine::connectReceiver(int generatorId, QSharedPointer<InputFrameRing> inputRing) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
@@ -45,9 +51,28 @@ void OscEngine::connectReceiver(int generatorId) {
         qDebug() << "connectReceiver (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << generatorId;
     }
 
-    QObject::connect(oscReceiver.data(), &OscReceiver::messageReceived, this, [this, generatorId](const QString& oscAddress, const QVariantList& message){
-        receiveOscDataHandler(generatorId, oscAddress, message);
+    // a generator started again replaces its connections instead of receiving every message twice
+    disconnectReceiver(generatorId);
+
+    // the lambdas keep the ring alive until disconnectReceiver, so a message that comes in while the generator is being deleted is harmless.
+    // the float connection must be direct since the pointers are only valid during the emission, OscReceiver lives on this thread anyway
+    QMetaObject::Connection floatConnection = QObject::connect(oscReceiver.data(), &OscReceiver::floatMessageReceived, this, [this, generatorId, inputRing](const char* oscAddress, const float* values, int count){
+        receiveOscFloatsHandler(generatorId, inputRing.data(), oscAddress, values, count);
+    }, Qt::DirectConnection);
+    QMetaObject::Connection dataConnection = QObject::connect(oscReceiver.data(), &OscReceiver::messageReceived, this, [this, generatorId, inputRing](const QString& oscAddress, const QVariantList& message){
+        receiveOscDataHandler(generatorId, inputRing.data(), oscAddress, message);
     });
+    receiverConnections.insert(generatorId, qMakePair(floatConnection, dataConnection));
+}
+
+void OscEngine::disconnectReceiver(int generatorId) {
+    if(!receiverConnections.contains(generatorId)) {
+        return;
+    }
+
+    QPair<QMetaObject::Connection, QMetaObject::Connection> connections = receiverConnections.take(generatorId);
+    QObject::disconnect(connections.first);
+    QObject::disconnect(connections.second);
 }
 
 void OscEngine::startGeneratorOsc(QSharedPointer<Generator> generator) {
@@ -65,9 +90,17 @@ void OscEngine::startGeneratorOsc(QSharedPointer<Generator> generator) {
     QString addressSenderHost = generator->getOscOutputAddressHost();
     QString addressSenderTarget = generator->getOscOutputAddressTarget();
 
-    createOscReceiver(generatorId, addressReceiver, oscReceiverPort);
+    createOscReceiver(generatorId, generator->getInputRing(), addressReceiver, oscReceiverPort);
     createOscSender(generatorId, addressSenderHost, addressSenderTarget, oscSenderPort);
 
+    // keep the output address in sync with the generator name
+    outputAddresses.insert(generatorId, ("/" + generator->getGeneratorName() + "/output").toUtf8());
+    QObject::connect(generator.data(), &Generator::generatorNameChanged, this, [this, generatorId](QString generatorName){
+        if(outputAddresses.contains(generatorId)) {
+            outputAddresses.insert(generatorId, ("/" + generatorName + "/output").toUtf8());
+        }
+    });
+
     // connect oscReceiver object port to generator(s)
     QObject::connect(generator.data(), &Generator::oscReceiverPortChanged, this, [this](int oscReceiverPort){
         if(flagDebug) {
@@ -103,10 +136,32 @@ void OscEngine::stopGeneratorOsc(QSharedPointer<Generator> generator) {
         qDebug() << "stopGeneratorOsc (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << generatorId;
     }
 
+    // the connections made by startGeneratorOsc, otherwise starting the generator again would connect them twice
+    QObject::disconnect(generator.data(), nullptr, this, nullptr);
+    disconnectReceiver(generatorId);
+    truncatedInputs.remove(generatorId);
+
     deleteOscSender(generatorId);
+    outputAddresses.remove(generatorId);
+}
+
+void OscEngine::receiveOscFloatsHandler(int generatorId, InputFrameRing* inputRing, const char* oscAddress, const float* values, int count) {
+    if(flagDebug) {
+        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+        );
+
+        qDebug() << "receiveOscFloatsHandler (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << generatorId << "\taddress = " << oscAddress << "\tcount = " << count;
+    }
+
+    // comparing against a QLatin1String doesn't allocate
+    if(oscReceiverAddress == QLatin1String(oscAddress)) {
+        // message received with right address
+        pushInputFrame(generatorId, inputRing, values, count);
+    }
 }
 
-void OscEngine::receiveOscDataHandler(int generatorId, const QString& oscAddress, const QVariantList& message) {
+void OscEngine::receiveOscDataHandler(int generatorId, InputFrameRing* inputRing, const QString& oscAddress, const QVariantList& message) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
@@ -117,9 +172,36 @@ void OscEngine::receiveOscDataHandler(int generatorId, const QString& oscAddress
 
     QString oscAddressExpected = oscReceiverAddress;
     if(oscAddress == oscAddressExpected) {
-        // message received with right address
-        emit receiveOscData(generatorId, message);
+        // message received with right address. arguments that can't be cast to a number are read as 0
+        variantValues.resize(message.size());
+        for(int i = 0; i < message.size(); i++) {
+            QMetaType::Type type = (QMetaType::Type) message.at(i).type();
+            if(type == QMetaType::Float || type == QMetaType::Double || type == QMetaType::Int || type == QMetaType::Long) {
+                variantValues[i] = message.at(i).toFloat();
+            } else {
+                variantValues[i] = 0;
+            }
+        }
+        pushInputFrame(generatorId, inputRing, variantValues.data(), variantValues.size());
+    }
+}
+
+void OscEngine::pushInputFrame(int generatorId, InputFrameRing* inputRing, const float* values, int count) {
+    if(count > InputFrame::maxValues && !truncatedInputs.contains(generatorId)) {
+        truncatedInputs.insert(generatorId);
+        qWarning() << "generator" << generatorId << "received" << count << "input values, only the first" << InputFrame::maxValues << "are applied";
+    }
+
+    InputFrame* frame = inputRing->acquire();
+    if(frame == nullptr) {
+        // the ring is full, ComputeEngine is late
+        return;
     }
+
+    frame->timestamp = DeadlineClock::now();
+    frame->count = std::min(count, (int) InputFrame::maxValues);
+    std::copy(values, values + frame->count, frame->values);
+    inputRing->publish();
 }
 
 void OscEngine::updateValue(const QString &key, const QVariant &value) {
@@ -129,27 +211,104 @@ void OscEngine::updateValue(const QString &key, const QVariant &value) {
     setProperty(keyBuffer, value);
 }
 
-void OscEngine::sendOscData(int generatorId, QVariantList data) {
+void OscEngine::drainOutputFrames() {
+    // anything pushed after this point triggers a new notification
+    outputQueue->drainPending.store(false);
+
+    const OutputFrame* claimed;
+    while((claimed = outputQueue->ring.claim()) != nullptr) {
+        // copy the frame and give the slot back right away, ComputeEngine waits for it if the queue is full
+        OutputFrame frame = *claimed;
+        outputQueue->ring.release();
+
+        if(flagDebug) {
+            std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()
+            );
+
+            qDebug() << "drainOutputFrames (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << frame.generatorId << "\tframe = " << frame.frameNumber << "\tcount = " << frame.count;
+        }
+
+        QHash<int, QSharedPointer<OscSender>>::const_iterator sender = oscSenders.constFind(frame.generatorId);
+        QHash<int, QByteArray>::const_iterator outputAddress = outputAddresses.constFind(frame.generatorId);
+        if(sender == oscSenders.constEnd() || outputAddress == outputAddresses.constEnd()) {
+            // we allow this to happen without an exception because this can occur when deleting a generator.
+            // there is a race condition between the deletion of the Generator and its associated OscSender when AppModel orders their respective threads (computeThread and oscThread) to delete them later.
+            // if the OscSender is deleted first and the ComputeEngine renders an iteration before it deletes the Generator, its last frames reach a generator that doesn't have an OscSender.
+            continue;
+        }
+
+        // write and send individual output region osc messages
+        // format is: "/[generator_name]/output/[output_region_number]/float"
+        char regionAddress[1024];
+        for(int i = 0; i < frame.count; i++) {
+            snprintf(regionAddress, sizeof(regionAddress), "%s/%d", outputAddress.value().constData(), i + 1);
+            sender.value()->sendFloats(outputMessageAddress.constData(), regionAddress, &frame.values[i], 1);
+        }
+
+        // write generator info to osc output list message
+        // format is: "/[generator_name]/output/float float float float" (or however many floats are needed to express every output region)
+        sender.value()->sendFloats(outputMessageAddress.constData(), outputAddress.value().constData(), frame.values, frame.count);
+    }
+}
+
+void OscEngine::setOutputQueue(QSharedPointer<OutputFrameQueue> outputQueue) {
+    this->outputQueue = outputQueue;
+}
+
+void OscEngine::updateStats(const QVariantMap& stats) {
+    this->stats = stats;
+}
+
+void OscEngine::sendStats() {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
         );
 
-        qDebug() << "sendOscData (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId() << "\tgenid = " << generatorId << "\tmessage = " << data;
+        qDebug() << "sendStats (OscEngine):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
 
-    if(!oscSenders.contains(generatorId)) {
-        // we allow this to happen without an exception because this can occur when deleting a generator.
-        // there is a race condition between the deletion of the Generator and its associated OscSender when AppModel orders their respective threads (computeThread and oscThread) to delete them later.
-        // if the OscSender is deleted first and the ComputeEngine renders an iteration before it deletes the Generator, it will attempt to send a message through an OscSender that doesn't exist.
-        return;
+    if(statsSender.isNull()) {
+        statsSender = QSharedPointer<OscSender>(new OscSender(oscSenderHost, oscSenderPort));
+    }
+
+    QStringList engineStages = {"frame", "input", "compute", "output", "history", "oscEmit", "latticeExport"};
+    for(const QString& stage : engineStages) {
+        sendStatsHistogram("engine", stage, stats.value(stage).toMap());
     }
 
-    QSharedPointer<OscSender> sender = oscSenders.value(generatorId);
-    sender->send(oscReceiverAddress, data);
+    QStringList generatorStages = {"input", "compute", "output", "latticeExport"};
+    QVariantList generators = stats.value("generators").toList();
+    for(const QVariant& generatorValue : generators) {
+        QVariantMap generator = generatorValue.toMap();
+        for(const QString& stage : generatorStages) {
+            sendStatsHistogram(generator.value("generatorName").toString(), stage, generator.value(stage).toMap());
+        }
+    }
+
+    QVariantList deadlines;
+    deadlines.append((int) std::min<double>(INT_MAX, stats.value("missedDeadlines").toDouble()));
+    deadlines.append(stats.value("latenessMax").toFloat());
+    deadlines.append(stats.value("latenessMean").toFloat());
+    statsSender->send(oscStatsAddress + "/deadlines", deadlines);
+}
+
+void OscEngine::sendStatsHistogram(const QString& scope, const QString& stage, const QVariantMap& histogram) {
+    QVariantList message;
+    message.append(scope);
+    message.append(stage);
+    message.append((int) std::min<double>(INT_MAX, histogram.value("count").toDouble()));
+    message.append(histogram.value("mean").toFloat());
+    message.append(histogram.value("p50").toFloat());
+    message.append(histogram.value("p90").toFloat());
+    message.append(histogram.value("p99").toFloat());
+    message.append(histogram.value("p999").toFloat());
+    message.append(histogram.value("max").toFloat());
+    statsSender->send(oscStatsAddress, message);
 }
 
-void OscEngine::createOscReceiver(int generatorId, QString address, int port) {
+void OscEngine::createOscReceiver(int generatorId, QSharedPointer<InputFrameRing> inputRing, QString address, int port) {
     if(flagDebug) {
         std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
                     std::chrono::system_clock::now().time_since_epoch()
@@ -161,11 +320,24 @@ void OscEngine::createOscReceiver(int generatorId, QString address, int port) {
     // only one osc receiver object needed
     if(createOscReceiverBoolean) {
         oscReceiver = QSharedPointer<OscReceiver>(new OscReceiver(port));
+        oscReceiver->setFloatFastPath(true);
         createOscReceiverBoolean = false;
+
+        // stats requests aren't tied to a generator, so they get their own connection. requests usually have no arguments, so they come through the fast path
+        QObject::connect(oscReceiver.data(), &OscReceiver::floatMessageReceived, this, [this](const char* oscAddress, const float*, int){
+            if(oscStatsAddress == QLatin1String(oscAddress)) {
+                sendStats();
+            }
+        }, Qt::DirectConnection);
+        QObject::connect(oscReceiver.data(), &OscReceiver::messageReceived, this, [this](const QString& oscAddress, const QVariantList&){
+            if(oscAddress == oscStatsAddress) {
+                sendStats();
+            }
+        });
     }
 
     // connect receiver
-    connectReceiver(generatorId);
+    connectReceiver(generatorId, inputRing);
 }
 
 void OscEngine::createOscSender(int generatorId, QString addressHost, QString addressTarget, int port) {
@@ -251,6 +423,9 @@ void OscEngine::updateOscSenderPort(int port) {
     for(i = oscSenders.begin(); i !=oscSenders.end(); ++i) {
         i.value()->setPort(oscSenderPort);
     }
+    if(!statsSender.isNull()) {
+        statsSender->setPort(oscSenderPort);
+    }
 }
 
 void OscEngine::writeOscSenderHost(QString host) {
@@ -273,4 +448,7 @@ void OscEngine::updateOscSenderHost(QString host) {
     for(i = oscSenders.begin(); i !=oscSenders.end(); ++i) {
         i.value()->setOscSenderHost(host);
     }
+    if(!statsSender.isNull()) {
+        statsSender->setOscSenderHost(host);
+    }
 }
@@ -18,10 +18,14 @@
 #include <QObject>
 #include <QSharedPointer>
 #include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QVector>
 
 #include "OscSender.h"
 #include "OscReceiver.h"
 #include "Generator.h"
+#include "OutputFrame.h"
 
 class OscEngine : public QObject {
     Q_OBJECT
@@ -31,9 +35,19 @@ class OscEngine : public QObject {
 public:
     OscEngine();
     ~OscEngine();
+
+    // sets the queue shared with ComputeEngine. this must be called before oscThread starts processing
+    void setOutputQueue(QSharedPointer<OutputFrameQueue> outputQueue);
 private:
     QHash<int, QSharedPointer<OscSender>> oscSenders;
     QSharedPointer<OscReceiver> oscReceiver;
+    QHash<int, QPair<QMetaObject::Connection, QMetaObject::Connection>> receiverConnections;    // made by connectReceiver for every generator, see disconnectReceiver
+    QSharedPointer<OscSender> statsSender;      // replies to stats requests, created on the first request
+    QVariantMap stats;                          // latest timings received from ComputeEngine::statsUpdated
+    QString oscStatsAddress = "/autonomx/stats";
+    QSharedPointer<OutputFrameQueue> outputQueue;   // output values from ComputeEngine, see drainOutputFrames
+    QHash<int, QByteArray> outputAddresses;     // "/[generator_name]/output" for every generator, kept up to date so that sending doesn't build strings
+    QByteArray outputMessageAddress;            // oscReceiverAddress, encoded once
     QString oscSenderAddress = "/output";
     QString oscReceiverAddress = "/input";
     int oscSenderPort = 6669;
@@ -41,16 +55,33 @@ private:
     QString oscSenderHost = "127.0.0.1";
     bool createOscReceiverBoolean = true;
 
-    // connects OscReceiver::messageReceived to OscEngine::receiveOscDataHandler through a lambda that captures the generator id
-    void connectReceiver(int generatorId);
+    QVector<float> variantValues;               // scratch space used to convert QVariant messages to input frames
+    QSet<int> truncatedInputs;                  // generators already warned about receiving more values than InputFrame::maxValues
+
+    // connects OscReceiver::floatMessageReceived and OscReceiver::messageReceived to the handlers through lambdas that capture the generator id and its input ring
+    void connectReceiver(int generatorId, QSharedPointer<InputFrameRing> inputRing);
+    // removes the connections made by connectReceiver, which releases the generator's input ring
+    void disconnectReceiver(int generatorId);
 
     // used internally by connectGenerator and disconnectGenerator
-    void createOscReceiver(int generatorId, QString address, int port);
+    void createOscReceiver(int generatorId, QSharedPointer<InputFrameRing> inputRing, QString address, int port);
+
+    // timestamps the values and pushes them to the generator's input ring, which ComputeEngine drains when it computes the generator.
+    // this doesn't allocate. if the ring is full, the frame is dropped and counted by the ring. values past InputFrame::maxValues
+    // are ignored, with a warning the first time for each generator
+    void pushInputFrame(int generatorId, InputFrameRing* inputRing, const float* values, int count);
 
     // used internally by connectGenerator and disconnectGenerator
     void createOscSender(int generatorId, QString addressHost, QString addressTarget, int port);
     void deleteOscSender(int generatorId);
 
+    // sends the latest timings to oscSenderHost:oscSenderPort. this is the reply to a message on oscStatsAddress.
+    // every histogram is sent as its own message on oscStatsAddress, with arguments:
+    // scope (string, "engine" or the generator name), stage (string), count (int), mean, p50, p90, p99, p999, max (float, in ms)
+    // the deadline counters are sent on oscStatsAddress + "/deadlines" with arguments: missed deadlines (int), lateness max, lateness mean (float, in ms)
+    void sendStats();
+    void sendStatsHistogram(const QString& scope, const QString& stage, const QVariantMap& histogram);
+
     // getters
     int getOscReceiverPort() const;
     int getOscSenderPort() const;
@@ -67,17 +98,17 @@ signals:
     // to facade
     void valueChanged(const QString &key, const QVariant &value);
 
-    // relays updates to ComputeEngine::rec
-    void receiveOscData(int id, QVariantList data);
-
     // notifiers
     void OscReceiverPortChanged(int receiverPort);
     void OscSenderPortChanged(int senderPort);
     void OscSenderHostChanged(QString host);
 
 private slots:
-    // bridges OscReceiver::messageReceived to OscEngine::receiveOscData
-    void receiveOscDataHandler(int id, const QString& oscAddress, const QVariantList& message);
+    // bridges OscReceiver::floatMessageReceived to the generator's input ring. this is the path taken by regular numeric input
+    void receiveOscFloatsHandler(int id, InputFrameRing* inputRing, const char* oscAddress, const float* values, int count);
+
+    // bridges OscReceiver::messageReceived to the generator's input ring. this handles messages with non-numeric arguments, which are read as 0
+    void receiveOscDataHandler(int id, InputFrameRing* inputRing, const QString& oscAddress, const QVariantList& message);
 
 public slots:
     // from facade
@@ -88,8 +119,12 @@ public slots:
     // stops processing for a generator using deleteOscReceiver and deleteOscSender. emitted by AppModel
     void stopGeneratorOsc(QSharedPointer<Generator> generator);
 
-    // bridges ComputeEngine::sendOscData to OscSender::send
-    void sendOscData(int id, QVariantList data);
+    // sends every output frame waiting in outputQueue. this is connected to ComputeEngine::outputFramesReady.
+    // for every frame, this sends one message per output region, then one message with every region, in the format described in the method
+    void drainOutputFrames();
+
+    // keeps the latest timings from ComputeEngine::statsUpdated
+    void updateStats(const QVariantMap& stats);
 
     // updates receiver parameters
     void updateOscReceiverPort(int port);
@@ -0,0 +1,43 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+
+#include "DropOldestRing.h"
+
+// output values of a single generator for a single frame, as sent from ComputeEngine to OscEngine
+struct OutputFrame {
+    static const int maxValues = 64;            // regions past this are not sent, ComputeEngine warns once per generator
+
+    int generatorId;
+    quint64 frameNumber;                        // ComputeEngine frame during which the values were computed
+    int count;
+    float values[maxValues];                    // one value per output region, in order
+};
+
+// queue from ComputeEngine (producer, computeThread) to OscEngine (consumer, oscThread).
+// a slow network side makes the oldest frames drop instead of growing memory
+struct OutputFrameQueue {
+    OutputFrameQueue(int capacity) : ring(capacity), drainPending(false) {}
+
+    DropOldestRing<OutputFrame> ring;
+
+    // set by the producer when it asks the consumer to drain the ring, cleared by the consumer right before draining.
+    // this coalesces the notifications so that at most one is waiting in oscThread's event queue
+    std::atomic<bool> drainPending;
+};
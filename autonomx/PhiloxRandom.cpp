@@ -0,0 +1,112 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <algorithm>
+
+#include "PhiloxRandom.h"
+
+static const quint32 philoxM0 = 0xD2511F53;
+static const quint32 philoxM1 = 0xCD9E8D57;
+static const quint32 philoxW0 = 0x9E3779B9;
+static const quint32 philoxW1 = 0xBB67AE85;
+
+// one round on the four words of a counter
+static inline void philoxRound(quint32& c0, quint32& c1, quint32& c2, quint32& c3, quint32 k0, quint32 k1) {
+    quint64 product0 = (quint64) philoxM0 * c0;
+    quint64 product1 = (quint64) philoxM1 * c2;
+    quint32 hi0 = (quint32) (product0 >> 32);
+    quint32 lo0 = (quint32) product0;
+    quint32 hi1 = (quint32) (product1 >> 32);
+    quint32 lo1 = (quint32) product1;
+
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+}
+
+static inline void philox(quint32& c0, quint32& c1, quint32& c2, quint32& c3, quint32 k0, quint32 k1) {
+    for(int round = 0; round < 10; round++) {
+        philoxRound(c0, c1, c2, c3, k0, k1);
+        k0 += philoxW0;
+        k1 += philoxW1;
+    }
+}
+
+void PhiloxRandom::generate(const quint32 counter[4], const quint32 key[2], quint32 output[4]) {
+    quint32 c0 = counter[0];
+    quint32 c1 = counter[1];
+    quint32 c2 = counter[2];
+    quint32 c3 = counter[3];
+    philox(c0, c1, c2, c3, key[0], key[1]);
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+}
+
+void PhiloxRandom::normal(quint64 key, quint64 step, int begin, int count, double* output) {
+    // blocks are generated in chunks, the integer loop over a chunk has no dependency between iterations and is vectorized by the compiler
+    const int chunkBlocks = 64;
+    quint32 words[4][chunkBlocks];
+
+    quint32 k0 = (quint32) key;
+    quint32 k1 = (quint32) (key >> 32);
+    quint32 s0 = (quint32) step;
+    quint32 s1 = (quint32) (step >> 32);
+
+    int end = begin + count;
+    int firstBlock = begin / 4;
+    int lastBlock = (end + 3) / 4;
+
+    for(int chunk = firstBlock; chunk < lastBlock; chunk += chunkBlocks) {
+        int blocks = std::min(chunkBlocks, lastBlock - chunk);
+
+        for(int b = 0; b < blocks; b++) {
+            quint32 c0 = (quint32) (chunk + b);
+            quint32 c1 = 0;
+            quint32 c2 = s0;
+            quint32 c3 = s1;
+            philox(c0, c1, c2, c3, k0, k1);
+            words[0][b] = c0;
+            words[1][b] = c1;
+            words[2][b] = c2;
+            words[3][b] = c3;
+        }
+
+        // Box-Muller, two samples from each pair of words. u1 is in (0, 1] so that its log is finite
+        for(int b = 0; b < blocks; b++) {
+            double samples[4];
+            for(int pair = 0; pair < 2; pair++) {
+                double u1 = ((double) words[2 * pair][b] + 1.0) * (1.0 / 4294967296.0);
+                double u2 = (double) words[2 * pair + 1][b] * (1.0 / 4294967296.0);
+                double radius = std::sqrt(-2.0 * std::log(u1));
+                double angle = 6.283185307179586 * u2;
+                samples[2 * pair] = radius * std::cos(angle);
+                samples[2 * pair + 1] = radius * std::sin(angle);
+            }
+
+            int first = (chunk + b) * 4;
+            for(int lane = 0; lane < 4; lane++) {
+                int index = first + lane;
+                if(index >= begin && index < end) {
+                    output[index - begin] = samples[lane];
+                }
+            }
+        }
+    }
+}
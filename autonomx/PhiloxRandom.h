@@ -0,0 +1,36 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QtGlobal>
+
+// counter-based random number generator (Philox4x32-10, Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011).
+//
+// every output is a pure function of a key and a counter, so there is no sequential state: any range of values can be generated
+// on any thread and in any order, and always gives the same result. this is what makes the noise of SpikingNet independent
+// of how the neurons are split between threads or SIMD lanes.
+class PhiloxRandom {
+public:
+    // 128 bits of output for a 128 bit counter and a 64 bit key
+    static void generate(const quint32 counter[4], const quint32 key[2], quint32 output[4]);
+
+    // writes the standard normal samples [begin, begin + count) of the given step to output.
+    // samples are produced four at a time by one block of the generator (counter = block index, step) and the Box-Muller transform,
+    // so sample i only depends on key, step and i. the transcendental functions are evaluated one value at a time with the C library
+    // while the integer part runs on whole arrays, so the results don't depend on the vector width the compiler picks either
+    static void normal(quint64 key, quint64 step, int begin, int count, double* output);
+};
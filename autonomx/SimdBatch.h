@@ -0,0 +1,181 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+// thin wrappers over the SIMD registers available at compile time, so that a kernel can be written once as a template over the batch type
+// and instantiated for every instruction set and precision.
+//
+// the widest instruction set enabled for the build is used: AVX2 if the compiler targets it (see CONFIG += simd_avx2 in autonomx.pro),
+// SSE2 otherwise on x86, and ScalarBatch (one value at a time) everywhere else. SimdBatch<T> names the batch type to use for T.
+//
+// only plain IEEE multiplications and additions are exposed (no fused multiply-add), so every batch type gives bit for bit the same
+// results as the scalar code for the same sequence of operations.
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+template<typename T>
+struct ScalarBatch {
+    typedef T Register;
+    typedef bool Mask;
+    static const int width = 1;
+
+    static Register load(const T* pointer) { return *pointer; }
+    static void store(T* pointer, Register value) { *pointer = value; }
+    static Register set(T value) { return value; }
+    static Register add(Register a, Register b) { return a + b; }
+    static Register subtract(Register a, Register b) { return a - b; }
+    static Register multiply(Register a, Register b) { return a * b; }
+    static Register divide(Register a, Register b) { return a / b; }
+    static Register min(Register a, Register b) { return b < a ? b : a; }
+    static Register max(Register a, Register b) { return a < b ? b : a; }
+    static Mask greater(Register a, Register b) { return a > b; }
+    // mask ? a : b
+    static Register select(Mask mask, Register a, Register b) { return mask ? a : b; }
+    // bit i is set if lane i of mask is set
+    static int bits(Mask mask) { return mask ? 1 : 0; }
+};
+
+#if defined(__AVX2__)
+
+struct AvxDoubleBatch {
+    typedef __m256d Register;
+    typedef __m256d Mask;
+    static const int width = 4;
+
+    static Register load(const double* pointer) { return _mm256_load_pd(pointer); }
+    static void store(double* pointer, Register value) { _mm256_store_pd(pointer, value); }
+    static Register set(double value) { return _mm256_set1_pd(value); }
+    static Register add(Register a, Register b) { return _mm256_add_pd(a, b); }
+    static Register subtract(Register a, Register b) { return _mm256_sub_pd(a, b); }
+    static Register multiply(Register a, Register b) { return _mm256_mul_pd(a, b); }
+    static Register divide(Register a, Register b) { return _mm256_div_pd(a, b); }
+    static Register min(Register a, Register b) { return _mm256_min_pd(b, a); }
+    static Register max(Register a, Register b) { return _mm256_max_pd(b, a); }
+    static Mask greater(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Register select(Mask mask, Register a, Register b) { return _mm256_blendv_pd(b, a, mask); }
+    static int bits(Mask mask) { return _mm256_movemask_pd(mask); }
+};
+
+struct AvxFloatBatch {
+    typedef __m256 Register;
+    typedef __m256 Mask;
+    static const int width = 8;
+
+    static Register load(const float* pointer) { return _mm256_load_ps(pointer); }
+    static void store(float* pointer, Register value) { _mm256_store_ps(pointer, value); }
+    static Register set(float value) { return _mm256_set1_ps(value); }
+    static Register add(Register a, Register b) { return _mm256_add_ps(a, b); }
+    static Register subtract(Register a, Register b) { return _mm256_sub_ps(a, b); }
+    static Register multiply(Register a, Register b) { return _mm256_mul_ps(a, b); }
+    static Register divide(Register a, Register b) { return _mm256_div_ps(a, b); }
+    static Register min(Register a, Register b) { return _mm256_min_ps(b, a); }
+    static Register max(Register a, Register b) { return _mm256_max_ps(b, a); }
+    static Mask greater(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Register select(Mask mask, Register a, Register b) { return _mm256_blendv_ps(b, a, mask); }
+    static int bits(Mask mask) { return _mm256_movemask_ps(mask); }
+};
+
+template<typename T> struct SimdBatchSelector { typedef ScalarBatch<T> Type; };
+template<> struct SimdBatchSelector<double> { typedef AvxDoubleBatch Type; };
+template<> struct SimdBatchSelector<float> { typedef AvxFloatBatch Type; };
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+// SSE2 has no blend instruction, select is done with bitwise operations on the all-ones / all-zeros lanes of the mask
+struct SseDoubleBatch {
+    typedef __m128d Register;
+    typedef __m128d Mask;
+    static const int width = 2;
+
+    static Register load(const double* pointer) { return _mm_load_pd(pointer); }
+    static void store(double* pointer, Register value) { _mm_store_pd(pointer, value); }
+    static Register set(double value) { return _mm_set1_pd(value); }
+    static Register add(Register a, Register b) { return _mm_add_pd(a, b); }
+    static Register subtract(Register a, Register b) { return _mm_sub_pd(a, b); }
+    static Register multiply(Register a, Register b) { return _mm_mul_pd(a, b); }
+    static Register divide(Register a, Register b) { return _mm_div_pd(a, b); }
+    static Register min(Register a, Register b) { return _mm_min_pd(b, a); }
+    static Register max(Register a, Register b) { return _mm_max_pd(b, a); }
+    static Mask greater(Register a, Register b) { return _mm_cmpgt_pd(a, b); }
+    static Register select(Mask mask, Register a, Register b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+    static int bits(Mask mask) { return _mm_movemask_pd(mask); }
+};
+
+struct SseFloatBatch {
+    typedef __m128 Register;
+    typedef __m128 Mask;
+    static const int width = 4;
+
+    static Register load(const float* pointer) { return _mm_load_ps(pointer); }
+    static void store(float* pointer, Register value) { _mm_store_ps(pointer, value); }
+    static Register set(float value) { return _mm_set1_ps(value); }
+    static Register add(Register a, Register b) { return _mm_add_ps(a, b); }
+    static Register subtract(Register a, Register b) { return _mm_sub_ps(a, b); }
+    static Register multiply(Register a, Register b) { return _mm_mul_ps(a, b); }
+    static Register divide(Register a, Register b) { return _mm_div_ps(a, b); }
+    static Register min(Register a, Register b) { return _mm_min_ps(b, a); }
+    static Register max(Register a, Register b) { return _mm_max_ps(b, a); }
+    static Mask greater(Register a, Register b) { return _mm_cmpgt_ps(a, b); }
+    static Register select(Mask mask, Register a, Register b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    static int bits(Mask mask) { return _mm_movemask_ps(mask); }
+};
+
+template<typename T> struct SimdBatchSelector { typedef ScalarBatch<T> Type; };
+template<> struct SimdBatchSelector<double> { typedef SseDoubleBatch Type; };
+template<> struct SimdBatchSelector<float> { typedef SseFloatBatch Type; };
+
+#else
+
+template<typename T> struct SimdBatchSelector { typedef ScalarBatch<T> Type; };
+
+#endif
+
+template<typename T>
+using SimdBatch = typename SimdBatchSelector<T>::Type;
+
+// alignment and padding that fit every batch type above. arrays processed by batches are allocated with this alignment,
+// and their size rounded up to a multiple of simdPadding so that kernels never need a scalar tail
+const int simdAlignment = 64;
+const int simdPadding = 16;
+
+template<typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(simdAlignment)));
+    }
+
+    void deallocate(T* pointer, std::size_t) {
+        ::operator delete(pointer, std::align_val_t(simdAlignment));
+    }
+
+    template<typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
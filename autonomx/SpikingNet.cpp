@@ -13,11 +13,17 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <future>
 #include <QThread>
 #include <QDebug>
 
 #include "SpikingNet.h"
+#include "DeadlineClock.h"
+#include "PhiloxRandom.h"
+#include "SynapseCache.h"
 
 // ############################### initialization routines ###############################
 
@@ -31,6 +37,8 @@ SpikingNet::SpikingNet(int id, GeneratorMeta * meta) : Generator(id, meta)
         qDebug() << "constructor (SpikingNet):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
 
+    selectStepKernel();
+
     // make sure these two functions are ALWAYS called at the end of a constructor!
     resetParameters();
     initialize();
@@ -44,6 +52,9 @@ SpikingNet::~SpikingNet() {
 
         qDebug() << "destructor (SpikingNet):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
+
+    // a build still running would otherwise be waited for until it completes
+    discardNetworkBuild();
 }
 
 
@@ -56,18 +67,169 @@ void SpikingNet::initialize() {
         qDebug() << "initialize:\t\t\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
 
-    // set random seed
-    if(flagRandomDevice) {
-        std::random_device random;
-        randomGenerator.seed(random());
-    } else {
-        randomGenerator.seed(randomSeed);
+    // a background reinitialization would be overwritten by this one anyway
+    discardNetworkBuild();
+
+    std::unique_ptr<NetworkState> state = captureNetworkState();
+    buildNetworkState(*state);
+    adoptNetworkState(*state);
+
+    writeInitializeProgress(1.0);
+
+    // qDebug() << "initialized";
+}
+
+void SpikingNet::reinitialize() {
+    if(flagDebug) {
+        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+        );
+
+        qDebug() << "reinitialize (SpikingNet):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
+    }
+
+    // parameters are also written from the main thread while a project loads. the pending build is only ever touched on the thread
+    // of the generator, where commitInitialize runs every frame
+    if(QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() {
+            reinitialize();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // only one build runs at a time. the parameters are captured again once it is done, so the last write always wins
+    if(pendingBuild.valid()) {
+        flagReinitializeRequested = true;
+        return;
+    }
+
+    startNetworkBuild();
+}
+
+void SpikingNet::commitInitialize(bool wait) {
+    if(!pendingBuild.valid()) {
+        return;
+    }
+
+    if(!wait && pendingBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        writeInitializeProgress(0.99 * pendingState->sourcesBuilt.load() / (pendingState->latticeWidth * pendingState->latticeHeight));
+        return;
+    }
+
+    pendingBuild.get();
+
+    // the parameters changed during the build, so the result is already outdated
+    if(flagReinitializeRequested) {
+        flagReinitializeRequested = false;
+        startNetworkBuild();
+        if(wait) {
+            commitInitialize(true);
+        }
+        return;
+    }
+
+    adoptNetworkState(*pendingState);
+    pendingState.reset();
+
+    writeInitializeProgress(1.0);
+}
+
+void SpikingNet::startNetworkBuild() {
+    pendingState = captureNetworkState();
+
+    // the state is only accessed by the build until pendingBuild is ready, apart from its progress counter
+    NetworkState* state = pendingState.get();
+    pendingBuild = std::async(std::launch::async, [state]() {
+        buildNetworkState(*state);
+    });
+
+    writeInitializeProgress(0.0);
+}
+
+void SpikingNet::discardNetworkBuild() {
+    if(pendingBuild.valid()) {
+        pendingState->cancelled.store(true);
+        pendingBuild.wait();
+    }
+    pendingState.reset();
+    flagReinitializeRequested = false;
+}
+
+std::unique_ptr<SpikingNet::NetworkState> SpikingNet::captureNetworkState() {
+    std::unique_ptr<NetworkState> state(new NetworkState());
+
+    state->latticeWidth = requestedLatticeWidth;
+    state->latticeHeight = requestedLatticeHeight;
+    // inhibitory size might have changed just before this call if any of the involved parameters were modified
+    state->inhibitorySize = requestedLatticeWidth * requestedLatticeHeight * inhibitoryPortion;
+    state->inhibitoryNeuronType = inhibitoryNeuronType;
+    state->excitatoryNeuronType = excitatoryNeuronType;
+    state->networkType = networkType;
+    state->connectionsPerNeuron = connectionsPerNeuron;
+    state->gridNetworkConnectionRate = gridNetworkConnectionRate;
+    state->inhibitoryInitWeight = inhibitoryInitWeight;
+    state->excitatoryInitWeight = excitatoryInitWeight;
+    state->seeded = hasRandomSeed();
+    state->seed = getRandomSeed();
+
+    // seeding happens here rather than in the build, since std::random_device might not be safe to use from several threads.
+    // the running network doesn't draw from randomGenerator, so it can be reseeded before the new one is adopted
+    seedRandomGenerator();
+    state->randomGenerator = randomGenerator;
+
+    return state;
+}
+
+void SpikingNet::buildNetworkState(NetworkState& state) {
+    int neuronCount = state.latticeWidth * state.latticeHeight;
+
+    // set neuron types
+    state.neurons.resize(neuronCount);
+    for(int i = 0; i < neuronCount; ++i) {
+        if(i < state.inhibitorySize) {
+            state.neurons.setNeuronType(i, state.inhibitoryNeuronType);
+        } else{
+            state.neurons.setNeuronType(i, state.excitatoryNeuronType);
+        }
+    }
+
+    // the noise key is drawn before the network, so that it doesn't depend on whether the network is built or comes from the cache
+    state.noiseKey = ((quint64) state.randomGenerator() << 32) | state.randomGenerator();
+
+    // with an explicit seed, the network only depends on the key below and might already have been built
+    SynapseCache::Key networkKey = {
+        (int) state.networkType, state.latticeWidth, state.latticeHeight, state.inhibitorySize, state.seed,
+        state.connectionsPerNeuron, state.gridNetworkConnectionRate, state.inhibitoryInitWeight, state.excitatoryInitWeight
+    };
+
+    if(!state.seeded || !SynapseCache::getInstance().find(networkKey, state.synapses)) {
+        buildNetwork(state);
+
+        // a cancelled build is incomplete
+        if(state.seeded && !state.cancelled.load()) {
+            SynapseCache::getInstance().insert(networkKey, state.synapses);
+        }
     }
 
+    state.sourcesBuilt.store(neuronCount);
+}
+
+void SpikingNet::adoptNetworkState(NetworkState& state) {
+    // the lattice size follows the network
+    latticeWidth = state.latticeWidth;
+    latticeHeight = state.latticeHeight;
+    inhibitorySize = state.inhibitorySize;
+
+    randomGenerator = state.randomGenerator;
+    std::swap(neurons, state.neurons);
+    std::swap(synapses, state.synapses);
+
     // setup vectors
-    neurons.resize(latticeWidth * latticeHeight);
+    latticeValues.resize(neurons.getPaddedSize());
+    latticeValuesValid = false;
 
-    STDPTimes.resize(latticeWidth * latticeHeight, 0);
+    // no neuron has fired yet
+    STDPTraces.assign(latticeWidth * latticeHeight, 0.0);
 
     // allocate memory for STP variables
     STPu = new double[latticeWidth * latticeHeight];
@@ -81,50 +243,48 @@ void SpikingNet::initialize() {
         STPu[i] = 0.0;
     }
 
-    // allocate memory for weights
-    weights = new double*[latticeWidth * latticeHeight];
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        weights[i] = new double[latticeWidth * latticeHeight];
-    }
+    noiseKey = state.noiseKey;
+    noiseStep = 0;
+    noiseSamples.resize(latticeWidth * latticeHeight);
+}
 
-    // initialize weights
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        for(int j = 0; j < latticeWidth * latticeHeight; ++j) {
-            weights[i][j] = 0.;
-        }
-    }
 
-    // update inhibitory size, which might have changed just before this call if any of the involved parameters were modified
-    inhibitorySize = latticeWidth * latticeHeight * inhibitoryPortion;
-
-    // set neuron types
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        if(i < inhibitorySize) {
-            neurons[i].setNeuronType(inhibitoryNeuronType);
-        } else{
-            neurons[i].setNeuronType(excitatoryNeuronType);
-        }
-    }
+// builds the synapses of the network type of state from scratch. this consumes random numbers from state.randomGenerator
+void SpikingNet::buildNetwork(NetworkState& state) {
+    // start from a network without synapses, the network type below adds them
+    state.synapses.clear(state.latticeWidth * state.latticeHeight);
 
     // set network type
-    switch(networkType) {
+    switch(state.networkType) {
         case NetworkType::SparseNetwork:
-            setSparseNetwork();
+            setSparseNetwork(state);
             break;
         case NetworkType::RandomNetwork:
-            setRandomNetwork();
+            setRandomNetwork(state);
             break;
         case NetworkType::UniformNetwork:
-            setUniformNetwork();
+            setUniformNetwork(state);
             break;
         case NetworkType::GridNetwork:
-            setGridNetwork();
+            setGridNetwork(state);
             break;
     }
 
-    // qDebug() << "initialized";
-}
+    if(state.cancelled.load()) {
+        return;
+    }
 
+    state.synapses.build();
+
+    // excitatory to excitatory synapses are subject to decay, see applyDecay
+    for(int i = state.inhibitorySize; i < state.latticeWidth * state.latticeHeight; i++) {
+        for(int s = state.synapses.getRowBegin(i); s < state.synapses.getRowEnd(i); s++) {
+            if(state.synapses.getDestination(s) >= state.inhibitorySize) {
+                state.synapses.setScaled(s, true);
+            }
+        }
+    }
+}
 
 // inhibitory neurons are first, the rest is excitatory neurons
 // input and output neurons are always in the excitatory neurons
@@ -142,147 +302,191 @@ int SpikingNet::indexExcitatoryNeuron(int i) {
     return i + inhibitorySize;
 }
 
-void SpikingNet::setSparseNetwork() {
+// the builders only use state, since they can run on a worker thread. they count the sources done in state.sourcesBuilt for the progress reported by commitInitialize
+
+void SpikingNet::setSparseNetwork(NetworkState& state) {
+
+    int neuronCount = state.latticeWidth * state.latticeHeight;
 
-    std::uniform_int_distribution<> randomNeurons(0, latticeWidth * latticeHeight - 1);
+    std::uniform_int_distribution<> randomNeurons(0, neuronCount - 1);
     std::uniform_real_distribution<> randomUniform(0.0, 1.0);
 
     int connectionSum = 0;
-    int destinationArray[connectionsPerNeuron];
+    std::vector<int> destinationArray(state.connectionsPerNeuron);
 
     // in case of non fully connected
-    if(connectionsPerNeuron != latticeWidth * latticeHeight) {
-        for(int source = 0; source < latticeWidth * latticeHeight; ++source) {
-            for(int n = 0; n < connectionsPerNeuron; n++) {
-                // initialize to something that won't be matched when we check if the candidate is already used
-                destinationArray[n] = -1;
-            }
+    if(state.connectionsPerNeuron != neuronCount) {
+        // candidateSource[j] is the last source for which j was picked, so that checking for duplicates is constant time
+        std::vector<int> candidateSource(neuronCount, -1);
 
+        for(int source = 0; source < neuronCount; ++source) {
             int count = 0;
-            while(count < connectionsPerNeuron) {
-                int candidate = randomNeurons(randomGenerator);
+            while(count < state.connectionsPerNeuron) {
+                int candidate = randomNeurons(state.randomGenerator);
                 // check wether the candidate_id is already included in dest_array.
-                bool isIncluded = false;
-                for(int i = 0; i < connectionsPerNeuron; i++) {
-                    if(destinationArray[i] == candidate) {
-                        isIncluded = true;
-                        break;
-                    }
-                }
-
-                if(!isIncluded) {
+                if(candidateSource[candidate] != source) {
+                    candidateSource[candidate] = source;
                     destinationArray[count] = candidate;
                     count++;
                     connectionSum++;
                 }
             }
 
-            for(int j = 0; j < connectionsPerNeuron; j++) {
+            for(int j = 0; j < state.connectionsPerNeuron; j++) {
                 int destination = destinationArray[j];
                 if(destination != source) {
-                    if(destination >= 0 && destination < latticeWidth * latticeHeight) {
-                        if(source < inhibitorySize) {
-                            weights[source][destination] = inhibitoryInitWeight * randomUniform(randomGenerator);
-                        } else {
-                            weights[source][destination] = excitatoryInitWeight * randomUniform(randomGenerator);
-                        }
+                    if(source < state.inhibitorySize) {
+                        state.synapses.add(source, destination, state.inhibitoryInitWeight * randomUniform(state.randomGenerator));
+                    } else {
+                        state.synapses.add(source, destination, state.excitatoryInitWeight * randomUniform(state.randomGenerator));
                     }
                 }
             }
+
+            state.sourcesBuilt.store(source);
+            if(state.cancelled.load()) {
+                return;
+            }
         }
     }
 
     // in case of fully connected
     else {
-        for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-            for(int j = 0; j < latticeWidth * latticeHeight; j++) {
+        for(int i = 0; i < neuronCount; ++i) {
+            for(int j = 0; j < neuronCount; j++) {
                 if(i != j) {
-                    if(i < inhibitorySize) {
-                        weights[i][j] = inhibitoryInitWeight * randomUniform(randomGenerator);
+                    if(i < state.inhibitorySize) {
+                        state.synapses.add(i, j, state.inhibitoryInitWeight * randomUniform(state.randomGenerator));
                     } else {
-                        weights[i][j] = excitatoryInitWeight * randomUniform(randomGenerator);
+                        state.synapses.add(i, j, state.excitatoryInitWeight * randomUniform(state.randomGenerator));
                     }
                     connectionSum++;
                 }
             }
+
+            state.sourcesBuilt.store(i);
+            if(state.cancelled.load()) {
+                return;
+            }
         }
     }
 }
 
 // fully connected with same weight : This is for debug.
-void SpikingNet::setUniformNetwork() {
+void SpikingNet::setUniformNetwork(NetworkState& state) {
 
     int connectionSum = 0;
 
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        for(int j = 0; j < latticeWidth * latticeHeight; j++) {
+    for(int i = 0; i < state.latticeWidth * state.latticeHeight; ++i) {
+        for(int j = 0; j < state.latticeWidth * state.latticeHeight; j++) {
 
             if(i != j) {
-                if(i < inhibitorySize) {
-                    weights[i][j] = inhibitoryInitWeight;
+                if(i < state.inhibitorySize) {
+                    state.synapses.add(i, j, state.inhibitoryInitWeight);
+                } else if(j % 3 == 0) {
+                    state.synapses.add(i, j, state.excitatoryInitWeight * 1.50);
                 } else {
-                    weights[i][j] = excitatoryInitWeight;
-                    if(j % 3 == 0) weights[i][j] = excitatoryInitWeight * 1.50;
+                    state.synapses.add(i, j, state.excitatoryInitWeight);
                 }
                 connectionSum++;
             }
         }
+
+        state.sourcesBuilt.store(i);
+        if(state.cancelled.load()) {
+            return;
+        }
     }
 }
 
 // fully connected network with random weight
-void SpikingNet::setRandomNetwork() {
+void SpikingNet::setRandomNetwork(NetworkState& state) {
 
     std::uniform_real_distribution<> randomUniform(0.0, 1.0);
 
     int connectionSum = 0;
 
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        for(int j = 0; j < latticeWidth * latticeHeight; j++) {
+    for(int i = 0; i < state.latticeWidth * state.latticeHeight; ++i) {
+        for(int j = 0; j < state.latticeWidth * state.latticeHeight; j++) {
 
             if(i != j) {
-                if(i < inhibitorySize) {
-                    weights[i][j] = inhibitoryInitWeight * randomUniform(randomGenerator);
+                if(i < state.inhibitorySize) {
+                    state.synapses.add(i, j, state.inhibitoryInitWeight * randomUniform(state.randomGenerator));
 
                 } else {
-                    weights[i][j] = excitatoryInitWeight * randomUniform(randomGenerator);
+                    state.synapses.add(i, j, state.excitatoryInitWeight * randomUniform(state.randomGenerator));
                 }
                 connectionSum++;
             }
         }
+
+        state.sourcesBuilt.store(i);
+        if(state.cancelled.load()) {
+            return;
+        }
     }
 }
 
 // fully connected with same weight : This is for debug.
 // TODO: grid network ignores the connectionsPerNeuron param and instead uses gridNetworkConnectionRate. rewrite setGridNetwork() to use connectionsPerNeuron instead
-void SpikingNet::setGridNetwork() {
+void SpikingNet::setGridNetwork(NetworkState& state) {
 
     std::uniform_real_distribution<> randomUniform(0.0, 1.0);
 
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        int row = i / latticeWidth;
-        int col = i % latticeWidth;
-        for(int j = 0; j < latticeWidth * latticeHeight; j++) {
-            int row_target = j / latticeWidth;
-            int col_target = j % latticeWidth;
-            if(i < inhibitorySize) {
-                if(i != j && randomUniform(randomGenerator) < gridNetworkConnectionRate) {
-                    weights[i][j] = inhibitoryInitWeight * randomUniform(randomGenerator); // HERE!!!
-                } else {
-                    weights[i][j] = 0;
-                }
-            } else if (j < inhibitorySize) {
-                if(i != j && randomUniform(randomGenerator) < gridNetworkConnectionRate) {
-                    weights[i][j] = excitatoryInitWeight * randomUniform(randomGenerator); // HERE!!!
-                } else {
-                    weights[i][j] = 0;
+    // columns connected to on the same and neighbouring rows
+    const int columnOffsets[] = {-8, -1, 0, 1, 8};
+
+    for(int i = 0; i < state.latticeWidth * state.latticeHeight; ++i) {
+        int row = i / state.latticeWidth;
+        int col = i % state.latticeWidth;
+        if(i < state.inhibitorySize) {
+            addRandomSynapses(state, i, 0, state.latticeWidth * state.latticeHeight, state.inhibitoryInitWeight);
+        } else {
+            addRandomSynapses(state, i, 0, state.inhibitorySize, state.excitatoryInitWeight);
+
+            // excitatory neighbours are enumerated directly instead of testing every neuron
+            for(int row_target = std::max(row - 1, 0); row_target <= std::min(row + 1, state.latticeHeight - 1); row_target++) {
+                for(int offset : columnOffsets) {
+                    int col_target = col + offset;
+                    int j = row_target * state.latticeWidth + col_target;
+                    if(col_target >= 0 && col_target < state.latticeWidth && j != i && j >= state.inhibitorySize) {
+                        state.synapses.add(i, j, state.excitatoryInitWeight * randomUniform(state.randomGenerator));
+                    }
                 }
-            } else if (i != j && (abs(row - row_target) <= 1 && (abs(col - col_target) <= 1  || abs(col - col_target) == 8))) {
-                weights[i][j] = excitatoryInitWeight * randomUniform(randomGenerator);  // HERE!!!
-            } else {
-                weights[i][j] = 0;
             }
         }
+
+        state.sourcesBuilt.store(i);
+        if(state.cancelled.load()) {
+            return;
+        }
+    }
+}
+
+// connects source to each neuron in [begin, end) except itself with probability gridNetworkConnectionRate, with a random weight in [0, weight).
+// instead of drawing a number for every neuron, this draws the distance to the next connected one, which is geometrically distributed,
+// so the cost is proportional to the number of synapses added
+void SpikingNet::addRandomSynapses(NetworkState& state, int source, int begin, int end, double weight) {
+    std::uniform_real_distribution<> randomUniform(0.0, 1.0);
+
+    if(state.gridNetworkConnectionRate <= 0) {
+        return;
+    }
+
+    double logMissRate = std::log(std::max(1.0 - state.gridNetworkConnectionRate, 0.0));
+
+    int j = begin - 1;
+    while(true) {
+        // number of neurons skipped before the next connected one. with a rate of 1 or more, logMissRate is -inf and nothing is skipped
+        double skipped = std::floor(std::log(1.0 - randomUniform(state.randomGenerator)) / logMissRate);
+        if(!(skipped < end - j - 1)) {
+            break;
+        }
+
+        j += 1 + (int) skipped;
+        if(j != source) {
+            state.synapses.add(source, j, weight * randomUniform(state.randomGenerator));
+        }
     }
 }
 
@@ -300,15 +504,82 @@ void SpikingNet::computeIteration(double deltaTime) {
     // apply time scale
     deltaTime *= timeScale / 100.0 * 30.0 / 1000.0;
 
-    // update routine
-    if(flagDecay) applyDecay(deltaTime);
-    if(flagSTDP)  computeSTDP(deltaTime);
-    if(flagSTP)   computeSTP(deltaTime);
+    // update routine, specialized for the current flags
+    (this->*stepKernel)(deltaTime);
+}
+
+template<bool decay, bool STDP, bool STP>
+void SpikingNet::step(double deltaTime) {
+    if(decay) applyDecay(deltaTime);
+    if(STDP)  computeSTDP(deltaTime);
 
     applyConnections();
-    applyIzhikevich(deltaTime);
+    stepNeurons<STDP, STP>(deltaTime);
+}
+
+template<bool STDP, bool STP>
+void SpikingNet::stepNeurons(double deltaTime) {
+    // the exponential is only evaluated when deltaTime changes
+    if(STDP && deltaTime != STDPTraceDeltaTime) {
+        STDPTraceDeltaTime = deltaTime;
+        STDPTraceDecay = std::pow(0.95, 1000.0 * deltaTime);
+    }
+
+    int neuronCount = latticeWidth * latticeHeight;
+    neurons.clearSpikes();
+
+    // the small tolerance keeps an iteration that is a whole number of steps long from getting an extra substep through rounding
+    int substeps = std::max(1, (int) std::ceil(deltaTime * 1000.0 / integrationStep - 1e-9));
+
+    // each block is small enough to stay in cache from the noise to the plasticity state
+    for(int begin = 0; begin < neurons.getPaddedSize(); begin += stepBlockSize) {
+        int end = std::min(begin + stepBlockSize, neurons.getPaddedSize());
+        int last = std::min(end, neuronCount);
+        int excitatoryBegin = std::max(begin, std::min(inhibitorySize, last));
+
+        // pseudo thalamus noise-input. the samples are generated from (step, neuron index) rather than drawn one after the other,
+        // so any part of them can be generated on its own and the result is the same however the work is split
+        if(last > begin) {
+            PhiloxRandom::normal(noiseKey, noiseStep, begin, last - begin, noiseSamples.data() + begin);
+        }
+        for(int i = begin; i < excitatoryBegin; ++i) {
+            neurons.addToI(i, inhibitoryNoise * noiseSamples[i]);
+        }
+        for(int i = excitatoryBegin; i < last; ++i) {
+            neurons.addToI(i, excitatoryNoise * noiseSamples[i]);
+        }
+
+        // update differential equation and apply firing, this also clears the input currents
+        neurons.step(begin, end, deltaTime, substeps);
+
+        // the STDP traces and STP of the excitatory neurons follow the firing status that was just decided. they are read by computeSTDP and
+        // applyConnections on the next iteration
+        if(STDP || STP) {
+            for(int i = excitatoryBegin; i < last; ++i) {
+                bool isFiring = neurons.isFiring(i);
+                // if the neuron is currently firing, its trace starts over. else, it decays by one step
+                if(STDP) STDPTraces[i] = isFiring ? 1.0 : STDPTraces[i] * STDPTraceDecay;
+                if(STP)  STPw[i] = STPStrength * computeSTPForNeuron(i, isFiring, deltaTime);
+            }
+        }
+    }
+
+    noiseStep++;
+
+    // the potentials changed
+    latticeValuesValid = false;
+}
+
+void SpikingNet::selectStepKernel() {
+    // indexed by flagDecay, flagSTDP, flagSTP
+    static void (SpikingNet::* const kernels[2][2][2])(double) = {
+        {{&SpikingNet::step<false, false, false>, &SpikingNet::step<false, false, true>},
+         {&SpikingNet::step<false, true, false>, &SpikingNet::step<false, true, true>}},
+        {{&SpikingNet::step<true, false, false>, &SpikingNet::step<true, false, true>},
+         {&SpikingNet::step<true, true, false>, &SpikingNet::step<true, true, true>}}
+    };
 
-    applyFiring();
+    stepKernel = kernels[flagDecay][flagSTDP][flagSTP];
 }
 
 double sigmoid(double value) {
@@ -349,54 +620,52 @@ double softKneePositive(double value, double window) {
     return (softKnee(2.0 * value - 1.0, window) + 1.0) * 0.5;
 }
 
-void SpikingNet::applyFiring() {
-    // apply firing status to neurons
-    for(int i = 0; i < latticeWidth * latticeHeight; i++) {
-        neurons[i].applyFiring();
-    }
-}
-
 void SpikingNet::applyConnections() {
 
-    // setup normal distribution random function
-    std::normal_distribution<> randomUniform(0.0, 1.0);
+    qint64 start = DeadlineClock::now();
 
-    // pseudo thalamus noise-input
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        if(i < inhibitorySize) {
-            neurons[i].addToI(inhibitoryNoise * randomUniform(randomGenerator));
-        }else{
-            neurons[i].addToI(excitatoryNoise * randomUniform(randomGenerator));
-        }
+    // input from connected neurons with STP, driven by the spikes of the previous step.
+    // pushing every spike along its outgoing synapses is a scattered write per synapse, while pulling every neuron's input from its incoming synapses
+    // reads all of them in order. both add the inputs of each neuron in increasing source order, so they give the same result
+    const int* spikes = neurons.getSpikes();
+    int spikeCount = neurons.getSpikeCount();
+    qint64 activeSynapses = 0;
+    for(int k = 0; k < spikeCount; ++k) {
+        activeSynapses += synapses.getRowEnd(spikes[k]) - synapses.getRowBegin(spikes[k]);
     }
 
-    // input from connected neurons with STP
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        if(neurons[i].isFiring()) {
-            for(int j = 0; j < latticeWidth * latticeHeight; ++j) {
-                if(i != j) {
+    if(activeSynapses <= denseActivityThreshold * synapses.getSynapseCount()) {
+        for(int k = 0; k < spikeCount; ++k) {
+            int i = spikes[k];
+            for(int s = synapses.getRowBegin(i); s < synapses.getRowEnd(i); ++s) {
+                int j = synapses.getDestination(s);
+                if(i > inhibitorySize)
+                    neurons.addToI(j, (float) synapses.getWeight(s) * (float)STPw[i]);
+                else
+                    neurons.addToI(j, (float) synapses.getWeight(s));
+            }
+        }
+
+        propagationSparse.record(DeadlineClock::now() - start);
+    } else {
+        for(int j = 0; j < latticeWidth * latticeHeight; ++j) {
+            for(int entry = synapses.getColumnBegin(j); entry < synapses.getColumnEnd(j); ++entry) {
+                int i = synapses.getColumnSource(entry);
+                if(neurons.isFiring(i)) {
+                    double weight = synapses.getWeight(synapses.getColumnSynapse(entry));
                     if(i > inhibitorySize)
-                        neurons[j].addToI((float) weights[i][j] * (float)STPw[i]);
+                        neurons.addToI(j, (float) weight * (float)STPw[i]);
                     else
-                        neurons[j].addToI((float) weights[i][j]);
+                        neurons.addToI(j, (float) weight);
                 }
             }
         }
-    }
 
-}
-
-void SpikingNet::applyIzhikevich(double deltaTime) {
-
-    // update differential equation
-    for(int i = 0; i < latticeWidth * latticeHeight; ++i) {
-        neurons[i].update(deltaTime);
-        neurons[i].setI(0.0);
+        propagationDense.record(DeadlineClock::now() - start);
     }
 
 }
 
-
 void SpikingNet::computeSTDP(double deltaTime) {
 
     // read http://www.scholarpedia.org/article/Spike-timing_dependent_plasticity for more info on the maths behind this
@@ -423,54 +692,49 @@ void SpikingNet::computeSTDP(double deltaTime) {
     //              A -> B becomes    A -> B becomes
     //                 stronger           weaker
 
-    // each neuron has a STDPTimes[i] value that store how long ago it fired
-    // the weight change is applied using the above function if the time difference between two neurons firing is smaller or equal to STDPWindow
-
-    for(int i = inhibitorySize; i < latticeWidth * latticeHeight; ++i) {
-        if(neurons[i].isFiring()) {
-            // if the neuron is currently firing, set its STDPTimes to 0.
-            STDPTimes[i] = 0;
-        } else {
-            // else, increase it by deltaTime
-            STDPTimes[i] += deltaTime;
-        }
-
-    }
+    // each neuron has a STDPTraces[i] value that decays exponentially with the time since it fired, which is the above function sampled at that time.
+    // the traces are updated by stepNeurons right after firing. the weight change is applied if the time difference between two neurons firing is
+    // smaller or equal to STDPWindow. this is O(synapses of the firing neurons), no pair of neurons is ever scanned
 
+    // only existing synapses can change, so the neurons j are found through the synapses of i: incoming ones through the transposed index,
+    // outgoing ones through the row of i. synapses whose weight reached 0 stay at 0
     double deltaTimeMillis = deltaTime * 1000.0;
-    double d;
-    for(int i = inhibitorySize; i < latticeWidth * latticeHeight; i++) {
-        if(neurons[i].isFiring()) {
-            for(int j = inhibitorySize; j < latticeWidth * latticeHeight; j++) {
-
-                if(STDPTimes[j] <= STDPWindow && STDPTimes[j] != 0 && i != j) {
-                    // another (uniquely different) neuron has fired in the last STDPTau frames (excluding the current frame)
-
-                    // this is part of the exponential function described above
-                    d = deltaTimeMillis * (0.1 * STDPStrength * pow(0.95, (1000.0 * STDPTimes[j])));
-
-                    // update the weight from j to i, should be increased since j fired before i.
-                    if(weights[j][i] != 0.0) {
-                        weights[j][i] += d;
-                        if (weights[j][i] > weightMax) weights[j][i] = weightMax;
-
-                    }
-
-                    // update the weight from i to j, should be lowered since i fired before j. careful! only the indexing changes.
-                    if(weights[i][j] != 0.0) {
-                        weights[i][j] -= d;
-                        if(weights[i][j] < weightMin) weights[i][j] = weightMin;
+    double scale = deltaTimeMillis * 0.1 * STDPStrength;
+    const int* spikes = neurons.getSpikes();
+    int spikeCount = neurons.getSpikeCount();
+    for(int k = 0; k < spikeCount; k++) {
+        int i = spikes[k];
+        if(i < inhibitorySize) {
+            continue;
+        }
 
-                    }
+        // update the weights from j to i, should be increased since j fired before i.
+        for(int entry = synapses.getColumnBegin(i); entry < synapses.getColumnEnd(i); entry++) {
+            int j = synapses.getColumnSource(entry);
+            // another (uniquely different) neuron has fired within the window (excluding the current frame)
+            if(j >= inhibitorySize && !neurons.isFiring(j) && STDPTraces[j] >= STDPWindowTrace) {
+                int synapse = synapses.getColumnSynapse(entry);
+                double weight = synapses.getWeight(synapse);
+                if(weight != 0.0) {
+                    weight += scale * STDPTraces[j];
+                    if (weight > weightMax) weight = weightMax;
+                    synapses.writeWeight(synapse, weight);
                 }
             }
         }
-    }
-}
 
-void SpikingNet::computeSTP(double deltaTime) {
-    for(int i = inhibitorySize; i < latticeWidth * latticeHeight; ++i) {
-        STPw[i] = STPStrength * computeSTPForNeuron(i, neurons[i].isFiring(), deltaTime);
+        // update the weights from i to j, should be lowered since i fired before j.
+        for(int s = synapses.getRowBegin(i); s < synapses.getRowEnd(i); s++) {
+            int j = synapses.getDestination(s);
+            if(j >= inhibitorySize && !neurons.isFiring(j) && STDPTraces[j] >= STDPWindowTrace) {
+                double weight = synapses.getWeight(s);
+                if(weight != 0.0) {
+                    weight -= scale * STDPTraces[j];
+                    if(weight < weightMin) weight = weightMin;
+                    synapses.writeWeight(s, weight);
+                }
+            }
+        }
     }
 }
 
@@ -514,11 +778,9 @@ double SpikingNet::computeSTPForNeuron(int index, bool isFiring, double deltaTim
 void SpikingNet::applyDecay(double deltaTime) {
     double decayConstantTimeCompensated = pow(decayConstant, deltaTime);
 
-    for(int i = inhibitorySize; i < latticeWidth * latticeHeight; i++) {
-        for(int j = inhibitorySize; j < latticeWidth * latticeHeight; j++) {
-            weights[i][j] = weights[i][j] * decayConstantTimeCompensated;
-        }
-    }
+    // excitatory to excitatory synapses only. they are marked as scaled in initialize, so this is a single multiplication
+    // of the global scale instead of a pass over the synapses
+    synapses.scale(decayConstantTimeCompensated);
 
 }
 
@@ -544,6 +806,10 @@ double SpikingNet::getExcitatoryNoise() const {
     return this->excitatoryNoise;
 }
 
+double SpikingNet::getIntegrationStep() const {
+    return this->integrationStep;
+}
+
 double SpikingNet::getSTPStrength() const {
     return this->STPStrength;
 }
@@ -583,7 +849,7 @@ void SpikingNet::writeInhibitoryPortion(double inhibitoryPortion) {
     // do the change
     this->inhibitoryPortion = inhibitoryPortion;    
     // re-initialize
-    initialize();
+    reinitialize();
     // signal
     emit valueChanged("inhibitoryPortion", QVariant(inhibitoryPortion));
     emit inhibitoryPortionChanged(inhibitoryPortion);
@@ -604,7 +870,7 @@ void SpikingNet::writeInhibitoryNeuronType(NeuronType inhibitoryNeuronType) {
     // do the change
     this->inhibitoryNeuronType = inhibitoryNeuronType;
     // re-initialize
-    initialize();
+    reinitialize();
     // signal
     emit valueChanged("inhibitoryNeuronType", QVariant(static_cast<int>(inhibitoryNeuronType)));
     emit inhibitoryNeuronTypeChanged(inhibitoryNeuronType);
@@ -625,7 +891,7 @@ void SpikingNet::writeExcitatoryNeuronType(NeuronType excitatoryNeuronType) {
     // do the change
     this->excitatoryNeuronType = excitatoryNeuronType;
     // re-initialize
-    initialize();
+    reinitialize();
     // signal
     emit valueChanged("excitatoryNeuronType", QVariant(static_cast<int>(excitatoryNeuronType)));
     emit excitatoryNeuronTypeChanged(excitatoryNeuronType);
@@ -665,6 +931,24 @@ void SpikingNet::writeExcitatoryNoise(double excitatoryNoise) {
     emit excitatoryNoiseChanged(excitatoryNoise);
 }
 
+void SpikingNet::writeIntegrationStep(double integrationStep) {
+    // a step of 0 would never end an iteration
+    if(this->integrationStep == integrationStep || integrationStep <= 0)
+        return;
+
+    if(flagDebug) {
+        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+        );
+
+        qDebug() << "writeIntegrationStep:\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
+    }
+
+    this->integrationStep = integrationStep;
+    emit valueChanged("integrationStep", QVariant(integrationStep));
+    emit integrationStepChanged(integrationStep);
+}
+
 void SpikingNet::writeSTPStrength(double STPStrength) {
     if(this->STPStrength == STPStrength)
         return;
@@ -730,6 +1014,7 @@ void SpikingNet::writeFlagSTP(bool flagSTP) {
     }
 
     this->flagSTP = flagSTP;
+    selectStepKernel();
     emit valueChanged("flag_STPStrength", QVariant(flagSTP));
     emit flagSTPChanged(flagSTP);
 }
@@ -747,6 +1032,7 @@ void SpikingNet::writeFlagSTDP(bool flagSTDP) {
     }
 
     this->flagSTDP = flagSTDP;
+    selectStepKernel();
     emit valueChanged("flag_STDPStrength", QVariant(flagSTDP));
     emit flagSTDPChanged(flagSTDP);
 }
@@ -764,6 +1050,7 @@ void SpikingNet::writeFlagDecay(bool flagDecay) {
     }
 
     this->flagDecay = flagDecay;
+    selectStepKernel();
     emit valueChanged("flag_decayHalfLife", QVariant(flagDecay));
     emit flagDecayChanged(flagDecay);
 }
@@ -806,14 +1093,115 @@ void SpikingNet::writeFlagDecay(bool flagDecay) {
 //    // signals are emitted from Generator::writeLatticeWidth once this is done
 //}
 
-double SpikingNet::getLatticeValue(int x, int y) {
-    int index = x % latticeWidth + y * latticeWidth;
-    return std::min<double>(1.0, std::max<double>(0.0, (neurons[index].getV() - neurons[index].getC()) / (neurons[index].getPotentialThreshold() - neurons[index].getC())));
+void SpikingNet::readLatticeRow(int x, int y, int count, float* values) {
+    if(!latticeValuesValid) {
+        neurons.computeNormalizedPotentials(latticeValues.data());
+        latticeValuesValid = true;
+    }
+    std::copy_n(&latticeValues[x + y * latticeWidth], count, values);
 }
 
-void SpikingNet::writeLatticeValue(int x, int y, double value) {
+void SpikingNet::fillLatticeRow(int x, int y, int count, double value) {
     // 2 * (firing treshold) gain provided somewhat arbitrarily to provide more responsiveness to signals in the 0-1 range.
-    int index = x % latticeWidth + y * latticeWidth;
-    double gain = neurons[index].getPotentialThreshold() * 2.0;
-    neurons[index].addToI(value * gain);
+    int index = x + y * latticeWidth;
+    Izhikevich::Scalar deltaI = value * neurons.getPotentialThreshold() * 2.0;
+    for(int i = 0; i < count; i++) {
+        neurons.addToI(index + i, deltaI);
+    }
+}
+
+void SpikingNet::writeState(StateWriter& writer) {
+    commitInitialize(true);
+
+    int neuronCount = latticeWidth * latticeHeight;
+
+    writer.writeValue(stateVersion);
+    writer.writeValue(latticeWidth);
+    writer.writeValue(latticeHeight);
+    writer.writeValue(inhibitorySize);
+    neurons.writeState(writer);
+    synapses.writeState(writer);
+    writer.writeArray(STDPTraces.data(), neuronCount);
+    writer.writeValue(STDPTraceDecay);
+    writer.writeValue(STDPTraceDeltaTime);
+    writer.writeArray(STPu, neuronCount);
+    writer.writeArray(STPx, neuronCount);
+    writer.writeArray(STPw, neuronCount);
+    writer.writeValue(noiseKey);
+    writer.writeValue(noiseStep);
+}
+
+bool SpikingNet::readState(StateReader& reader) {
+    if(flagDebug) {
+        std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+        );
+
+        qDebug() << "readState (SpikingNet):\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
+    }
+
+    quint32 version;
+    std::unique_ptr<NetworkState> state(new NetworkState());
+    if(!reader.readValue(version) || version != stateVersion || !reader.readValue(state->latticeWidth) ||
+       !reader.readValue(state->latticeHeight) || !reader.readValue(state->inhibitorySize)) {
+        return false;
+    }
+
+    int neuronCount = state->latticeWidth * state->latticeHeight;
+    if(state->latticeWidth != requestedLatticeWidth || state->latticeHeight != requestedLatticeHeight ||
+       state->inhibitorySize != (int) (neuronCount * inhibitoryPortion)) {
+        return false;
+    }
+
+    if(!state->neurons.readState(reader, neuronCount) ||
+       !state->synapses.readState(reader) || state->synapses.getNeuronCount() != neuronCount) {
+        return false;
+    }
+
+    double savedSTDPTraceDecay = 1.0;
+    double savedSTDPTraceDeltaTime = 0.0;
+    const double* savedSTDPTraces = reader.readArray<double>(neuronCount);
+    reader.readValue(savedSTDPTraceDecay);
+    reader.readValue(savedSTDPTraceDeltaTime);
+    const double* savedSTPu = reader.readArray<double>(neuronCount);
+    const double* savedSTPx = reader.readArray<double>(neuronCount);
+    const double* savedSTPw = reader.readArray<double>(neuronCount);
+    quint64 savedNoiseStep = 0;
+    reader.readValue(state->noiseKey);
+    reader.readValue(savedNoiseStep);
+    if(!reader.isValid()) {
+        return false;
+    }
+
+    // the parameters of the project were set just before, so their rebuild is running. the saved network replaces it,
+    // whereas the rebuild goes on if the state can't be read
+    discardNetworkBuild();
+
+    // the random generator isn't part of the snapshot, the running network doesn't draw from it
+    state->randomGenerator = randomGenerator;
+    adoptNetworkState(*state);
+
+    std::copy(savedSTDPTraces, savedSTDPTraces + neuronCount, STDPTraces.begin());
+    STDPTraceDecay = savedSTDPTraceDecay;
+    STDPTraceDeltaTime = savedSTDPTraceDeltaTime;
+    std::copy(savedSTPu, savedSTPu + neuronCount, STPu);
+    std::copy(savedSTPx, savedSTPx + neuronCount, STPx);
+    std::copy(savedSTPw, savedSTPw + neuronCount, STPw);
+    noiseStep = savedNoiseStep;
+
+    writeInitializeProgress(1.0);
+
+    return true;
+}
+
+void SpikingNet::writeStats(QVariantMap& stats) {
+    QVariantMap propagation;
+    propagation.insert("sparse", propagationSparse.toVariantMap());
+    propagation.insert("dense", propagationDense.toVariantMap());
+    stats.insert("propagation", propagation);
+}
+
+void SpikingNet::resetStats() {
+    propagationSparse.reset();
+    propagationDense.reset();
 }
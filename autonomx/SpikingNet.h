@@ -15,12 +15,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <memory>
 #include <random>
 #include <vector>
 
 #include "Generator.h"
 #include "Izhikevich.h"
 #include "GeneratorField.h"
+#include "SynapseMatrix.h"
 
 class SpikingNet : public Generator {
     // TODO: figure out how we decide to add / remove inputs. this should probably be a property that belongs to the Generator abstract class, rather than this.
@@ -30,6 +34,7 @@ class SpikingNet : public Generator {
     Q_PROPERTY(NeuronType excitatoryNeuronType READ getExcitatoryNeuronType WRITE writeExcitatoryNeuronType NOTIFY excitatoryNeuronTypeChanged)
     Q_PROPERTY(double inhibitoryNoise READ getInhibitoryNoise WRITE writeInhibitoryNoise NOTIFY inhibitoryNoiseChanged)
     Q_PROPERTY(double excitatoryNoise READ getExcitatoryNoise WRITE writeExcitatoryNoise NOTIFY excitatoryNoiseChanged)
+    Q_PROPERTY(double integrationStep READ getIntegrationStep WRITE writeIntegrationStep NOTIFY integrationStepChanged)
 
     Q_PROPERTY(double STPStrength READ getSTPStrength WRITE writeSTPStrength NOTIFY STPStrengthChanged)
     Q_PROPERTY(double STDPStrength READ getSTDPStrength WRITE writeSTDPStrength NOTIFY STDPStrengthChanged)
@@ -52,7 +57,6 @@ public:
 private:
     NetworkType networkType = NetworkType::GridNetwork;
     int         connectionsPerNeuron = 20; // this is used in any non-grid network
-    int         randomSeed = 0;
     double      gridNetworkConnectionRate = 0.01; // this is used in the grid network
 
     double      inhibitoryPortion = 0.2;
@@ -65,6 +69,10 @@ private:
     double      excitatoryInitWeight = 15.0;
     double      excitatoryNoise = 5.0;
 
+    // largest step of the neuron integration, in ms. each iteration is split into as many equal substeps as needed, so that v stays
+    // stable at high timeScale or when the compute loop lags
+    double      integrationStep = 0.5;
+
     double      weightMax = 20.0;
     double      weightMin = 0.0;
 
@@ -80,42 +88,108 @@ private:
     bool        flagSTDP                = false;
     bool        flagDecay               = false;
     bool        flagDirectConnection    = true;
-    bool        flagRandomDevice        = true;
     bool        flagDebug               = false;
 
     // the neurons
-    std::vector<Izhikevich> neurons;
-    // the weights
-    double** weights;
-
-    // STDP
-    std::vector<int> STDPTimes;
+    Izhikevich neurons;
+
+    // normalized potentials returned by readLatticeRow, computed for the whole lattice on the first call after an iteration
+    AlignedVector<Izhikevich::Scalar> latticeValues;
+    bool latticeValuesValid = false;
+    // the weights, only for the synapses that exist
+    SynapseMatrix synapses;
+
+    // thalamic noise. noiseSamples holds the standard normal samples of the current step, drawn from PhiloxRandom with noiseKey and noiseStep,
+    // so that the noise of a neuron only depends on the seed, the step and its index
+    quint64 noiseKey = 0;
+    quint64 noiseStep = 0;
+    std::vector<double> noiseSamples;
+
+    // layout of writeState, increased whenever it changes
+    static constexpr quint32 stateVersion = 1;
+
+    // spike propagation. applyConnections walks the outgoing synapses of the neurons that fired (sparse), unless more than
+    // denseActivityThreshold of all synapses would be walked, in which case it reads every incoming synapse in order instead (dense)
+    double denseActivityThreshold = 0.2;
+    LatencyHistogram propagationSparse;     // time taken by applyConnections in each regime
+    LatencyHistogram propagationDense;
+
+    // STDP. each neuron has an exponential trace of its last spike, 0.95 ^ (time since the spike in ms). it is 1 on the step the neuron fires,
+    // 0 if it never fired, and is multiplied by STDPTraceDecay on every other step. the same trace serves as the presynaptic trace (potentiation)
+    // and the postsynaptic trace (depression) since both sides of the window use the same time constant
+    std::vector<double> STDPTraces;
     double STDPWindow = 20.0 / 1000.0;
+    // value of a trace at the end of the window, older spikes are ignored. slightly lowered so that the rounding of the repeated decay doesn't drop a spike landing exactly on the window
+    double STDPWindowTrace = std::pow(0.95, 1000.0 * STDPWindow) * (1.0 - 1e-9);
+    double STDPTraceDecay = 1.0;            // 0.95 ^ (deltaTime in ms), recomputed when deltaTime changes
+    double STDPTraceDeltaTime = 0.0;        // deltaTime STDPTraceDecay was computed for
 
     // STP
     double* STPu;
     double* STPx;
     double* STPw;
 
-    std::mt19937 randomGenerator;
+    // everything initialize builds from the parameters. the builders only read and write a NetworkState, so that reinitialize can build
+    // one on a worker thread while the current network keeps running, and commitInitialize swaps it in between frames
+    struct NetworkState {
+        // parameters, copied when the build starts
+        int latticeWidth;
+        int latticeHeight;
+        int inhibitorySize;
+        NeuronType inhibitoryNeuronType;
+        NeuronType excitatoryNeuronType;
+        NetworkType networkType;
+        int connectionsPerNeuron;
+        double gridNetworkConnectionRate;
+        double inhibitoryInitWeight;
+        double excitatoryInitWeight;
+        bool seeded;
+        quint32 seed;
+
+        // built state
+        std::mt19937 randomGenerator;
+        Izhikevich neurons;
+        SynapseMatrix synapses;
+        quint64 noiseKey;
+
+        std::atomic<int> sourcesBuilt{0};   // neurons whose outgoing synapses are built, read by commitInitialize for the progress
+        std::atomic<bool> cancelled{false}; // set when the result won't be used, the builders then stop early
+    };
+
+    std::unique_ptr<NetworkState> pendingState;     // state built in the background, only valid while pendingBuild is
+    std::future<void> pendingBuild;                 // only accessed on the thread of the generator, the destructor cancels it
+    bool flagReinitializeRequested = false;         // parameters changed while pendingBuild was running, so its result is outdated
 
     inline int indexInhibitoryNeuron(int i);
     inline int indexExcitatoryNeuron(int i);
 
-    inline void applyIzhikevich(double deltaTime);
     inline void applyConnections();
-    inline void applyFiring();
     inline void applyDecay(double deltaTime);
     inline void computeSTDP(double deltaTime);
-    inline void computeSTP(double deltaTime);
     inline double computeSTPForNeuron(int index, bool isFiring, double deltaTime);
 
-    void setRandomNetwork();
-    void setSparseGraph();
-    void setSparseNetwork();
-    void setUniformNetwork();
-    void setChainNetwork();
-    void setGridNetwork();
+    // one iteration, with the flags known at compile time so that disabled stages cost nothing. selectStepKernel picks the instance
+    // matching flagDecay, flagSTDP and flagSTP into stepKernel whenever one of them changes
+    template<bool decay, bool STDP, bool STP> void step(double deltaTime);
+    // noise, integration, firing and the STDP / STP state of the neurons, in one pass over blocks of stepBlockSize neurons
+    template<bool STDP, bool STP> void stepNeurons(double deltaTime);
+    void selectStepKernel();
+    void (SpikingNet::*stepKernel)(double) = nullptr;
+    static const int stepBlockSize = 256;     // a multiple of simdPadding
+
+    void startNetworkBuild();
+    // cancels the background build if there is one, and waits for it to stop
+    void discardNetworkBuild();
+    std::unique_ptr<NetworkState> captureNetworkState();
+    void adoptNetworkState(NetworkState& state);
+
+    static void buildNetworkState(NetworkState& state);
+    static void buildNetwork(NetworkState& state);
+    static void setRandomNetwork(NetworkState& state);
+    static void setSparseNetwork(NetworkState& state);
+    static void setUniformNetwork(NetworkState& state);
+    static void setGridNetwork(NetworkState& state);
+    static void addRandomSynapses(NetworkState& state, int source, int begin, int end, double weight);
 
 public:
     SpikingNet(int id, GeneratorMeta * meta);
@@ -123,8 +197,18 @@ public:
 
     void computeIteration(double deltaTime) override;
     void initialize() override;
-    double getLatticeValue(int x, int y) override;
-    void writeLatticeValue(int x, int y, double value) override;
+    // rebuilds the network in the background, see NetworkState
+    void reinitialize() override;
+    void commitInitialize(bool wait) override;
+    void readLatticeRow(int x, int y, int count, float* values) override;
+    void fillLatticeRow(int x, int y, int count, double value) override;
+    // the neurons, synapses and plasticity state. this waits for a background build first, so the saved state matches the parameters
+    void writeState(StateWriter& writer) override;
+    bool readState(StateReader& reader) override;
+
+    // adds "propagation": { "sparse", "dense": histogram summaries (see LatencyHistogram::toVariantMap) }
+    void writeStats(QVariantMap& stats) override;
+    void resetStats() override;
 
     int getNeuronSize() const;
     double getInhibitoryPortion() const;
@@ -132,6 +216,7 @@ public:
     NeuronType getExcitatoryNeuronType() const;
     double getInhibitoryNoise() const;
     double getExcitatoryNoise() const;
+    double getIntegrationStep() const;
     double getSTPStrength() const;
     double getSTDPStrength() const;
     double getDecayHalfLife() const;
@@ -145,6 +230,7 @@ public:
     void writeExcitatoryNeuronType(NeuronType excitatoryNeuronType);
     void writeInhibitoryNoise(double inhibitoryNoise);
     void writeExcitatoryNoise(double excitatoryNoise);
+    void writeIntegrationStep(double integrationStep);
     void writeSTPStrength(double STPStrength);
     void writeSTDPStrength(double STDPStrength);
     void writeDecayHalfLife(double decayHalfLife);
@@ -159,6 +245,7 @@ signals:
     void excitatoryNeuronTypeChanged(NeuronType excitatoryNeuronType);
     void inhibitoryNoiseChanged(double inhibitoryNoise);
     void excitatoryNoiseChanged(double excitatoryNoise);
+    void integrationStepChanged(double integrationStep);
     void STPStrengthChanged(double STPStrength);
     void STDPStrengthChanged(double STDPStrength);
     void decayHalfLifeChanged(double decayHalfLife);
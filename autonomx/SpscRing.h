@@ -0,0 +1,96 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+// bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+//
+// elements are preallocated and written in place, so nothing is allocated or copied through a temporary once the ring is built:
+// the producer calls acquire() to get a free slot, fills it, then publish(). the consumer calls front() to look at the oldest slot, then pop().
+// when the ring is full, acquire() returns nullptr and the element is counted as dropped.
+//
+// the consumer can change thread between calls as long as the hand-off is synchronized (ComputeEngine's frame barrier does that).
+template <typename T>
+class SpscRing {
+public:
+    // capacity is rounded up to a power of two
+    SpscRing(int capacity) : head(0), tail(0), dropped(0) {
+        size_t size = 1;
+        while(size < (size_t) capacity) {
+            size <<= 1;
+        }
+        buffer.resize(size);
+        mask = size - 1;
+    }
+
+    // producer side. returns the element to write to, or nullptr if the ring is full
+    T* acquire() {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if(currentTail - head.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &buffer[currentTail & mask];
+    }
+
+    // producer side. makes the slot returned by acquire() visible to the consumer
+    void publish() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer side. returns the oldest element, or nullptr if the ring is empty
+    const T* front() const {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if(currentHead == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &buffer[currentHead & mask];
+    }
+
+    // consumer side. returns the element that comes offset places after the oldest one, or nullptr if there isn't one
+    const T* peek(size_t offset) const {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if(offset >= tail.load(std::memory_order_acquire) - currentHead) {
+            return nullptr;
+        }
+        return &buffer[(currentHead + offset) & mask];
+    }
+
+    // consumer side. releases the element returned by front()
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer side. number of elements waiting to be read
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+    }
+
+    // number of elements refused because the ring was full. this can be read from any thread
+    quint64 getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    // head and tail are on their own cache lines so that the two threads don't invalidate each other's line on every operation
+    alignas(64) std::atomic<size_t> head;   // next slot to read, only written by the consumer
+    alignas(64) std::atomic<size_t> tail;   // next slot to write, only written by the producer
+    alignas(64) std::atomic<quint64> dropped;
+};
@@ -0,0 +1,129 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <QDebug>
+
+#include "StateSnapshot.h"
+
+static const char tableMagic[8] = {'A', 'T', 'N', 'X', 'S', 'T', 'A', 'T'};
+static const char trailerMagic[8] = {'A', 'T', 'N', 'X', 'E', 'N', 'D', '1'};
+
+bool StateSnapshot::write(QIODevice& device, qint64 cborSize, const QList<QPair<int, QByteArray>>& blobs) {
+    StateWriter table;
+    qint64 position = cborSize;
+    QByteArray padding;
+
+    // offsets first, so that the table can be written once the blobs are in place
+    QList<qint64> offsets;
+    for(const QPair<int, QByteArray>& blob : blobs) {
+        position += (stateAlignment - position % stateAlignment) % stateAlignment;
+        offsets.append(position);
+        position += blob.second.size();
+    }
+
+    position = cborSize;
+    for(int i = 0; i < blobs.size(); i++) {
+        padding.fill('\0', offsets[i] - position);
+        if(device.write(padding) != padding.size() || device.write(blobs[i].second) != blobs[i].second.size()) {
+            return false;
+        }
+        position = offsets[i] + blobs[i].second.size();
+    }
+
+    for(int i = 0; i < 8; i++) {
+        table.writeValue(tableMagic[i]);
+    }
+    table.writeValue(version);
+    table.writeValue(byteOrderMark);
+    table.writeValue((quint64) cborSize);
+    table.writeValue((quint32) blobs.size());
+    for(int i = 0; i < blobs.size(); i++) {
+        table.writeValue((qint32) blobs[i].first);
+        table.writeValue((quint32) 0);
+        table.writeValue((quint64) offsets[i]);
+        table.writeValue((quint64) blobs[i].second.size());
+    }
+
+    StateWriter trailer;
+    trailer.writeValue((quint64) position);
+    for(int i = 0; i < 8; i++) {
+        trailer.writeValue(trailerMagic[i]);
+    }
+
+    return device.write(table.getData()) == table.getData().size() && device.write(trailer.getData()) == trailer.getData().size();
+}
+
+qint64 StateSnapshot::read(const uchar* file, qint64 size, QHash<int, QPair<qint64, qint64>>& blobs) {
+    blobs.clear();
+
+    // plain CBOR project
+    if(size < 16 || std::memcmp(file + size - 8, trailerMagic, 8) != 0) {
+        return size;
+    }
+
+    quint64 tableOffset;
+    std::memcpy(&tableOffset, file + size - 16, sizeof(tableOffset));
+    if(tableOffset > (quint64) size - 16) {
+        qWarning() << "read (StateSnapshot): state section is corrupted, ignoring it";
+        return size;
+    }
+
+    StateReader table(file + tableOffset, size - 16 - tableOffset);
+    char magic[8];
+    for(int i = 0; i < 8; i++) {
+        table.readValue(magic[i]);
+    }
+    quint32 fileVersion = 0;
+    quint32 fileByteOrderMark = 0;
+    quint64 cborSize = 0;
+    quint32 count = 0;
+    table.readValue(fileVersion);
+    table.readValue(fileByteOrderMark);
+    table.readValue(cborSize);
+    table.readValue(count);
+
+    if(!table.isValid() || std::memcmp(magic, tableMagic, 8) != 0 || cborSize > tableOffset) {
+        qWarning() << "read (StateSnapshot): state section is corrupted, ignoring it";
+        return size;
+    }
+
+    // the project data is still usable when the state can't be read, the generators are then initialized as usual
+    if(fileVersion != version || fileByteOrderMark != byteOrderMark) {
+        qWarning() << "read (StateSnapshot): state section was saved by another version or on another platform, ignoring it";
+        return cborSize;
+    }
+
+    for(quint32 i = 0; i < count; i++) {
+        qint32 id = 0;
+        quint32 reserved = 0;
+        quint64 offset = 0;
+        quint64 blobSize = 0;
+        table.readValue(id);
+        table.readValue(reserved);
+        table.readValue(offset);
+        table.readValue(blobSize);
+
+        if(!table.isValid() || offset < cborSize || offset + blobSize > tableOffset) {
+            qWarning() << "read (StateSnapshot): state section is corrupted, ignoring it";
+            blobs.clear();
+            return cborSize;
+        }
+
+        blobs.insert(id, QPair<qint64, qint64>(offset, blobSize));
+    }
+
+    return cborSize;
+}
@@ -0,0 +1,125 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QPair>
+#include <QtGlobal>
+#include <cstring>
+#include <type_traits>
+
+// binary simulation state of generators (neurons, synapses, cells...), saved after the CBOR data of a project file so that a project resumes
+// where it was saved instead of being initialized again.
+//
+// the state of each generator is a blob written by Generator::writeState through a StateWriter: plain values and arrays, stored in the byte
+// order of the machine. arrays start on a multiple of stateAlignment inside their blob, and blobs on a multiple of stateAlignment in the file,
+// so that a StateReader over a memory mapped file gives aligned pointers to them without copying anything.
+//
+// file layout:
+//   CBOR project data
+//   blob of each generator, padded
+//   table: magic, version, byte order mark, CBOR size, blob count, then { generator id, reserved, offset, size } for each blob
+//   trailer: table offset (quint64), magic
+//
+// files without the trailer are plain CBOR projects, as saved before snapshots existed.
+
+const int stateAlignment = 64;
+
+class StateWriter {
+public:
+    template<typename T>
+    void writeValue(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written");
+        data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // the number of elements, then the elements starting on the next multiple of stateAlignment
+    template<typename T>
+    void writeArray(const T* values, qint64 count) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written");
+        writeValue(count);
+        pad();
+        data.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    const QByteArray& getData() const { return data; }
+private:
+    void pad() {
+        data.append((stateAlignment - data.size() % stateAlignment) % stateAlignment, '\0');
+    }
+
+    QByteArray data;
+};
+
+// reads a blob written by StateWriter, in the same order. once a read goes past the end of the blob, every read fails and isValid returns false
+class StateReader {
+public:
+    StateReader(const uchar* data, qint64 size) : data(data), size(size) {}
+
+    template<typename T>
+    bool readValue(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read");
+        if(!valid || position + (qint64) sizeof(T) > size) {
+            valid = false;
+            return false;
+        }
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    // returns a pointer to the elements inside the blob, or nullptr if they don't hold expectedCount elements
+    template<typename T>
+    const T* readArray(qint64 expectedCount) {
+        qint64 count;
+        if(!readValue(count) || count != expectedCount) {
+            valid = false;
+            return nullptr;
+        }
+        position += (stateAlignment - position % stateAlignment) % stateAlignment;
+        if(position + count * (qint64) sizeof(T) > size) {
+            valid = false;
+            return nullptr;
+        }
+        const T* values = reinterpret_cast<const T*>(data + position);
+        position += count * sizeof(T);
+        return values;
+    }
+
+    bool isValid() const { return valid; }
+private:
+    const uchar* data;
+    qint64 size;
+    qint64 position = 0;
+    bool valid = true;
+};
+
+class StateSnapshot {
+public:
+    // appends the blobs of the generators (by generator id) to device, which holds cborSize bytes of CBOR data so far
+    static bool write(QIODevice& device, qint64 cborSize, const QList<QPair<int, QByteArray>>& blobs);
+
+    // looks for the state section at the end of a project file of the given size. returns the size of its CBOR data, which is the whole file
+    // if there is no state section or it can't be read. blobs receives the position and size of the blob of each generator id
+    static qint64 read(const uchar* file, qint64 size, QHash<int, QPair<qint64, qint64>>& blobs);
+private:
+    static constexpr quint32 version = 1;
+    static constexpr quint32 byteOrderMark = 0x01020304;
+};
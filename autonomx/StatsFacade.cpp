@@ -0,0 +1,40 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <QQmlEngine>
+
+#include "StatsFacade.h"
+
+StatsFacade::StatsFacade(QSharedPointer<ComputeEngine> computeEngine) : QQmlPropertyMap(this, nullptr)
+{
+    this->computeEngine = computeEngine;
+
+    // set ownership to C++
+    QQmlEngine::setObjectOwnership(this, QQmlEngine::CppOwnership);
+
+    // link signals
+    QObject::connect(computeEngine.data(), &ComputeEngine::statsUpdated, this, &StatsFacade::updateStats, Qt::QueuedConnection);
+    QObject::connect(this, &StatsFacade::resetStats, computeEngine.data(), &ComputeEngine::resetStats, Qt::QueuedConnection);
+}
+
+void StatsFacade::reset() {
+    emit resetStats();
+}
+
+void StatsFacade::updateStats(const QVariantMap &stats) {
+    for(QVariantMap::const_iterator it = stats.constBegin(); it != stats.constEnd(); it++) {
+        insert(it.key(), it.value());
+    }
+}
@@ -0,0 +1,41 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <QObject>
+#include <QQmlPropertyMap>
+#include <QSharedPointer>
+
+#include "ComputeEngine.h"
+
+// read-only QML view of the timings published by ComputeEngine::statsUpdated.
+// every top-level key of the stats map becomes a property, see ComputeEngine::statsUpdated for the layout
+class StatsFacade : public QQmlPropertyMap
+{
+    Q_OBJECT
+public:
+    StatsFacade(QSharedPointer<ComputeEngine> computeEngine);
+
+    // clears the histograms on computeThread
+    Q_INVOKABLE void reset();
+private:
+    QSharedPointer<ComputeEngine> computeEngine;
+public slots:
+    void updateStats(const QVariantMap &stats);
+signals:
+    // connects to ComputeEngine::resetStats
+    void resetStats();
+};
@@ -0,0 +1,74 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <QMutexLocker>
+
+#include "SynapseCache.h"
+
+bool SynapseCache::Key::operator==(const Key& other) const {
+    return networkType == other.networkType
+        && latticeWidth == other.latticeWidth
+        && latticeHeight == other.latticeHeight
+        && inhibitorySize == other.inhibitorySize
+        && seed == other.seed
+        && connectionsPerNeuron == other.connectionsPerNeuron
+        && gridNetworkConnectionRate == other.gridNetworkConnectionRate
+        && inhibitoryInitWeight == other.inhibitoryInitWeight
+        && excitatoryInitWeight == other.excitatoryInitWeight;
+}
+
+SynapseCache& SynapseCache::getInstance() {
+    static SynapseCache instance;
+    return instance;
+}
+
+bool SynapseCache::find(const Key& key, SynapseMatrix& synapses) {
+    QMutexLocker locker(&mutex);
+
+    for(auto it = entries.begin(); it != entries.end(); it++) {
+        if(it->key == key) {
+            // move to the front, it is now the most recently used
+            entries.splice(entries.begin(), entries, it);
+            synapses = entries.front().synapses;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SynapseCache::insert(const Key& key, const SynapseMatrix& synapses) {
+    // networks larger than the whole budget would only evict everything else
+    if(synapses.getSynapseCount() > synapseBudget) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    for(const Entry& entry : entries) {
+        if(entry.key == key) {
+            return;
+        }
+    }
+
+    entries.push_front({key, synapses});
+    synapseCount += synapses.getSynapseCount();
+
+    while(synapseCount > synapseBudget) {
+        synapseCount -= entries.back().synapses.getSynapseCount();
+        entries.pop_back();
+    }
+}
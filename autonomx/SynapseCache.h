@@ -0,0 +1,68 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+#include <list>
+
+#include "SynapseMatrix.h"
+
+// networks built by SpikingNet, kept so that reinitializing a generator with a topology that was already built doesn't rebuild it.
+// this happens whenever a parameter is toggled back and forth, or a project is reloaded.
+//
+// a network is identified by everything its builder reads, including the seed of the random generator. only generators with an
+// explicit seed produce the same network twice, so they are the only ones worth caching.
+//
+// entries are evicted in least recently used order once the synapses they hold go over synapseBudget. the cache is shared by every
+// generator, which can be initialized from different threads.
+class SynapseCache {
+public:
+    struct Key {
+        int networkType;
+        int latticeWidth;
+        int latticeHeight;
+        int inhibitorySize;
+        quint32 seed;
+        int connectionsPerNeuron;
+        double gridNetworkConnectionRate;
+        double inhibitoryInitWeight;
+        double excitatoryInitWeight;
+
+        bool operator==(const Key& other) const;
+    };
+
+    static SynapseCache& getInstance();
+
+    // copies the network stored for key into synapses and returns true, or returns false if there is none
+    bool find(const Key& key, SynapseMatrix& synapses);
+    // stores a copy of a freshly built network
+    void insert(const Key& key, const SynapseMatrix& synapses);
+private:
+    struct Entry {
+        Key key;
+        SynapseMatrix synapses;
+    };
+
+    SynapseCache() = default;
+
+    static constexpr qint64 synapseBudget = 1 << 22;
+
+    QMutex mutex;
+    std::list<Entry> entries;       // most recently used first
+    qint64 synapseCount = 0;        // synapses held by all entries
+};
@@ -0,0 +1,252 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "SynapseMatrix.h"
+
+void SynapseMatrix::clear(int neuronCount) {
+    this->neuronCount = neuronCount;
+
+    rowOffsets.assign(neuronCount + 1, 0);
+    destinations.clear();
+    weights.clear();
+    columnOffsets.assign(neuronCount + 1, 0);
+    columnSources.clear();
+    columnSynapses.clear();
+    pending.clear();
+    tags.clear();
+
+    epochScale = 1.0;
+    previousEpochScale = 1.0;
+    epoch = 0;
+    updateScales();
+
+    // release the memory of a previous, possibly much larger network
+    destinations.shrink_to_fit();
+    weights.shrink_to_fit();
+    columnSources.shrink_to_fit();
+    columnSynapses.shrink_to_fit();
+    pending.shrink_to_fit();
+    tags.shrink_to_fit();
+}
+
+void SynapseMatrix::add(int source, int destination, double weight) {
+    pending.push_back({source, destination, weight});
+}
+
+void SynapseMatrix::build() {
+    int synapseCount = (int) pending.size();
+
+    // two stable counting sorts, by destination then by source, leave the synapses sorted by source and then by destination
+    std::vector<PendingSynapse> byDestination(synapseCount);
+    std::vector<int> counts(neuronCount + 1, 0);
+    for(const PendingSynapse& synapse : pending) {
+        counts[synapse.destination + 1]++;
+    }
+    for(int i = 0; i < neuronCount; i++) {
+        counts[i + 1] += counts[i];
+    }
+    for(const PendingSynapse& synapse : pending) {
+        byDestination[counts[synapse.destination]++] = synapse;
+    }
+
+    for(const PendingSynapse& synapse : byDestination) {
+        rowOffsets[synapse.source + 1]++;
+    }
+    for(int i = 0; i < neuronCount; i++) {
+        rowOffsets[i + 1] += rowOffsets[i];
+    }
+
+    destinations.resize(synapseCount);
+    weights.resize(synapseCount);
+    std::vector<int> next(rowOffsets.begin(), rowOffsets.end() - 1);
+    for(const PendingSynapse& synapse : byDestination) {
+        int index = next[synapse.source]++;
+        destinations[index] = synapse.destination;
+        weights[index] = synapse.weight;
+    }
+
+    pending.clear();
+    pending.shrink_to_fit();
+
+    tags.assign(synapseCount, 0);
+    renormalizeCursor = synapseCount;
+
+    // transposed index. going through the rows in order leaves every column sorted by source
+    for(int i = 0; i < synapseCount; i++) {
+        columnOffsets[destinations[i] + 1]++;
+    }
+    for(int i = 0; i < neuronCount; i++) {
+        columnOffsets[i + 1] += columnOffsets[i];
+    }
+
+    columnSources.resize(synapseCount);
+    columnSynapses.resize(synapseCount);
+    next.assign(columnOffsets.begin(), columnOffsets.end() - 1);
+    for(int source = 0; source < neuronCount; source++) {
+        for(int synapse = rowOffsets[source]; synapse < rowOffsets[source + 1]; synapse++) {
+            int entry = next[destinations[synapse]]++;
+            columnSources[entry] = source;
+            columnSynapses[entry] = synapse;
+        }
+    }
+}
+
+int SynapseMatrix::find(int source, int destination) const {
+    std::vector<int>::const_iterator begin = destinations.begin() + rowOffsets[source];
+    std::vector<int>::const_iterator end = destinations.begin() + rowOffsets[source + 1];
+    std::vector<int>::const_iterator it = std::lower_bound(begin, end, destination);
+    if(it == end || *it != destination) {
+        return -1;
+    }
+    return (int) (it - destinations.begin());
+}
+
+void SynapseMatrix::writeWeight(int synapse, double weight) {
+    if(tags[synapse] == 0) {
+        weights[synapse] = weight;
+    } else {
+        // store it relative to the current epoch
+        tags[synapse] = getEpochTag();
+        weights[synapse] = weight / epochScale;
+    }
+}
+
+void SynapseMatrix::setScaled(int synapse, bool scaled) {
+    double weight = getWeight(synapse);
+    tags[synapse] = scaled ? getEpochTag() : 0;
+    writeWeight(synapse, weight);
+}
+
+void SynapseMatrix::scale(double factor) {
+    epochScale *= factor;
+
+    if(epochScale < epochEndScale) {
+        // the previous epoch must be gone before its tag can be reused. this only blocks if the scale falls very fast
+        renormalize(getSynapseCount());
+
+        previousEpochScale = epochScale;
+        epochScale = 1.0;
+        epoch++;
+        renormalizeCursor = 0;
+    } else {
+        // spread the renormalization so that the whole matrix is done in 64 calls
+        renormalize(getSynapseCount() / 64 + 1);
+    }
+
+    updateScales();
+}
+
+void SynapseMatrix::updateScales() {
+    scales[0] = 1.0;
+    scales[getEpochTag()] = epochScale;
+    scales[3 - getEpochTag()] = previousEpochScale * epochScale;
+}
+
+void SynapseMatrix::renormalize(int count) {
+    int end = std::min(getSynapseCount(), renormalizeCursor + count);
+    unsigned char previousTag = 3 - getEpochTag();
+    for(int synapse = renormalizeCursor; synapse < end; synapse++) {
+        if(tags[synapse] == previousTag) {
+            weights[synapse] *= previousEpochScale;
+            tags[synapse] = getEpochTag();
+        }
+    }
+    renormalizeCursor = end;
+}
+
+void SynapseMatrix::writeState(StateWriter& writer) const {
+    writer.writeValue(neuronCount);
+    writer.writeValue(getSynapseCount());
+    writer.writeArray(rowOffsets.data(), rowOffsets.size());
+    writer.writeArray(destinations.data(), destinations.size());
+    writer.writeArray(weights.data(), weights.size());
+    writer.writeArray(columnOffsets.data(), columnOffsets.size());
+    writer.writeArray(columnSources.data(), columnSources.size());
+    writer.writeArray(columnSynapses.data(), columnSynapses.size());
+    writer.writeArray(tags.data(), tags.size());
+    for(int i = 0; i < 3; i++) {
+        writer.writeValue(scales[i]);
+    }
+    writer.writeValue(epochScale);
+    writer.writeValue(previousEpochScale);
+    writer.writeValue(epoch);
+    writer.writeValue(renormalizeCursor);
+}
+
+// copies count values saved by writeState into values, or returns false
+template<typename T>
+static bool readStateArray(StateReader& reader, std::vector<T>& values, qint64 count) {
+    const T* saved = reader.readArray<T>(count);
+    if(saved == nullptr) {
+        return false;
+    }
+    values.assign(saved, saved + count);
+    return true;
+}
+
+// offsets must start at 0, end at size and never decrease
+static bool checkOffsets(const std::vector<int>& offsets, int size) {
+    if(offsets.front() != 0 || offsets.back() != size) {
+        return false;
+    }
+    for(size_t i = 1; i < offsets.size(); i++) {
+        if(offsets[i] < offsets[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// every value must be in [0, end)
+template<typename T>
+static bool checkRange(const std::vector<T>& values, int end) {
+    for(T value : values) {
+        int index = value;
+        if(index < 0 || index >= end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SynapseMatrix::readState(StateReader& reader) {
+    int synapseCount;
+    if(!reader.readValue(neuronCount) || neuronCount < 0 || !reader.readValue(synapseCount) || synapseCount < 0) {
+        return false;
+    }
+
+    if(!readStateArray(reader, rowOffsets, neuronCount + 1) || !readStateArray(reader, destinations, synapseCount) ||
+       !readStateArray(reader, weights, synapseCount) || !readStateArray(reader, columnOffsets, neuronCount + 1) ||
+       !readStateArray(reader, columnSources, synapseCount) || !readStateArray(reader, columnSynapses, synapseCount) ||
+       !readStateArray(reader, tags, synapseCount)) {
+        return false;
+    }
+    for(int i = 0; i < 3; i++) {
+        reader.readValue(scales[i]);
+    }
+    reader.readValue(epochScale);
+    reader.readValue(previousEpochScale);
+    reader.readValue(epoch);
+    reader.readValue(renormalizeCursor);
+    pending.clear();
+
+    // the traversals don't check indices, so a damaged file must not get through
+    return reader.isValid() && checkOffsets(rowOffsets, synapseCount) && checkOffsets(columnOffsets, synapseCount) &&
+           checkRange(destinations, neuronCount) && checkRange(columnSources, neuronCount) && checkRange(columnSynapses, synapseCount) &&
+           checkRange(tags, 3) && renormalizeCursor >= 0 && renormalizeCursor <= synapseCount;
+}
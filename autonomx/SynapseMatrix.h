@@ -0,0 +1,115 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+
+#include "StateSnapshot.h"
+
+// synapses of a SpikingNet, stored in compressed sparse row (CSR) form so that memory and traversal cost scale with the number of synapses
+// instead of the square of the number of neurons.
+//
+// synapses are indexed by their position in the row arrays: the outgoing synapses of a source neuron are [getRowBegin(source), getRowEnd(source)),
+// sorted by destination. a transposed index gives the incoming synapses of a destination neuron, sorted by source, as positions in that same
+// storage, so that weights are only stored once and can be updated from either side.
+//
+// the matrix is filled by calling clear, add for every synapse, then build. it isn't usable between clear and build.
+//
+// synapses marked with setScaled can be multiplied all at once by scale, in constant time. their stored value is relative to the global scale
+// of an epoch, and getWeight multiplies it by that scale. when the global scale gets small, a new epoch starts at scale 1 and the synapses
+// still stored relative to the previous one are renormalized a few at a time on the following calls to scale, so only two epochs are ever live.
+class SynapseMatrix {
+public:
+    // discards every synapse and starts a new neuronCount x neuronCount matrix
+    void clear(int neuronCount);
+
+    // adds the synapse source -> destination. synapses can be added in any order, but every pair must only be added once
+    void add(int source, int destination, double weight);
+
+    // sorts the synapses added since clear into the row arrays and builds the transposed index. this is O(neurons + synapses)
+    void build();
+
+    int getNeuronCount() const { return neuronCount; }
+    int getSynapseCount() const { return (int) destinations.size(); }
+
+    // outgoing synapses of source
+    int getRowBegin(int source) const { return rowOffsets[source]; }
+    int getRowEnd(int source) const { return rowOffsets[source + 1]; }
+    int getDestination(int synapse) const { return destinations[synapse]; }
+
+    // incoming synapses of destination. entries are in [getColumnBegin(destination), getColumnEnd(destination)), and getColumnSynapse gives the
+    // index of the synapse for an entry
+    int getColumnBegin(int destination) const { return columnOffsets[destination]; }
+    int getColumnEnd(int destination) const { return columnOffsets[destination + 1]; }
+    int getColumnSource(int entry) const { return columnSources[entry]; }
+    int getColumnSynapse(int entry) const { return columnSynapses[entry]; }
+
+    // effective weight of a synapse, including the global scale
+    double getWeight(int synapse) const { return weights[synapse] * scales[tags[synapse]]; }
+    void writeWeight(int synapse, double weight);
+
+    // whether the synapse is affected by scale. this can be called once build is done, every synapse starts unscaled
+    void setScaled(int synapse, bool scaled);
+
+    // multiplies the effective weight of every scaled synapse by factor, which must be in (0, 1]
+    void scale(double factor);
+
+    // index of the synapse source -> destination, or -1 if there is none. this is a binary search over the row of source
+    int find(int source, int destination) const;
+
+    // the built matrix and its global scale, see Generator::writeState. readState checks that the indices are consistent,
+    // and leaves the matrix in an unspecified state if they aren't
+    void writeState(StateWriter& writer) const;
+    bool readState(StateReader& reader);
+private:
+    struct PendingSynapse {
+        int source;
+        int destination;
+        double weight;
+    };
+
+    int neuronCount = 0;
+
+    // row arrays
+    std::vector<int> rowOffsets;        // neuronCount + 1 entries
+    std::vector<int> destinations;
+    std::vector<double> weights;
+
+    // transposed index
+    std::vector<int> columnOffsets;     // neuronCount + 1 entries
+    std::vector<int> columnSources;
+    std::vector<int> columnSynapses;
+
+    // synapses added since clear, sorted by build
+    std::vector<PendingSynapse> pending;
+
+    // global scale. tags[s] is 0 for unscaled synapses, or 1 + the parity of the epoch the stored weight is relative to.
+    // scales[tag] is the factor between the stored and effective weights for each tag
+    std::vector<unsigned char> tags;
+    double scales[3] = {1.0, 1.0, 1.0};
+    double epochScale = 1.0;            // scale accumulated since the start of the current epoch
+    double previousEpochScale = 1.0;    // scale accumulated over the whole previous epoch
+    unsigned int epoch = 0;
+    int renormalizeCursor = 0;          // synapses before this one are all relative to the current epoch
+
+    static constexpr double epochEndScale = 1.0 / 4294967296.0;   // a new epoch starts once epochScale goes below this
+
+    int getEpochTag() const { return 1 + (epoch & 1); }
+    void updateScales();
+    // brings up to count synapses of the previous epoch into the current one
+    void renormalize(int count);
+};
@@ -19,8 +19,10 @@
 #include <QDebug>
 #include <time.h>
 #include <random>
+#include <algorithm>
 
 #include "WolframCA.h"
+#include "BitRow.h"
 
 WolframCA::WolframCA(int id, GeneratorMeta * meta) : Generator(id, meta){
     if(flagDebug) {
@@ -48,33 +50,42 @@ if(flagDebug) {
    qDebug() << "initialize:\t\t\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
 }
 
-// resize cells vector for current lattice size
-cells.resize(latticeHeight * latticeWidth);
+// the rule space and the layout of the rows follow the properties from here on
+states = requestedStates;
+radius = requestedRadius;
 
-// reset all cells to 0 / black
-for(int i = 0; i < (latticeHeight * latticeWidth); i++) {
- cells[i] = 0;
-}
+// the random starting seed is drawn from the generator's seed so that runs can be reproduced
+seedRandomGenerator();
+std::uniform_real_distribution<> randomUniform(0.0, 1.0);
 
-// a var to store a random number
-double magic;
+// resize rows for current lattice size, all cells 0 / black. elementary rules use bit-packed rows, the others a byte per cell
+bool elementary = isElementary();
+wordsPerRow = (latticeWidth + 63) / 64;
+rows.assign(elementary ? latticeHeight * wordsPerRow : 0, 0);
+nextRow.assign(elementary ? wordsPerRow : 0, 0);
+stateRows.assign(elementary ? 0 : latticeHeight * latticeWidth, 0);
+nextStateRow.assign(elementary ? 0 : latticeWidth, 0);
+scrollOffset = 0;
+filledRows = 1;
 
 if (!flag_randSeed) {
-   cells[latticeWidth / 2] = 1;    // middle cell on first line is starting seed
+   // middle cell on first line is starting seed
+   if (elementary)
+       rows[(latticeWidth / 2) / 64] |= (quint64) 1 << ((latticeWidth / 2) % 64);
+   else
+       stateRows[latticeWidth / 2] = 1;
 }
 // if random starting seed is selected by user
 else {
-       for(int i = 0; i < (latticeHeight * latticeWidth); i++) {  //initialize a random cell as starting cell
-       //    for(int i = 0; i < latticeWidth; i++) {  // initialize a random cell as starting cell
-           if (i >= latticeWidth)
-               cells[i] = 0;
-           else {
-               magic = (float) rand() / RAND_MAX;  // generate a random number magic b/w 0-1 and initialize to 1 if magic>0.5 o/w magic -> 0
+       for(int x = 0; x < latticeWidth; x++) {  // initialize a random cell as starting cell
+           // generate a random number magic b/w 0-1 and pick the state of the cell from it, 1 if magic>0.5 o/w 0 with 2 states
+           double magic = randomUniform(randomGenerator);
+           if (elementary) {
                if (magic > 0.5)
-                   cells[i] = 1;
-               else
-                  cells[i] = 0;
+                   rows[x / 64] |= (quint64) 1 << (x % 64);
            }
+           else
+               stateRows[x] = std::min(states - 1, (int)(magic * states));
        }
 }
 
@@ -94,142 +105,214 @@ else {
    }*/
 
 
-   lastGeneration = latticeHeight;
-   currentGeneration = 0;
    iterationNumber = 1;
 
    //generate the rule set array based on the defined rule
-   int r = getRule();
-   generate(r);
+   generate();
 }
 
 void WolframCA::computeIteration(double deltaTime) {
-    //set ruleset using the determined rule after checking if the rule has changed by the user
-    int r = getRule();
-    if (iterationNumber >= 1 && (prev_rule!=rule)) {
-        generate(r);
-    }
-
     //check if randomness radio button is selected or not
     if(getFlagRandSeed())
         flag_randSeed=true;
     else
         flag_randSeed=false;
 
-    // every 1000 iterations, currentGeneration increments and iterationNumber resets
-    if(iterationNumber % (100 - (int)(timeScale) + 1) == 0) {
-        currentGeneration++;
-        iterationNumber = 1;
+    // every iteration is a new generation, the speed set by timeScale is handled by getTickRate.
+    // it goes to the next row until the lattice is full, then replaces the oldest row, which scrolls the lattice
+    int target = filledRows < latticeHeight ? filledRows : scrollOffset;
+    if(isElementary()) {
+        computeRow(&rows[getNewestRow() * wordsPerRow], nextRow.data());
+        std::copy(nextRow.begin(), nextRow.end(), rows.begin() + target * wordsPerRow);
+    } else {
+        wolframRule.step(&stateRows[getNewestRow() * latticeWidth], nextStateRow.data(), latticeWidth, paddedStateRow);
+        std::copy(nextStateRow.begin(), nextStateRow.end(), stateRows.begin() + target * latticeWidth);
+    }
+    if(filledRows < latticeHeight) {
+        filledRows++;
+    } else {
+        scrollOffset = (scrollOffset + 1) % latticeHeight;
     }
 
-    // if last generation has been passed, currentGeneration resets so lattice can begin writing from top
-    if(currentGeneration == lastGeneration) {
-        currentGeneration = 1;
-
-        //continuing the lattice from the top as the cells have fallen to the bottom
-        for(int i = 0; i < (latticeHeight * latticeWidth); i++) {
-            if (i == 0){
-                // to restart the cells from the top but with a continuing pattern from below; hence intializing the topmost layer once again
-                for (int j = 1 ; j < latticeWidth - 1; j++){
-                    cells[j] = cells[(latticeHeight) * (latticeHeight - 1) + j];
-                }
+    // every iteration, iterationNumber increments
+    iterationNumber++;
+}
+
+void WolframCA::computeRow(const quint64* row, quint64* next) const {
+    // the left and right neighbours of the 64 cells of each word as bit masks, taking the edge bit of the adjacent words.
+    // the row wraps around, so the cells past its edges are those of the opposite edge
+    int lastBit = (latticeWidth - 1) % 64;
+    quint64 lastWordMask = latticeWidth % 64 == 0 ? ~(quint64) 0 : ((quint64) 1 << (latticeWidth % 64)) - 1;
+    quint64 edgeLeft = (row[wordsPerRow - 1] >> lastBit) & 1;
+    quint64 edgeRight = (row[0] & 1) << lastBit;
+
+    for(int w = 0; w < wordsPerRow; w++) {
+        quint64 left = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : edgeLeft);
+        quint64 center = row[w];
+        quint64 right = (row[w] >> 1) | (w < wordsPerRow - 1 ? row[w + 1] << 63 : edgeRight);
+
+        // a cell is alive if its neighbourhood is one of those the rule maps to 1
+        quint64 alive = 0;
+        for(int neighbourhood = 0; neighbourhood < 8; neighbourhood++) {
+            if(ruleset[neighbourhood]) {
+                alive |= (neighbourhood & 4 ? left : ~left) & (neighbourhood & 2 ? center : ~center) & (neighbourhood & 1 ? right : ~right);
             }
-            if (i > latticeWidth)
-                cells[i] = 0;
         }
+        next[w] = alive;
     }
+    next[wordsPerRow - 1] &= lastWordMask;
+}
 
-    //write the main logic here to get values of next generation -- remmeber the current generation starts from 1 hence current generation -1
-if(currentGeneration>0){
-    for(int i = 0 ; i < latticeWidth; i++) {
-        // to check for the leftmost cell
-        if (i == 0){
-            int left = cells[(currentGeneration - 1) * latticeWidth + latticeWidth - 1];
-            int right = cells[(currentGeneration - 1) * latticeWidth + i + 1];
-            int middle = cells[(currentGeneration - 1) * latticeWidth + i];
-            cells[(currentGeneration) * latticeWidth + i] = findCellValue(left,middle,right);
-        }
-        // to check for the rightmost cell
-        else if (i == latticeWidth - 1){
-            int left = cells[(currentGeneration - 1) * latticeWidth + i - 1];
-            int right = cells[(currentGeneration - 1) * latticeWidth + i - (latticeWidth - 1)];
-            int middle = cells[(currentGeneration - 1) * latticeWidth + i];
-            cells[(currentGeneration) * latticeWidth + i] = findCellValue(left,middle,right);
-        }
-        //any other cell on the lattice
-        else{
-             int left = cells[(currentGeneration - 1) * latticeWidth + i - 1];
-             int right = cells[(currentGeneration - 1) * latticeWidth + i + 1];
-             int middle = cells[(currentGeneration - 1) * latticeWidth + i];
-             cells[(currentGeneration) * latticeWidth + i] = findCellValue(left,middle,right);
-        }
-    }
+int WolframCA::getRowIndex(int y) const {
+    return (scrollOffset + y) % latticeHeight;
 }
-    //store the rule to check next time if the rule has changed
-    prev_rule = rule;
 
-    // every iteration, iterationNumber increments
-    iterationNumber++;
+int WolframCA::getNewestRow() const {
+    return getRowIndex(filledRows - 1);
 }
 
+double WolframCA::getTickRate() const {
+    // timeScale 100 computes a generation on every frame of the default rate, lower values slow down linearly in frame count
+    return tickRate / (100 - (int)(timeScale) + 1);
+}
 
-int WolframCA::findCellValue(int a, int b, int c) {
-    if (a == 1 && b == 1 && c == 1) {
-        return ruleset[7];
-    }
-    if (a == 1 && b == 1 && c == 0) {
-        return ruleset[6];
-    }
-    if (a == 1 && b == 0 && c == 1) {
-        return ruleset[5];
+void WolframCA::generate() {
+    bool truncated;
+    if(!wolframRule.compile(rule, states, radius, totalistic, truncated)) {
+        qWarning() << "WolframCA: a rule with" << states << "states and radius" << radius << "has too many neighbourhoods, use a totalistic rule";
+        std::fill(ruleset, ruleset + 8, 0);
+        return;
     }
-    if (a == 1 && b == 0 && c == 0) {
-        return ruleset[4];
+    if(truncated) {
+        qWarning() << "WolframCA: rule" << rule << "is larger than the codes of rules with" << states << "states and radius" << radius << ", its leading digits are ignored";
     }
-    if (a == 0 && b == 1 && c == 1) {
-        return ruleset[3];
+
+    // elementary rules run on bit masks, from the next state of each of the 8 neighbourhoods
+    if(isElementary()) {
+        const std::vector<quint8>& table = wolframRule.table;
+        for(int i = 0; i < 8; i++) {
+            ruleset[i] = totalistic ? table[((i >> 2) & 1) + ((i >> 1) & 1) + (i & 1)] : table[i];
+        }
     }
-    if (a == 0 && b == 1 && c == 0) {
-        return ruleset[2];
+}
+
+void WolframCA::compileRule() {
+    if(QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this]() {
+            compileRule();
+        }, Qt::QueuedConnection);
+        return;
     }
-    if (a == 0 && b == 0 && c == 1) {
-        return ruleset[1];
+
+    generate();
+}
+
+void WolframCA::readLatticeRow(int x, int y, int count, float* values) {
+    if(isElementary()) {
+        readBits(&rows[getRowIndex(y) * wordsPerRow], x, count, values);
+    } else {
+        const quint8* row = &stateRows[getRowIndex(y) * latticeWidth];
+        float scale = 1.0f / (states - 1);
+        for(int i = 0; i < count; i++) {
+            values[i] = row[x + i] * scale;
+        }
     }
-    // else (a == 0 && b == 0 && c == 0) {
-        return ruleset[0];
-    // }
 }
 
-void WolframCA::generate(int r){
+void WolframCA::fillLatticeRow(int x, int y, int count, double value) {
+    // write values to lattice. values are mapped to the nearest state, so with 2 states inputs above one half set a cell
+    int state = qRound(std::max(0.0, std::min(value, 1.0)) * (states - 1));
+    if(!isElementary()) {
+        std::fill_n(&stateRows[getRowIndex(y) * latticeWidth + x], count, state);
+        return;
+    }
 
-    //Grabs the binary value from the int and inserts into array
-       for (int i = sizeof(r) * CHAR_BIT; i--; )
-       {
-           if (i < 8) {
-               char temp = ('0' + ((r >> i) & 1));
-               int x = temp - '0';
-               ruleset[i] = x;
-           }
-       }
+    fillBits(&rows[getRowIndex(y) * wordsPerRow], x, count, state == 1);
 }
 
-double WolframCA::getLatticeValue(int x, int y) {
-    int index = x % latticeWidth + y * latticeWidth;
-    return cells[index];
+void WolframCA::writeState(StateWriter& writer)
+{
+    writer.writeValue(stateVersion);
+    writer.writeValue(latticeWidth);
+    writer.writeValue(latticeHeight);
+    writer.writeValue(states);
+    writer.writeValue(radius);
+    writer.writeValue(iterationNumber);
+    writer.writeValue(scrollOffset);
+    writer.writeValue(filledRows);
+    if(isElementary()) {
+        writer.writeArray(rows.data(), rows.size());
+    } else {
+        writer.writeArray(stateRows.data(), stateRows.size());
+    }
 }
 
-void WolframCA::writeLatticeValue(int x, int y, double value) {
-    // write values to lattice
-    int index = x % latticeWidth + y * latticeWidth;
-    cells[index] = value;
+bool WolframCA::readState(StateReader& reader)
+{
+    quint32 version;
+    int width;
+    int height;
+    int states;
+    int radius;
+    int iterationNumber;
+    int scrollOffset;
+    int filledRows;
+    if(!reader.readValue(version) || version != stateVersion || !reader.readValue(width) || !reader.readValue(height) ||
+       !reader.readValue(states) || !reader.readValue(radius) || !reader.readValue(iterationNumber) || !reader.readValue(scrollOffset) ||
+       !reader.readValue(filledRows)) {
+        return false;
+    }
+    // the lattice scrolls only once it is full. the layout of the cells follows from states and radius
+    if(width != requestedLatticeWidth || height != requestedLatticeHeight || states != requestedStates || radius != requestedRadius ||
+       filledRows < 1 || filledRows > height || scrollOffset < 0 || scrollOffset >= height || (scrollOffset != 0 && filledRows != height)) {
+        return false;
+    }
+    int savedWordsPerRow = (width + 63) / 64;
+    const quint64* savedRows = nullptr;
+    const quint8* savedStateRows = nullptr;
+    if(states == 2 && radius == 1) {
+        savedRows = reader.readArray<quint64>((qint64) savedWordsPerRow * height);
+        if(savedRows == nullptr) {
+            return false;
+        }
+    } else {
+        savedStateRows = reader.readArray<quint8>((qint64) width * height);
+        if(savedStateRows == nullptr || std::any_of(savedStateRows, savedStateRows + width * height, [states](quint8 state) { return state >= states; })) {
+            return false;
+        }
+    }
+
+    latticeWidth = width;
+    latticeHeight = height;
+    this->states = states;
+    this->radius = radius;
+    wordsPerRow = savedWordsPerRow;
+    if(savedRows != nullptr) {
+        rows.assign(savedRows, savedRows + wordsPerRow * height);
+        nextRow.assign(wordsPerRow, 0);
+        stateRows.clear();
+        nextStateRow.clear();
+    } else {
+        rows.clear();
+        nextRow.clear();
+        stateRows.assign(savedStateRows, savedStateRows + width * height);
+        nextStateRow.assign(width, 0);
+    }
+    this->iterationNumber = iterationNumber;
+    this->scrollOffset = scrollOffset;
+    this->filledRows = filledRows;
+    // the rule table is compiled for the rule space of the saved rows
+    generate();
+
+    return true;
 }
 
-int WolframCA::getRule() {
+QString WolframCA::getRule() const {
     //qDebug() <<"New Rule is"<< rule;
     return rule;
 }
 
-void WolframCA::writeRule(int rule) {
+void WolframCA::writeRule(QString rule) {
     if(this->rule == rule)
         return;
 
@@ -240,12 +323,70 @@ void WolframCA::writeRule(int rule) {
 
         qDebug() << "Rule:\tt = " << now.count() << "\tid = " << QThread::currentThreadId();
     }
+
+    // rules that aren't decimal numbers keep the current one, and the facade is brought back to it
+    std::vector<quint8> digits;
+    bool truncated;
+    if(!WolframRule::toDigits(rule, 10, 0, digits, truncated)) {
+        qWarning() << "WolframCA: invalid rule" << rule << "ignored";
+        emit valueChanged("rule", this->rule);
+        return;
+    }
+
     this->rule = rule;
+    // the next generation follows the new rule
+    compileRule();
     // make sure you follow this signal structure when you write a property!
     emit ruleChanged(rule);
     emit valueChanged("rule", rule);
 }
 
+int WolframCA::getStates() const {
+    return requestedStates;
+}
+
+void WolframCA::writeStates(int states) {
+    // cells are stored in a byte
+    states = std::max(2, std::min(states, 256));
+    if(requestedStates == states)
+        return;
+
+    requestedStates = states;
+    // the same code is a different rule, and cells may need another layout
+    reinitialize();
+    emit statesChanged(states);
+    emit valueChanged("states", states);
+}
+
+int WolframCA::getRadius() const {
+    return requestedRadius;
+}
+
+void WolframCA::writeRadius(int radius) {
+    radius = std::max(1, std::min(radius, 64));
+    if(requestedRadius == radius)
+        return;
+
+    requestedRadius = radius;
+    reinitialize();
+    emit radiusChanged(radius);
+    emit valueChanged("radius", radius);
+}
+
+bool WolframCA::getTotalistic() const {
+    return totalistic;
+}
+
+void WolframCA::writeTotalistic(bool totalistic) {
+    if(this->totalistic == totalistic)
+        return;
+
+    this->totalistic = totalistic;
+    compileRule();
+    emit totalisticChanged(totalistic);
+    emit valueChanged("totalistic", totalistic);
+}
+
 /*double WolframCA::getRandSeed() const {
     return this->randSeed;
     qDebug()<<randSeed;
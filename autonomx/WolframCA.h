@@ -18,13 +18,17 @@
 #include <vector>
 #include<random>
 #include "Generator.h"
+#include "WolframRule.h"
 
 
 class WolframCA : public Generator
 {
     Q_OBJECT
 
-    Q_PROPERTY(int rule READ getRule WRITE writeRule NOTIFY ruleChanged)
+    Q_PROPERTY(QString rule READ getRule WRITE writeRule NOTIFY ruleChanged)
+    Q_PROPERTY(int states READ getStates WRITE writeStates NOTIFY statesChanged)
+    Q_PROPERTY(int radius READ getRadius WRITE writeRadius NOTIFY radiusChanged)
+    Q_PROPERTY(bool totalistic READ getTotalistic WRITE writeTotalistic NOTIFY totalisticChanged)
     //Q_PROPERTY(double randSeed READ getRandSeed WRITE writeRandSeed NOTIFY randSeedChanged)
     Q_PROPERTY(bool flag_randSeed READ getFlagRandSeed WRITE writeFlagRandSeed NOTIFY flagRandSeedChanged)
 
@@ -33,35 +37,58 @@ private:
     // Debugging
     bool  flagDebug = false;
 
-    // cells of lattice
-    std::vector<double> cells;
-
-    // Binary conversion of decimal user input in future starting by rule 90
-    int ruleset[8];// = {0,1,0,1,1,0,1,0};// {1,1,0,1,1,1,1,0};
-
-    // cell values
-    double* cellValues;
-
-    // properties and rules; default rule set to 90
-    int rule = 90;
+    // generations, one per row of the lattice, bit-packed: each row is wordsPerRow words, and bit i of word w is the cell at x = 64 * w + i.
+    // bits past latticeWidth are always 0. rows are a circular buffer: the lattice shows them from scrollOffset on, so once it is full a new
+    // generation replaces the oldest one and the lattice scrolls up by a row, without moving the others
+    std::vector<quint64> rows;
+    std::vector<quint64> nextRow;
+    int wordsPerRow = 0;
+    int scrollOffset = 0;
+    // rows holding a generation, from the top of the lattice until it is full
+    int filledRows = 0;
+
+    // rules other than elementary ones (2 states, radius 1) have cells of one byte, holding states 0 to states - 1, in rows of latticeWidth
+    // bytes, in the same circular buffer. a row is computed from a copy padded by radius cells on each side, taken from the opposite edge
+    std::vector<quint8> stateRows;
+    std::vector<quint8> nextStateRow;
+    std::vector<quint8> paddedStateRow;
+
+    // Binary conversion of decimal user input: ruleset[4 * left + 2 * center + right] is the next state of a cell, for elementary rules
+    int ruleset[8];
+
+    // compiled rule, for the cells of one byte
+    WolframRule wolframRule;
+
+    // properties and rules; default rule set to 90. rule is a Wolfram code in decimal: its digit n in base states is the next state of the
+    // neighbourhoods of index n. it is kept as text, since the codes of larger rule spaces don't fit in any integer
+    QString rule = "90";
+    int states = 2;
+    int radius = 1;
+    bool totalistic = false;
+    // states and radius written to the properties. they change the layout of the rows, so they only replace states and radius
+    // when the reinitialization runs on the thread of the generator
+    int requestedStates = 2;
+    int requestedRadius = 1;
 
     //random seed property
     double randSeed = false;
     bool flag_randSeed = false;
 
-    //random generator to initialize cells
-    std::mt19937 randomGenerator;
-
     // global iteration counter
     int iterationNumber;
 
-    //to store the previous rule
-    int prev_rule;
+    // layout of writeState, increased whenever it changes
+    static constexpr quint32 stateVersion = 3;
 
-    // WolframCA specific variables
-    int currentGeneration = 0;
-    int lastGeneration;
+    // circular buffer index of the row shown at y on the lattice, and of the newest generation
+    int getRowIndex(int y) const;
+    int getNewestRow() const;
+    // computes the generation following row into next, for elementary rules
+    void computeRow(const quint64* row, quint64* next) const;
+    bool isElementary() const { return states == 2 && radius == 1; }
 
+    // generate on the thread of the generator, where the rule table is read. property writes from readJson come from the main thread
+    void compileRule();
 
 public:
 
@@ -70,16 +97,25 @@ public:
 
     // overrides / implementing necessary virtual functions from Generator class
     void computeIteration(double deltaTime) override;
+    double getTickRate() const override;
     void initialize() override;
-    double getLatticeValue(int x, int y) override;
-    void writeLatticeValue(int x, int y, double value) override;
+    void readLatticeRow(int x, int y, int count, float* values) override;
+    void fillLatticeRow(int x, int y, int count, double value) override;
+    void writeState(StateWriter& writer) override;
+    bool readState(StateReader& reader) override;
     double sigmoid(double value);
-    void generate(int r);
-    int findCellValue(int left,int middle, int right);
+    // compiles rule into wolframRule and ruleset for the current states, radius and totalistic
+    void generate();
 
     // accessors / mutators
-    int getRule();
-    void writeRule(int rule);
+    QString getRule() const;
+    void writeRule(QString rule);
+    int getStates() const;
+    void writeStates(int states);
+    int getRadius() const;
+    void writeRadius(int radius);
+    bool getTotalistic() const;
+    void writeTotalistic(bool totalistic);
 
     //void writeRandSeed(double randSeed);
     //double getRandSeed() const;
@@ -89,7 +125,10 @@ public:
 
 signals:
     // QML signals
-    void ruleChanged(int rule);
+    void ruleChanged(QString rule);
+    void statesChanged(int states);
+    void radiusChanged(int radius);
+    void totalisticChanged(bool totalistic);
     //void randSeedChanged(double randSeed);
     void flagRandSeedChanged(bool flag_randSeed);
 };
@@ -0,0 +1,120 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "WolframRule.h"
+
+bool WolframRule::compile(const QString& code, int states, int radius, bool totalistic, bool& truncated) {
+    this->states = states;
+    this->radius = radius;
+    this->totalistic = totalistic;
+    truncated = false;
+
+    // neighbourhoods a rule can tell apart: the sums of 2 * radius + 1 states, or all their combinations
+    int span = 2 * radius + 1;
+    qint64 tableSize = totalistic ? (qint64) span * (states - 1) + 1 : 1;
+    for(int i = 0; i < span && !totalistic; i++) {
+        tableSize = std::min(tableSize * states, (qint64) maxTableSize + 1);
+    }
+    if(tableSize > maxTableSize) {
+        table.clear();
+        return false;
+    }
+
+    if(!toDigits(code, states, (int) tableSize, table, truncated)) {
+        table.assign(tableSize, 0);
+    }
+    return true;
+}
+
+void WolframRule::step(const quint8* row, quint8* next, int width, std::vector<quint8>& padded) const {
+    if(table.empty()) {
+        std::copy(row, row + width, next);
+        return;
+    }
+
+    // the row, with radius cells of the opposite edge on each side, so that every neighbourhood is contiguous
+    int span = 2 * radius + 1;
+    padded.resize(width + 2 * radius);
+    std::copy(row, row + width, padded.begin() + radius);
+    for(int i = 0; i < radius; i++) {
+        // the radius may be larger than the row, which then wraps several times
+        padded[i] = row[((i - radius) % width + width) % width];
+        padded[width + radius + i] = row[i % width];
+    }
+    const quint8* cells = padded.data();
+
+    // the index of the neighbourhood slides along the row: each step adds the cell entering on the right, and drops the one leaving
+    // on the left, which is the leading digit of the index, or a term of the sum for totalistic rules
+    int index = 0;
+    for(int i = 0; i < span - 1; i++) {
+        index = totalistic ? index + cells[i] : index * states + cells[i];
+    }
+    if(totalistic) {
+        for(int x = 0; x < width; x++) {
+            index += cells[x + span - 1];
+            next[x] = table[index];
+            index -= cells[x];
+        }
+    } else {
+        // the weight of the leading digit, which leaves the index once it slides past it
+        int leading = (int) table.size() / states;
+        for(int x = 0; x < width; x++) {
+            index = index * states + cells[x + span - 1];
+            next[x] = table[index];
+            index -= cells[x] * leading;
+        }
+    }
+}
+
+bool WolframRule::toDigits(const QString& code, int base, int count, std::vector<quint8>& digits, bool& truncated) {
+    // decimal digits, most significant first
+    std::vector<int> decimal;
+    for(QChar character : code.trimmed()) {
+        if(!character.isDigit()) {
+            return false;
+        }
+        if(!decimal.empty() || character.digitValue() != 0) {
+            decimal.push_back(character.digitValue());
+        }
+    }
+    if(code.trimmed().isEmpty()) {
+        return false;
+    }
+
+    // long division by base, each remainder being the next digit
+    digits.assign(count, 0);
+    truncated = false;
+    for(int i = 0; !decimal.empty(); i++) {
+        std::vector<int> quotient;
+        int remainder = 0;
+        for(int digit : decimal) {
+            int value = remainder * 10 + digit;
+            if(!quotient.empty() || value / base != 0) {
+                quotient.push_back(value / base);
+            }
+            remainder = value % base;
+        }
+        if(i < count) {
+            digits[i] = remainder;
+        } else if(remainder != 0) {
+            truncated = true;
+        }
+        decimal.swap(quotient);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+// Copyright 2020, Xmodal
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// rule of a one dimensional cellular automaton of any number of states and radius, as used by WolframCA.
+//
+// rules are Wolfram codes in decimal: digit n of the code in base states is the next state of the neighbourhoods of index n. the index is
+// the states of the 2 * radius + 1 cells of the neighbourhood read from left to right as a number in base states, or the sum of these states
+// for totalistic rules. the codes of larger rule spaces don't fit in any integer, so they are converted from text.
+struct WolframRule {
+    int states = 2;
+    int radius = 1;
+    bool totalistic = false;
+    // table[index] is the next state of a cell whose neighbourhood has this index. it is empty if the rule has too many neighbourhoods
+    // to be tabulated
+    std::vector<quint8> table;
+
+    static const int maxTableSize = 1 << 24;
+
+    // compiles code for the given rule space and returns true, or leaves table empty and returns false if the rule space is too large.
+    // codes that aren't decimal numbers give the rule where every cell dies. truncated is set if code is larger than the codes of the rule space
+    bool compile(const QString& code, int states, int radius, bool totalistic, bool& truncated);
+
+    // computes the generation following row, of width cells, into next. the row wraps around, and padded is scratch space for the copy
+    // of the row with the cells of the opposite edge on each side. an empty table leaves the cells as they are
+    void step(const quint8* row, quint8* next, int width, std::vector<quint8>& padded) const;
+
+    // digits of the decimal number code in base, least significant first, count of them. returns false if code isn't a decimal number.
+    // truncated is set if code has non-zero digits past count
+    static bool toDigits(const QString& code, int base, int count, std::vector<quint8>& digits, bool& truncated);
+};
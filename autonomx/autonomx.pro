@@ -34,7 +34,9 @@ SOURCES += \
     ../qosc/contrib/oscpack/OscTypes.cpp \
     AppModel.cpp \
     ComputeEngine.cpp \
+    ComputeWorkerPool.cpp \
     CursorOverrider.cpp \
+    DeadlineClock.cpp \
     Facade.cpp \
     GameOfLife.cpp \
     Generator.cpp \
@@ -47,12 +49,21 @@ SOURCES += \
     GeneratorModel.cpp \
     GeneratorRegion.cpp \
     GeneratorRegionSet.cpp \
+    HashLife.cpp \
     Izhikevich.cpp \
+    LatencyHistogram.cpp \
+    LifeRule.cpp \
     OscEngine.cpp \
     OscEngineFacade.cpp \
+    PhiloxRandom.cpp \
     Settings.cpp \
     SpikingNet.cpp \
+    StateSnapshot.cpp \
+    StatsFacade.cpp \
+    SynapseCache.cpp \
+    SynapseMatrix.cpp \
     WolframCA.cpp \
+    WolframRule.cpp \
     main.cpp
 
 RESOURCES += qml.qrc
@@ -87,8 +98,12 @@ HEADERS += \
     ../qosc/contrib/oscpack/OscReceivedElements.h \
     ../qosc/contrib/oscpack/OscTypes.h \
     AppModel.h \
+    BitRow.h \
     ComputeEngine.h \
+    ComputeWorkerPool.h \
     CursorOverrider.h \
+    DeadlineClock.h \
+    DropOldestRing.h \
     Facade.h \
     GOLPatternType.h \
     GameOfLife.h \
@@ -103,13 +118,25 @@ HEADERS += \
     GeneratorModel.h \
     GeneratorRegion.h \
     GeneratorRegionSet.h \
+    HashLife.h \
     Izhikevich.h \
+    LatencyHistogram.h \
+    LifeRule.h \
     NeuronType.h \
     OscEngine.h \
     OscEngineFacade.h \
+    OutputFrame.h \
+    PhiloxRandom.h \
     Settings.h \
+    SimdBatch.h \
     SpikingNet.h \
-    WolframCA.h
+    SpscRing.h \
+    StateSnapshot.h \
+    StatsFacade.h \
+    SynapseCache.h \
+    SynapseMatrix.h \
+    WolframCA.h \
+    WolframRule.h
 
 INCLUDEPATH += $$PWD/../qosc
 INCLUDEPATH += $$PWD/../qosc/contrib/packosc
@@ -124,6 +151,12 @@ macx {
     LIBS += -framework Foundation
 }
 
+# build the SIMD kernels (see SimdBatch.h) for AVX2 instead of the baseline instruction set of the target
+simd_avx2: QMAKE_CXXFLAGS += $$QMAKE_CFLAGS_AVX2
+
+# store the neuron state of SpikingNet in single precision (see Izhikevich.h)
+neuron_float32: DEFINES += AUTONOMX_NEURON_FLOAT
+
 # Should disable assertions # FIXME: It doesn't
 CONFIG(release, debug|release): DEFINES += NDEBUG
 
@@ -39,6 +39,15 @@ ColumnLayout {
                 propName: "timeScale"
                 minVal: 1
                 maxVal: 100
+            },
+
+            NumberField {
+                labelText: "Tick rate"
+                propName: "tickRate"
+                type: 1
+                min: 0.01
+                max: 1000
+                unit: " Hz"
             }
         ]
     }
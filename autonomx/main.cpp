@@ -22,7 +22,12 @@
 #include <QFontDatabase>
 #include <QQmlPropertyMap>
 #include <QFile>
+#include <QFileInfo>
 #include <QSettings>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QUrl>
+#include <cstring>
 
 #include "OscEngine.h"
 #include "ComputeEngine.h"
@@ -46,21 +51,133 @@
 
 bool flagDebug = false;
 
+// constant settings
+const char* applicationName = "autonomX";
+const char* applicationVersion = "0.1.1";
+const char* organizationName = "Xmodal";
+const char* extensionName = "atnx";
+
+// runs the engines without any user interface: no QGuiApplication, QML, facades or renderers.
+// the project given on the command line is loaded and runs until the process is terminated, or is rendered offline with --render
+int runHeadless(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    // global settings
+    QCoreApplication::setApplicationName(applicationName);
+    QCoreApplication::setApplicationVersion(applicationVersion);
+    QCoreApplication::setOrganizationName(organizationName);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs an autonomX project without user interface.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption(QCommandLineOption("headless", "Run without user interface."));
+    QCommandLineOption renderOption("render", "Compute <iterations> iterations as fast as possible, write them to the output file and exit.", "iterations");
+    QCommandLineOption outputOption("output", "File written by --render.", "path", "render.bin");
+    QCommandLineOption deltaTimeOption("delta-time", "Time step of every iteration in seconds, used by --render.", "seconds", "0.0166667");
+    QCommandLineOption latticeOption("lattice", "Also write the lattice of every iteration with --render.");
+    QCommandLineOption seedOption("seed", "Reinitialize every generator with this seed (plus its id) before --render, so that runs can be compared.", "seed");
+    QCommandLineOption frequencyOption("frequency", "Minimum wake-up frequency of the compute loop in Hz (engine/frequency setting).", "hz");
+    QCommandLineOption catchUpOption("catch-up", "What a late generator does: skip the missed iterations, or substep through them (engine/catchUpPolicy setting).", "skip|substep");
+    QCommandLineOption inputPolicyOption("input-policy", "How OSC input is applied: lastWins, or frameAccurate to apply every frame in order (engine/inputPolicy setting).", "policy");
+    parser.addOption(renderOption);
+    parser.addOption(outputOption);
+    parser.addOption(deltaTimeOption);
+    parser.addOption(latticeOption);
+    parser.addOption(seedOption);
+    parser.addOption(frequencyOption);
+    parser.addOption(catchUpOption);
+    parser.addOption(inputPolicyOption);
+    parser.addPositionalArgument("project", QString("Project to run (.") + extensionName + ").");
+    parser.process(app);
+
+    if(parser.positionalArguments().isEmpty()) {
+        qCritical() << "no project given, nothing to run in headless mode";
+        return 1;
+    }
+
+    qDebug() << "Built against Qt" << QT_VERSION_STR;
+    qDebug() << "Using Qt" << QLibraryInfo::version() << "at runtime";
+
+    qRegisterMetaType<QSharedPointer<Generator>>();
+
+    // this must happen before the first call to AppModel::getInstance
+    AppModel::setHeadless(true);
+
+    // the command line overrides the loop settings of the application settings. the loop already runs, so they are applied on computeThread
+    QVariantMap engineSettings;
+    if(parser.isSet(frequencyOption)) {
+        engineSettings.insert("frequency", parser.value(frequencyOption).toDouble());
+    }
+    if(parser.isSet(catchUpOption)) {
+        engineSettings.insert("catchUpPolicy", parser.value(catchUpOption));
+    }
+    if(parser.isSet(inputPolicyOption)) {
+        engineSettings.insert("inputPolicy", parser.value(inputPolicyOption));
+    }
+    QMetaObject::invokeMethod(AppModel::getInstance().getComputeEngine().data(), [engineSettings]() {
+        AppModel::getInstance().getComputeEngine()->writeSettings(engineSettings);
+    }, Qt::QueuedConnection);
+
+    // loadProject expects a URL, the way QML file dialogs provide it
+    QString projectPath = QFileInfo(parser.positionalArguments().first()).absoluteFilePath();
+    if(!AppModel::getInstance().loadProject(QUrl::fromLocalFile(projectPath).toString())) {
+        qCritical() << "could not load project" << projectPath;
+        return 1;
+    }
+
+    // offline render: runs on computeThread once the generators of the project are added there, and quits once the file is written
+    if(parser.isSet(renderOption)) {
+        int iterations = parser.value(renderOption).toInt();
+        double deltaTime = parser.value(deltaTimeOption).toDouble();
+        if(iterations <= 0 || deltaTime <= 0) {
+            qCritical() << "--render needs a positive number of iterations and --delta-time";
+            return 1;
+        }
+
+        QObject::connect(AppModel::getInstance().getComputeEngine().data(), &ComputeEngine::renderFinished, &app, [&app](bool success) {
+            app.exit(success ? 0 : 1);
+        }, Qt::QueuedConnection);
+
+        QString outputPath = QFileInfo(parser.value(outputOption)).absoluteFilePath();
+        bool writeLattice = parser.isSet(latticeOption);
+        bool seeded = parser.isSet(seedOption);
+        quint32 seed = parser.value(seedOption).toUInt();
+        QMetaObject::invokeMethod(AppModel::getInstance().getComputeEngine().data(), [=]() {
+            AppModel::getInstance().getComputeEngine()->render(outputPath, iterations, deltaTime, writeLattice, seeded, seed);
+        }, Qt::QueuedConnection);
+
+        qDebug() << "rendering" << projectPath << "to" << outputPath;
+    } else {
+        qDebug() << "running" << projectPath << "in headless mode";
+    }
+
+    // end compute and osc threads on application exit
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, [](){
+        AppModel::getInstance().getComputeEngine()->stop();
+        AppModel::getInstance().getComputeThread()->exit();
+        AppModel::getInstance().getOscThread()->exit();
+    });
+
+    return app.exec();
+}
+
 int main(int argc, char *argv[]) {
     // disable App Nap on macOS to prevent compute / osc thread from stalling
     #ifdef Q_OS_MAC
     disableAppNap();
     #endif
 
+    // the kind of application object has to be decided before one exists, so this can't go through QCommandLineParser
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--headless") == 0) {
+            return runHeadless(argc, argv);
+        }
+    }
+
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QGuiApplication app(argc, argv);
 
-    // constant settings
-    const char* applicationName = "autonomX";
-    const char* applicationVersion = "0.1.1";
-    const char* organizationName = "Xmodal";
-    const char* extensionName = "atnx";
-
     // global settings
     QCoreApplication::setApplicationName(applicationName);
     QCoreApplication::setApplicationVersion(applicationVersion);
@@ -118,6 +235,7 @@ int main(int argc, char *argv[]) {
     qmlEngine.rootContext()->setContextProperty("generatorModel", AppModel::getInstance().getGeneratorModel().data());
     qmlEngine.rootContext()->setContextProperty("generatorMetaModel", AppModel::getInstance().getGeneratorMetaModel().data());
     qmlEngine.rootContext()->setContextProperty("oscEngine", AppModel::getInstance().getOscEngineFacade().data());
+    qmlEngine.rootContext()->setContextProperty("computeStats", AppModel::getInstance().getStatsFacade().data());
     qmlEngine.rootContext()->setContextProperty("settings", settings);
     qmlEngine.load(QUrl(QStringLiteral("qrc:/main.qml")));
     if (qmlEngine.rootObjects().isEmpty())
@@ -125,6 +243,7 @@ int main(int argc, char *argv[]) {
 
     // end compute and osc threads on application exit
     QObject::connect(&app, &QCoreApplication::aboutToQuit, [](){
+        AppModel::getInstance().getComputeEngine()->stop();
         AppModel::getInstance().getComputeThread()->exit();
         AppModel::getInstance().getOscThread()->exit();
     });
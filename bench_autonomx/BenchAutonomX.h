@@ -0,0 +1,10 @@
+#pragma once
+
+// standalone measurements of the compute kernels, printed as tables. run bench_autonomx with the name of a benchmark, or without
+// arguments to run all of them. they only use the kernels, without the engines or any generator
+
+// accuracy and cost of Izhikevich::step for several frame lengths and integration steps, against a run with a very small step
+void benchIzhikevichSubsteps();
+
+// export and injection of a whole 512x512 bit-packed lattice, one virtual call per cell against readLatticeRow and fillLatticeRow
+void benchLatticeRows();
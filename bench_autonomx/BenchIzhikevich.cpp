@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BenchAutonomX.h"
+#include "Izhikevich.h"
+
+namespace {
+
+// chattering neurons with a constant input, spread over the range where they fire regularly
+const int neuronCount = 20000;
+const double modelTime = 1000.0;        // in ms
+const double referenceStep = 0.005;     // in ms
+
+struct Run {
+    std::vector<long> spikeCounts;      // per neuron
+    int diverged = 0;                   // neurons whose state isn't finite at the end
+    double cost = 0;                    // ns per neuron and frame
+};
+
+// runs modelTime ms in frames of frameLength ms, each split into steps of at most step ms, as SpikingNet::integrationStep does
+Run run(double frameLength, double step) {
+    Izhikevich neurons;
+    neurons.resize(neuronCount);
+    for(int i = 0; i < neuronCount; i++) {
+        neurons.setNeuronType(i, NeuronType::ChatteringNeuron);
+    }
+
+    Run result;
+    result.spikeCounts.assign(neuronCount, 0);
+    int frames = (int) std::lround(modelTime / frameLength);
+    int substeps = std::max(1, (int) std::ceil(frameLength / step - 1e-9));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int frame = 0; frame < frames; frame++) {
+        for(int i = 0; i < neuronCount; i++) {
+            neurons.addToI(i, 4.0 + 8.0 * ((i * 2654435761u) % 1000) / 1000.0);
+        }
+        neurons.clearSpikes();
+        neurons.step(0, neurons.getPaddedSize(), frameLength / 1000.0, substeps);
+        for(int k = 0; k < neurons.getSpikeCount(); k++) {
+            result.spikeCounts[neurons.getSpikes()[k]]++;
+        }
+    }
+    result.cost = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames / neuronCount;
+
+    for(int i = 0; i < neuronCount; i++) {
+        if(!std::isfinite(neurons.getV(i)) || !std::isfinite(neurons.getU(i))) {
+            result.diverged++;
+        }
+    }
+    return result;
+}
+
+}
+
+void benchIzhikevichSubsteps() {
+    Run reference = run(referenceStep, referenceStep);
+    long referenceSpikes = 0;
+    for(long count : reference.spikeCounts) {
+        referenceSpikes += count;
+    }
+    std::printf("%d chattering neurons, %g ms of model time, reference step %g ms: %ld spikes\n", neuronCount, modelTime, referenceStep, referenceSpikes);
+    std::printf("the rate error is the per-neuron spike count error relative to the reference\n\n");
+    std::printf("frame (ms)  step (ms)  rate error  diverged  ns/neuron/frame\n");
+
+    // a step of 0 means a single step per frame, the integration before substeps
+    for(double frameLength : {0.5, 2.0, 5.0}) {
+        for(double step : {0.0, 0.5, 0.25, 0.1}) {
+            if(step >= frameLength) {
+                continue;
+            }
+            Run result = run(frameLength, step > 0 ? step : frameLength);
+
+            double error = 0;
+            for(int i = 0; i < neuronCount; i++) {
+                error += std::fabs((double) result.spikeCounts[i] - reference.spikeCounts[i]);
+            }
+            error /= std::max<long>(1, referenceSpikes);
+
+            std::printf("%10.1f  %9s  %10.3f  %8d  %15.1f\n", frameLength, step > 0 ? std::to_string(step).substr(0, 4).c_str() : "frame",
+                        error, result.diverged, result.cost);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BenchAutonomX.h"
+#include "BitRow.h"
+
+namespace {
+
+const int latticeSize = 512;
+const int repetitions = 200;
+
+// the lattice accessors of Generator, called through a base pointer as ComputeEngine calls them
+struct Lattice {
+    virtual ~Lattice() {}
+    virtual double getLatticeValue(int x, int y) = 0;
+    virtual void writeLatticeValue(int x, int y, double value) = 0;
+    virtual void readLatticeRow(int x, int y, int count, float* values) = 0;
+    virtual void fillLatticeRow(int x, int y, int count, double value) = 0;
+};
+
+// the bit-packed rows of GameOfLife. the per-cell accessors are the ones the engines used before the row spans
+struct BitLattice : Lattice {
+    int wordsPerRow = (latticeSize + 63) / 64;
+    std::vector<quint64> cells = std::vector<quint64>(latticeSize * wordsPerRow);
+
+    double getLatticeValue(int x, int y) override {
+        return (cells[y * wordsPerRow + x / 64] >> (x % 64)) & 1;
+    }
+    void writeLatticeValue(int x, int y, double value) override {
+        quint64 bit = (quint64) 1 << (x % 64);
+        if(value >= 0.5) {
+            cells[y * wordsPerRow + x / 64] |= bit;
+        } else {
+            cells[y * wordsPerRow + x / 64] &= ~bit;
+        }
+    }
+    void readLatticeRow(int x, int y, int count, float* values) override {
+        readBits(&cells[y * wordsPerRow], x, count, values);
+    }
+    void fillLatticeRow(int x, int y, int count, double value) override {
+        fillBits(&cells[y * wordsPerRow], x, count, value >= 0.5);
+    }
+};
+
+template<typename Function>
+double milliseconds(Function function) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int k = 0; k < repetitions; k++) {
+        function();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+// random spans written and read both ways must give the same cells and values
+bool equivalent() {
+    std::mt19937 random(1);
+    BitLattice spans, cells;
+    for(quint64& word : spans.cells) {
+        word = ((quint64) random() << 32) | random();
+    }
+    cells.cells = spans.cells;
+
+    for(int t = 0; t < 20000; t++) {
+        int x = random() % latticeSize;
+        int y = random() % latticeSize;
+        int count = random() % (latticeSize + 1 - x);
+        double value = random() % 2 ? 0.7 : 0.2;
+        spans.fillLatticeRow(x, y, count, value);
+        for(int i = 0; i < count; i++) {
+            cells.writeLatticeValue(x + i, y, value);
+        }
+    }
+    if(spans.cells != cells.cells) {
+        return false;
+    }
+
+    std::vector<float> values(latticeSize);
+    for(int t = 0; t < 2000; t++) {
+        int x = random() % latticeSize;
+        int y = random() % latticeSize;
+        int count = random() % (latticeSize + 1 - x);
+        spans.readLatticeRow(x, y, count, values.data());
+        for(int i = 0; i < count; i++) {
+            if(values[i] != (float) spans.getLatticeValue(x + i, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+void benchLatticeRows() {
+    if(!equivalent()) {
+        std::printf("the row spans don't match the per-cell accessors\n");
+        return;
+    }
+
+    BitLattice bits;
+    Lattice* lattice = &bits;
+    std::vector<float> data(latticeSize * latticeSize);
+
+    // a whole lattice region, as an output region exports it and an input region injects it
+    double exportCells = milliseconds([&]() {
+        for(int x = 0; x < latticeSize; x++) {
+            for(int y = 0; y < latticeSize; y++) {
+                data[x + y * latticeSize] = (float) lattice->getLatticeValue(x, y);
+            }
+        }
+    });
+    double exportRows = milliseconds([&]() {
+        for(int y = 0; y < latticeSize; y++) {
+            lattice->readLatticeRow(0, y, latticeSize, data.data() + y * latticeSize);
+        }
+    });
+    double injectCells = milliseconds([&]() {
+        for(int x = 0; x < latticeSize; x++) {
+            for(int y = 0; y < latticeSize; y++) {
+                lattice->writeLatticeValue(x, y, 0.7);
+            }
+        }
+    });
+    double injectRows = milliseconds([&]() {
+        for(int y = 0; y < latticeSize; y++) {
+            lattice->fillLatticeRow(0, y, latticeSize, 0.7);
+        }
+    });
+
+    std::printf("%dx%d bit-packed lattice, mean of %d repetitions\n\n", latticeSize, latticeSize, repetitions);
+    std::printf("          per cell (ms)  per row (ms)\n");
+    std::printf("export    %13.3f  %12.4f\n", exportCells, exportRows);
+    std::printf("inject    %13.3f  %12.4f\n", injectCells, injectRows);
+}
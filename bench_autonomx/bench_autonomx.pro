@@ -0,0 +1,30 @@
+QT += core
+QT -= gui
+
+CONFIG += sdk_no_version_check
+CONFIG += c++17
+
+TARGET = bench_autonomx
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+# benchmarks are only meaningful with optimizations
+CONFIG += release
+CONFIG -= debug
+
+SOURCES += main.cpp \
+    BenchIzhikevich.cpp \
+    BenchLatticeRows.cpp \
+    ../autonomx/Izhikevich.cpp
+
+HEADERS += \
+    BenchAutonomX.h \
+    ../autonomx/BitRow.h
+
+INCLUDEPATH += $$PWD/../autonomx/
+
+# same options as autonomx.pro, so that the kernels are measured as the application runs them
+simd_avx2: QMAKE_CXXFLAGS += $$QMAKE_CFLAGS_AVX2
+neuron_float32: DEFINES += AUTONOMX_NEURON_FLOAT
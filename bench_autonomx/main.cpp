@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <cstring>
+
+#include "BenchAutonomX.h"
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"substeps", benchIzhikevichSubsteps},
+    {"lattice", benchLatticeRows}
+};
+
+int main(int argc, char *argv[]) {
+    bool found = argc < 2;
+    for(const Benchmark& benchmark : benchmarks) {
+        if(argc < 2 || std::strcmp(argv[1], benchmark.name) == 0) {
+            std::printf("== %s\n", benchmark.name);
+            benchmark.run();
+            found = true;
+        }
+    }
+
+    if(!found) {
+        std::fprintf(stderr, "unknown benchmark %s, expected one of:", argv[1]);
+        for(const Benchmark& benchmark : benchmarks) {
+            std::fprintf(stderr, " %s", benchmark.name);
+        }
+        std::fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
@@ -18,6 +18,8 @@ OscReceiver::OscReceiver(quint16 port, QObject* parent) :
 
     m_udpSocket = new QUdpSocket(this);
     m_port = port;
+    m_datagram.resize(2048);
+    m_floats.resize(64);
     m_udpSocket->bind(QHostAddress::Any, m_port);
     connect(m_udpSocket, &QUdpSocket::readyRead, this, &OscReceiver::readyReadCb);
 }
@@ -43,11 +45,28 @@ void OscReceiver::setPort(quint16 port)
     m_udpSocket->bind(QHostAddress::Any, m_port);
 }
 
+void OscReceiver::setFloatFastPath(bool enabled)
+{
+    m_floatFastPath = enabled;
+}
+
 void OscReceiver::readyReadCb() {
     while (this->m_udpSocket->hasPendingDatagrams()) {
-        QNetworkDatagram datagram = this->m_udpSocket->receiveDatagram();
+        qint64 pendingSize = this->m_udpSocket->pendingDatagramSize();
+        if (pendingSize > (qint64) m_datagram.size()) {
+            m_datagram.resize(pendingSize);
+        }
         // XXX: we could also retrieve the sender host and port
-        QByteArray data = datagram.data();
+        qint64 size = this->m_udpSocket->readDatagram(m_datagram.data(), m_datagram.size());
+        if (size < 0) {
+            continue;
+        }
+
+        if (m_floatFastPath && this->emitFloatMessage(m_datagram.data(), (int) size)) {
+            continue;
+        }
+
+        QByteArray data = QByteArray::fromRawData(m_datagram.data(), (int) size);
         QVariantList arguments;
         QString oscAddress;
         this->byteArrayToVariantList(arguments, oscAddress, data);
@@ -90,3 +109,34 @@ void OscReceiver::byteArrayToVariantList(QVariantList& outputVariantList, QStrin
         }
     } // TODO: also parse bundles
 }
+
+bool OscReceiver::emitFloatMessage(const char* data, int size) {
+    osc::ReceivedPacket packet(data, size);
+    if (!packet.IsMessage()) {
+        return false;
+    }
+
+    osc::ReceivedMessage message(packet);
+    int count = 0;
+    for (auto iter = message.ArgumentsBegin(); iter != message.ArgumentsEnd(); ++ iter) {
+        float value;
+        if (iter->IsFloat()) {
+            value = iter->AsFloat();
+        } else if (iter->IsInt32()) {
+            value = (float) iter->AsInt32();
+        } else if (iter->IsDouble()) {
+            value = (float) iter->AsDouble();
+        } else {
+            // anything else goes through messageReceived
+            return false;
+        }
+
+        if (count == (int) m_floats.size()) {
+            m_floats.resize(m_floats.size() * 2);
+        }
+        m_floats[count++] = value;
+    }
+
+    emit floatMessageReceived(message.AddressPattern(), m_floats.data(), count);
+    return true;
+}
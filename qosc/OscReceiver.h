@@ -4,6 +4,7 @@
 #include <QVariant>
 #include <QtNetwork>
 #include <QHostAddress>
+#include <vector>
 
 /**
  * @brief Receives OSC on a given port number.
@@ -28,6 +29,14 @@ public:
     ~OscReceiver();
     void setPort(quint16 port);
 
+    /**
+     * @brief Enables the numeric fast path.
+     *
+     * When enabled, messages whose arguments are all numbers (int32, float or double) are emitted through floatMessageReceived
+     * instead of messageReceived, which avoids building QVariants and allocating for every message.
+     */
+    void setFloatFastPath(bool enabled);
+
 signals:
     /**
      * @brief Signal triggered each time we receive a message.
@@ -36,14 +45,30 @@ signals:
      */
     void messageReceived(const QString& oscAddress, const QVariantList& message);
 
+    /**
+     * @brief Signal triggered each time we receive a numeric message, if the fast path is enabled.
+     *
+     * The pointers are only valid during the emission, so this must be connected with a direct connection.
+     * @param oscAddress null-terminated address pattern
+     * @param values arguments converted to float
+     * @param count number of arguments
+     */
+    void floatMessageReceived(const char* oscAddress, const float* values, int count);
+
 public slots:
     void readyReadCb();
 
 private:
     QUdpSocket* m_udpSocket;
     quint16 m_port;
+    bool m_floatFastPath = false;
+    std::vector<char> m_datagram;   // reused for every datagram, only grows
+    std::vector<float> m_floats;    // reused for every numeric message, only grows
 
     void byteArrayToVariantList(QVariantList& outputVariantList, QString& outputOscAddress, const QByteArray& inputByteArray);
 
+    // emits floatMessageReceived if the datagram is a message with numeric arguments only. returns false if it isn't, without emitting
+    bool emitFloatMessage(const char* data, int size);
+
     bool flagDebug = false;
 };
@@ -70,6 +70,30 @@ void OscSender::send(const QString& oscAddress, const QVariantList& arguments) {
     m_udpSocket->waitForBytesWritten();
 }
 
+void OscSender::sendFloats(const char* oscAddress, const char* label, const float* values, int count) {
+    if(flagDebug) {
+        qDebug() << "sendFloats (OscSender)\taddress = " << oscAddress << "\tlabel = " << label << "\tcount = " << count;
+    }
+
+    char buffer[2048];
+    osc::OutboundPacketStream packet(buffer, sizeof(buffer));
+    packet << osc::BeginMessage(oscAddress);
+    if (label != nullptr) {
+        packet << label;
+    }
+    for (int i = 0; i < count; ++ i) {
+        packet << values[i];
+    }
+    packet << osc::EndMessage;
+
+    qint64 written = m_udpSocket->write(packet.Data(), packet.Size());
+
+    if (flagDebug && written == -1) {
+        qDebug() << "failed to send OSC (write bytes to the send socket)";
+    }
+    m_udpSocket->flush();
+    m_udpSocket->waitForBytesWritten();
+}
 
 void OscSender::variantListToByteArray(QByteArray& outputResult, const QString& oscAddress, const QVariantList& arguments) {
     char buffer[1024];
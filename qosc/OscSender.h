@@ -41,6 +41,15 @@ public:
      */
     Q_INVOKABLE void send(const QString& oscAddress, const QVariantList& arguments);
 
+    /**
+     * @brief Sends an OSC message made of a string followed by floats, without going through QVariant or allocating.
+     * @param oscAddress null-terminated OSC path /like/this
+     * @param label null-terminated string sent as the first argument, or nullptr to send the floats only
+     * @param values float arguments
+     * @param count number of float arguments
+     */
+    void sendFloats(const char* oscAddress, const char* label, const float* values, int count);
+
 signals:
     // TODO: Add messageSent signal
     // TODO: Add connected signal for TCP sender.
@@ -1,7 +1,738 @@
+#include <QBuffer>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
 #include "TestAutonomX.h"
+#include "DropOldestRing.h"
+#include "HashLife.h"
+#include "LifeRule.h"
+#include "PhiloxRandom.h"
+#include "SpscRing.h"
+#include "StateSnapshot.h"
+#include "SynapseMatrix.h"
+#include "WolframRule.h"
+
+// one generation of a life-like rule on a size x size grid, with dead cells outside
+static std::vector<quint8> naiveLifeStep(const std::vector<quint8>& cells, int size, const LifeRule& rule)
+{
+    std::vector<quint8> next(cells.size(), 0);
+    for(int y = 0; y < size; y++) {
+        for(int x = 0; x < size; x++) {
+            int count = 0;
+            for(int dy = -1; dy <= 1; dy++) {
+                for(int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if((dx != 0 || dy != 0) && nx >= 0 && nx < size && ny >= 0 && ny < size) {
+                        count += cells[ny * size + nx];
+                    }
+                }
+            }
+            next[y * size + x] = cells[y * size + x] ? rule.survival[count] : rule.birth[count];
+        }
+    }
+    return next;
+}
+
+// a world with a random soup, advanced a few generations
+static void randomWorld(HashLife& world, std::mt19937& random)
+{
+    for(int y = -16; y < 16; y++) {
+        for(int x = -16; x < 16; x++) {
+            world.setCell(x, y, random() % 100 < 35);
+        }
+    }
+    world.step(0);
+    world.step(2);
+}
+
+// a random network, with half of the synapses scaled
+static void randomMatrix(SynapseMatrix& matrix, std::mt19937& random)
+{
+    const int neuronCount = 40;
+    matrix.clear(neuronCount);
+    for(int source = 0; source < neuronCount; source++) {
+        for(int destination = 0; destination < neuronCount; destination++) {
+            if(random() % 5 == 0) {
+                matrix.add(source, destination, (random() % 2000) / 1000.0 - 1);
+            }
+        }
+    }
+    matrix.build();
+    for(int synapse = 0; synapse < matrix.getSynapseCount(); synapse++) {
+        matrix.setScaled(synapse, random() % 2);
+    }
+    matrix.scale(0.5);
+}
+
+// the decimal text of the number whose digits in base are given, least significant first
+static QString toDecimal(const std::vector<quint8>& digits, int base)
+{
+    std::vector<int> decimal = {0};
+    for(int i = (int) digits.size() - 1; i >= 0; i--) {
+        int carry = digits[i];
+        for(int& digit : decimal) {
+            int value = digit * base + carry;
+            digit = value % 10;
+            carry = value / 10;
+        }
+        while(carry > 0) {
+            decimal.push_back(carry % 10);
+            carry /= 10;
+        }
+    }
+
+    QString text;
+    for(int i = (int) decimal.size() - 1; i >= 0; i--) {
+        text.append(QChar('0' + decimal[i]));
+    }
+    return text;
+}
 
 void TestAutonomX::test_something()
 {
     //Q_COMPARE();
 }
 
+void TestAutonomX::test_hashLifeAgainstNaiveLife()
+{
+    std::mt19937 random(1);
+    const int generations = 32;
+    const int size = 32 + 2 * generations + 2;
+    const int half = size / 2;
+
+    for(const QString& text : {QString("B3/S23"), QString("B36/S23"), QString("B3678/S34678")}) {
+        LifeRule rule;
+        QVERIFY(LifeRule::parse(text, rule));
+
+        // a random soup in the center of the grid, which is large enough for the pattern to never reach its edge
+        std::vector<quint8> cells(size * size, 0);
+        HashLife world;
+        world.setRule(rule);
+        for(int y = half - 16; y < half + 16; y++) {
+            for(int x = half - 16; x < half + 16; x++) {
+                cells[y * size + x] = random() % 100 < 35;
+                world.setCell(x - half, y - half, cells[y * size + x]);
+            }
+        }
+
+        // single generations, then steps of 4
+        int generation = 0;
+        while(generation < generations) {
+            int stepLog = generation < generations / 2 ? 0 : 2;
+            world.step(stepLog);
+            for(int i = 0; i < (1 << stepLog); i++) {
+                cells = naiveLifeStep(cells, size, rule);
+            }
+            generation += 1 << stepLog;
+
+            QCOMPARE(world.getGeneration(), (quint64) generation);
+            int mismatches = 0;
+            for(int y = 0; y < size; y++) {
+                for(int x = 0; x < size; x++) {
+                    mismatches += world.getCell(x - half, y - half) != (bool) cells[y * size + x];
+                }
+            }
+            QCOMPARE(mismatches, 0);
+        }
+    }
+}
+
+void TestAutonomX::test_lifeRuleParse()
+{
+    LifeRule rule;
+    QVERIFY(rule.isConway());
+
+    // every notation of Conway's rule
+    for(const QString& text : {QString("B3/S23"), QString("S23/B3"), QString("23/3"), QString(" b3 / s23 ")}) {
+        // from another rule, so that every field has to be written
+        LifeRule parsed;
+        QVERIFY(LifeRule::parse("B36/S23", parsed));
+        QVERIFY(LifeRule::parse(text, parsed));
+        QVERIFY(parsed.isConway());
+        QVERIFY(parsed.isHashLifeCompatible());
+    }
+
+    QVERIFY(LifeRule::parse("B36/S23", rule));
+    QCOMPARE(rule.radius, 1);
+    QCOMPARE(rule.birthMask, (quint16) ((1 << 3) | (1 << 6)));
+    QCOMPARE(rule.survivalMask, (quint16) ((1 << 2) | (1 << 3)));
+    QCOMPARE((int) rule.birth.size(), 9);
+    QCOMPARE((int) rule.survival.size(), 9);
+    QVERIFY(!rule.isConway());
+
+    QVERIFY(LifeRule::parse("B0/S8", rule));
+    QVERIFY(!rule.isHashLifeCompatible());
+
+    // Larger than Life. M1 counts the cell itself, which the tables exclude, so the survival range moves down by one
+    QVERIFY(LifeRule::parse("R5,C0,M1,S34..58,B34..45,NM", rule));
+    QCOMPARE(rule.radius, 5);
+    QCOMPARE(rule.getNeighbourCount(), 120);
+    QCOMPARE((int) rule.birth.size(), 121);
+    QCOMPARE((int) rule.birth[33], 0);
+    QCOMPARE((int) rule.birth[34], 1);
+    QCOMPARE((int) rule.birth[45], 1);
+    QCOMPARE((int) rule.birth[46], 0);
+    QCOMPARE((int) rule.survival[32], 0);
+    QCOMPARE((int) rule.survival[33], 1);
+    QCOMPARE((int) rule.survival[57], 1);
+    QCOMPARE((int) rule.survival[58], 0);
+    QVERIFY(!rule.isHashLifeCompatible());
+
+    // invalid rules leave the rule unchanged
+    QVERIFY(LifeRule::parse("B3/S23", rule));
+    for(const QString& text : {QString("B9/S23"), QString("hello"), QString("R0,C0,M0,S1..2,B3..3,NM"), QString("R2,C3,M0,S1..2,B3..3,NM"),
+                               QString("R2,C0,M0,S1..2,B3..3,NN")}) {
+        QVERIFY(!LifeRule::parse(text, rule));
+        QVERIFY(rule.isConway());
+    }
+}
+
+void TestAutonomX::test_lifeRuleStepWord()
+{
+    std::mt19937 random(2);
+    for(int trial = 0; trial < 64; trial++) {
+        // Conway first, then random rules
+        quint16 birthMask = trial == 0 ? 1 << 3 : random() % 512;
+        quint16 survivalMask = trial == 0 ? (1 << 2) | (1 << 3) : random() % 512;
+        QString text = "B";
+        for(int count = 0; count <= 8; count++) {
+            if((birthMask >> count) & 1) {
+                text += QString::number(count);
+            }
+        }
+        text += "/S";
+        for(int count = 0; count <= 8; count++) {
+            if((survivalMask >> count) & 1) {
+                text += QString::number(count);
+            }
+        }
+
+        LifeRule rule;
+        QVERIFY(LifeRule::parse(text, rule));
+        QCOMPARE(rule.isConway(), trial == 0);
+
+        int mismatches = 0;
+        for(int i = 0; i < 256; i++) {
+            quint64 words[9];
+            for(quint64& word : words) {
+                word = ((quint64) random() << 32) | random();
+            }
+            quint64 next = rule.stepWord(words[0], words[1], words[2], words[3], words[4], words[5], words[6], words[7], words[8]);
+
+            for(int bit = 0; bit < 64; bit++) {
+                int count = 0;
+                for(int neighbour = 0; neighbour < 9; neighbour++) {
+                    if(neighbour != 4) {
+                        count += (words[neighbour] >> bit) & 1;
+                    }
+                }
+                bool alive = (words[4] >> bit) & 1;
+                bool expected = alive ? rule.survival[count] : rule.birth[count];
+                mismatches += (bool) ((next >> bit) & 1) != expected;
+            }
+        }
+        QCOMPARE(mismatches, 0);
+    }
+}
+
+void TestAutonomX::test_wolframRuleDigits()
+{
+    std::vector<quint8> digits;
+    bool truncated;
+
+    QVERIFY(WolframRule::toDigits("90", 2, 8, digits, truncated));
+    QCOMPARE(digits, std::vector<quint8>({0, 1, 0, 1, 1, 0, 1, 0}));
+    QVERIFY(!truncated);
+
+    QVERIFY(WolframRule::toDigits(" 0090 ", 2, 8, digits, truncated));
+    QCOMPARE(digits, std::vector<quint8>({0, 1, 0, 1, 1, 0, 1, 0}));
+
+    // 256 doesn't fit in 8 binary digits
+    QVERIFY(WolframRule::toDigits("256", 2, 8, digits, truncated));
+    QCOMPARE(digits, std::vector<quint8>(8, 0));
+    QVERIFY(truncated);
+
+    for(const QString& code : {QString(""), QString("12a"), QString("-1"), QString("1.5")}) {
+        QVERIFY(!WolframRule::toDigits(code, 2, 8, digits, truncated));
+    }
+
+    // random numbers far larger than any integer type, written in decimal and converted back
+    std::mt19937 random(3);
+    for(int trial = 0; trial < 200; trial++) {
+        int base = 2 + random() % 6;
+        int count = 1 + random() % 80;
+        std::vector<quint8> expected(count);
+        for(quint8& digit : expected) {
+            digit = random() % base;
+        }
+        QString code = toDecimal(expected, base);
+
+        QVERIFY(WolframRule::toDigits(code, base, count, digits, truncated));
+        QCOMPARE(digits, expected);
+        QVERIFY(!truncated);
+
+        // one digit less is truncated if that digit isn't 0
+        QVERIFY(WolframRule::toDigits(code, base, count - 1, digits, truncated));
+        QCOMPARE(digits, std::vector<quint8>(expected.begin(), expected.end() - 1));
+        QCOMPARE(truncated, expected.back() != 0);
+    }
+}
+
+void TestAutonomX::test_wolframRuleStep()
+{
+    std::mt19937 random(4);
+    for(int trial = 0; trial < 200; trial++) {
+        int states = 2 + random() % 3;
+        int radius = 1 + random() % 3;
+        bool totalistic = random() % 2;
+        int span = 2 * radius + 1;
+        int tableSize = 1;
+        for(int i = 0; i < span; i++) {
+            tableSize *= states;
+        }
+        if(totalistic) {
+            tableSize = span * (states - 1) + 1;
+        }
+
+        std::vector<quint8> table(tableSize);
+        for(quint8& state : table) {
+            state = random() % states;
+        }
+
+        WolframRule rule;
+        bool truncated;
+        QVERIFY(rule.compile(toDecimal(table, states), states, radius, totalistic, truncated));
+        QVERIFY(!truncated);
+        QCOMPARE(rule.table, table);
+
+        // rows shorter than the neighbourhood wrap several times
+        int width = 1 + random() % 100;
+        std::vector<quint8> row(width);
+        for(quint8& state : row) {
+            state = random() % states;
+        }
+        std::vector<quint8> next(width);
+        std::vector<quint8> padded;
+        rule.step(row.data(), next.data(), width, padded);
+
+        int mismatches = 0;
+        for(int x = 0; x < width; x++) {
+            int index = 0;
+            for(int i = 0; i < span; i++) {
+                int state = row[((x + i - radius) % width + width) % width];
+                index = totalistic ? index + state : index * states + state;
+            }
+            mismatches += next[x] != table[index];
+        }
+        QCOMPARE(mismatches, 0);
+    }
+
+    // too many neighbourhoods for a table, the cells stay as they are
+    WolframRule rule;
+    bool truncated;
+    QVERIFY(!rule.compile("12345", 8, 8, false, truncated));
+    QVERIFY(rule.table.empty());
+    std::vector<quint8> row = {1, 7, 3, 0, 5};
+    std::vector<quint8> next(row.size());
+    std::vector<quint8> padded;
+    rule.step(row.data(), next.data(), (int) row.size(), padded);
+    QCOMPARE(next, row);
+}
+
+void TestAutonomX::test_spscRing()
+{
+    // against a queue, on a single thread
+    SpscRing<qint64> ring(5);
+    std::deque<qint64> expected;
+    const size_t capacity = 8;
+    quint64 dropped = 0;
+    std::mt19937 random(5);
+    for(qint64 i = 0; i < 10000; i++) {
+        if(random() % 2) {
+            qint64* slot = ring.acquire();
+            if(expected.size() == capacity) {
+                QVERIFY(slot == nullptr);
+                dropped++;
+            } else {
+                QVERIFY(slot != nullptr);
+                *slot = i;
+                ring.publish();
+                expected.push_back(i);
+            }
+        } else {
+            if(expected.empty()) {
+                QVERIFY(ring.front() == nullptr);
+            } else {
+                QCOMPARE(*ring.front(), expected.front());
+                for(size_t offset = 0; offset < expected.size(); offset++) {
+                    QCOMPARE(*ring.peek(offset), expected[offset]);
+                }
+                QVERIFY(ring.peek(expected.size()) == nullptr);
+                ring.pop();
+                expected.pop_front();
+            }
+        }
+        QCOMPARE(ring.size(), expected.size());
+        QCOMPARE(ring.getDropped(), dropped);
+    }
+
+    // one producer and one consumer: every element arrives, in order
+    SpscRing<qint64> shared(16);
+    const qint64 count = 200000;
+    QThread* producer = QThread::create([&shared, count]() {
+        for(qint64 i = 0; i < count; i++) {
+            qint64* slot;
+            while((slot = shared.acquire()) == nullptr) {
+                QThread::yieldCurrentThread();
+            }
+            *slot = i;
+            shared.publish();
+        }
+    });
+    producer->start();
+
+    qint64 outOfOrder = 0;
+    for(qint64 i = 0; i < count; i++) {
+        const qint64* value;
+        while((value = shared.front()) == nullptr) {
+            QThread::yieldCurrentThread();
+        }
+        outOfOrder += *value != i;
+        shared.pop();
+    }
+    producer->wait();
+    delete producer;
+    QCOMPARE(outOfOrder, (qint64) 0);
+}
+
+void TestAutonomX::test_dropOldestRing()
+{
+    // against a queue, on a single thread
+    DropOldestRing<qint64> ring(3);
+    std::deque<qint64> expected;
+    const size_t capacity = 4;
+    quint64 dropped = 0;
+    std::mt19937 random(6);
+    for(qint64 i = 0; i < 10000; i++) {
+        if(random() % 2) {
+            if(expected.size() == capacity) {
+                expected.pop_front();
+                dropped++;
+            }
+            *ring.acquire() = i;
+            ring.publish();
+            expected.push_back(i);
+        } else {
+            const qint64* value = ring.claim();
+            if(expected.empty()) {
+                QVERIFY(value == nullptr);
+            } else {
+                QVERIFY(value != nullptr);
+                QCOMPARE(*value, expected.front());
+                ring.release();
+                expected.pop_front();
+            }
+        }
+        QCOMPARE(ring.getDropped(), dropped);
+    }
+
+    // one producer that never waits for the consumer: elements arrive in order, and each one is either received or dropped
+    DropOldestRing<qint64> shared(16);
+    const qint64 count = 200000;
+    std::atomic<bool> done(false);
+    QThread* producer = QThread::create([&shared, &done, count]() {
+        for(qint64 i = 0; i < count; i++) {
+            *shared.acquire() = i;
+            shared.publish();
+        }
+        done.store(true);
+    });
+    producer->start();
+
+    qint64 received = 0;
+    qint64 last = -1;
+    qint64 outOfOrder = 0;
+    while(true) {
+        bool finished = done.load();
+        const qint64* value;
+        while((value = shared.claim()) != nullptr) {
+            outOfOrder += *value <= last;
+            last = *value;
+            shared.release();
+            received++;
+        }
+        if(finished) {
+            break;
+        }
+        QThread::yieldCurrentThread();
+    }
+    producer->wait();
+    delete producer;
+    QCOMPARE(outOfOrder, (qint64) 0);
+    QCOMPARE(last, count - 1);
+    QCOMPARE(received + (qint64) shared.getDropped(), count);
+}
+
+void TestAutonomX::test_synapseMatrixScale()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const int neuronCount = 60;
+
+    // random synapses, added in random order
+    std::vector<std::pair<int, int>> pairs;
+    for(int source = 0; source < neuronCount; source++) {
+        for(int destination = 0; destination < neuronCount; destination++) {
+            if(uniform(random) < 0.2) {
+                pairs.push_back({source, destination});
+            }
+        }
+    }
+    std::shuffle(pairs.begin(), pairs.end(), random);
+    std::vector<double> pairWeights(pairs.size());
+
+    SynapseMatrix matrix;
+    matrix.clear(neuronCount);
+    for(size_t i = 0; i < pairs.size(); i++) {
+        pairWeights[i] = uniform(random) * 2 - 1;
+        matrix.add(pairs[i].first, pairs[i].second, pairWeights[i]);
+    }
+    matrix.build();
+    QCOMPARE(matrix.getSynapseCount(), (int) pairs.size());
+
+    // rows and columns
+    for(size_t i = 0; i < pairs.size(); i++) {
+        int synapse = matrix.find(pairs[i].first, pairs[i].second);
+        QVERIFY(synapse >= matrix.getRowBegin(pairs[i].first) && synapse < matrix.getRowEnd(pairs[i].first));
+        QCOMPARE(matrix.getDestination(synapse), pairs[i].second);
+        QCOMPARE(matrix.getWeight(synapse), pairWeights[i]);
+    }
+    for(int destination = 0; destination < neuronCount; destination++) {
+        for(int entry = matrix.getColumnBegin(destination); entry < matrix.getColumnEnd(destination); entry++) {
+            int source = matrix.getColumnSource(entry);
+            QCOMPARE(matrix.getColumnSynapse(entry), matrix.find(source, destination));
+            if(entry > matrix.getColumnBegin(destination)) {
+                QVERIFY(matrix.getColumnSource(entry - 1) < source);
+            }
+        }
+    }
+
+    // scaling and writes, against the effective weights kept in full. small factors start new epochs
+    int synapseCount = matrix.getSynapseCount();
+    std::vector<double> expected(synapseCount);
+    std::vector<bool> scaled(synapseCount);
+    for(int synapse = 0; synapse < synapseCount; synapse++) {
+        expected[synapse] = matrix.getWeight(synapse);
+        scaled[synapse] = random() % 2;
+        matrix.setScaled(synapse, scaled[synapse]);
+    }
+
+    int mismatches = 0;
+    for(int iteration = 0; iteration < 2000; iteration++) {
+        // new weights every now and then, so that the scaled ones never underflow
+        if(iteration % 50 == 0) {
+            for(int synapse = 0; synapse < synapseCount; synapse++) {
+                expected[synapse] = uniform(random) * 2 - 1;
+                matrix.writeWeight(synapse, expected[synapse]);
+            }
+        }
+
+        int operation = random() % 10;
+        if(operation < 6) {
+            double factor = random() % 10 == 0 ? 1e-3 : 0.5 + 0.5 * uniform(random);
+            matrix.scale(factor);
+            for(int synapse = 0; synapse < synapseCount; synapse++) {
+                if(scaled[synapse]) {
+                    expected[synapse] *= factor;
+                }
+            }
+        } else if(operation < 9) {
+            int synapse = random() % synapseCount;
+            expected[synapse] = uniform(random) * 2 - 1;
+            matrix.writeWeight(synapse, expected[synapse]);
+        } else {
+            int synapse = random() % synapseCount;
+            scaled[synapse] = random() % 2;
+            matrix.setScaled(synapse, scaled[synapse]);
+        }
+
+        for(int synapse = 0; synapse < synapseCount; synapse++) {
+            mismatches += qAbs(matrix.getWeight(synapse) - expected[synapse]) > 1e-9 * qAbs(expected[synapse]);
+        }
+    }
+    QCOMPARE(mismatches, 0);
+}
+
+void TestAutonomX::test_philoxKnownAnswers()
+{
+    // known answer vectors of Philox4x32-10, from the Random123 distribution
+    struct Vector {
+        quint32 counter[4];
+        quint32 key[2];
+        quint32 output[4];
+    };
+    const Vector vectors[] = {
+        {{0x00000000, 0x00000000, 0x00000000, 0x00000000}, {0x00000000, 0x00000000}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}
+    };
+
+    for(const Vector& vector : vectors) {
+        quint32 output[4];
+        PhiloxRandom::generate(vector.counter, vector.key, output);
+        for(int i = 0; i < 4; i++) {
+            QCOMPARE(output[i], vector.output[i]);
+        }
+    }
+}
+
+void TestAutonomX::test_stateRoundTrip()
+{
+    std::mt19937 random(8);
+
+    // plain values and arrays
+    StateWriter writer;
+    std::vector<quint64> words(100);
+    for(quint64& word : words) {
+        word = ((quint64) random() << 32) | random();
+    }
+    writer.writeValue((qint32) -7);
+    writer.writeValue((char) 'x');
+    writer.writeArray(words.data(), (qint64) words.size());
+    writer.writeValue(0.25);
+
+    const uchar* data = reinterpret_cast<const uchar*>(writer.getData().constData());
+    StateReader reader(data, writer.getData().size());
+    qint32 integer;
+    char character;
+    double real;
+    QVERIFY(reader.readValue(integer));
+    QCOMPARE(integer, (qint32) -7);
+    QVERIFY(reader.readValue(character));
+    QCOMPARE(character, 'x');
+    const quint64* savedWords = reader.readArray<quint64>((qint64) words.size());
+    QVERIFY(savedWords != nullptr);
+    QCOMPARE((qint64) (reinterpret_cast<const uchar*>(savedWords) - data) % stateAlignment, (qint64) 0);
+    QVERIFY(std::equal(words.begin(), words.end(), savedWords));
+    QVERIFY(reader.readValue(real));
+    QCOMPARE(real, 0.25);
+    QVERIFY(reader.isValid());
+
+    // an array of another size is refused
+    StateReader wrongCount(data, writer.getData().size());
+    wrongCount.readValue(integer);
+    wrongCount.readValue(character);
+    QVERIFY(wrongCount.readArray<quint64>((qint64) words.size() + 1) == nullptr);
+    QVERIFY(!wrongCount.isValid());
+
+    // a world and a network, written to blobs and read back
+    HashLife world;
+    randomWorld(world, random);
+    StateWriter worldWriter;
+    world.writeState(worldWriter);
+
+    SynapseMatrix matrix;
+    randomMatrix(matrix, random);
+    StateWriter matrixWriter;
+    matrix.writeState(matrixWriter);
+
+    // the blobs follow the project data in the file, then the table of the state section
+    QByteArray cbor(37, 'c');
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    buffer.write(cbor);
+    QList<QPair<int, QByteArray>> blobs;
+    blobs.append(qMakePair(3, worldWriter.getData()));
+    blobs.append(qMakePair(5, matrixWriter.getData()));
+    QVERIFY(StateSnapshot::write(buffer, cbor.size(), blobs));
+
+    const QByteArray& file = buffer.data();
+    const uchar* fileData = reinterpret_cast<const uchar*>(file.constData());
+    QHash<int, QPair<qint64, qint64>> found;
+    QCOMPARE(StateSnapshot::read(fileData, file.size(), found), (qint64) cbor.size());
+    QCOMPARE(found.size(), 2);
+    QVERIFY(found.contains(3));
+    QVERIFY(found.contains(5));
+    QCOMPARE(found.value(3).first % stateAlignment, (qint64) 0);
+    QCOMPARE(found.value(5).first % stateAlignment, (qint64) 0);
+
+    HashLife restoredWorld;
+    StateReader worldReader(fileData + found.value(3).first, found.value(3).second);
+    QVERIFY(restoredWorld.readState(worldReader));
+    QCOMPARE(restoredWorld.getGeneration(), world.getGeneration());
+    world.step(1);
+    restoredWorld.step(1);
+    int mismatches = 0;
+    for(int y = -32; y < 32; y++) {
+        for(int x = -32; x < 32; x++) {
+            mismatches += restoredWorld.getCell(x, y) != world.getCell(x, y);
+        }
+    }
+    QCOMPARE(mismatches, 0);
+
+    SynapseMatrix restoredMatrix;
+    StateReader matrixReader(fileData + found.value(5).first, found.value(5).second);
+    QVERIFY(restoredMatrix.readState(matrixReader));
+    QCOMPARE(restoredMatrix.getSynapseCount(), matrix.getSynapseCount());
+    matrix.scale(0.5);
+    restoredMatrix.scale(0.5);
+    for(int synapse = 0; synapse < matrix.getSynapseCount(); synapse++) {
+        QCOMPARE(restoredMatrix.getDestination(synapse), matrix.getDestination(synapse));
+        QCOMPARE(restoredMatrix.getWeight(synapse), matrix.getWeight(synapse));
+    }
+}
+
+void TestAutonomX::test_stateTruncated()
+{
+    std::mt19937 random(9);
+    HashLife world;
+    randomWorld(world, random);
+    StateWriter worldWriter;
+    world.writeState(worldWriter);
+
+    SynapseMatrix matrix;
+    randomMatrix(matrix, random);
+    StateWriter matrixWriter;
+    matrix.writeState(matrixWriter);
+
+    // every blob cut short is rejected
+    const QByteArray& worldData = worldWriter.getData();
+    for(qint64 size : {(qint64) 0, (qint64) 4, (qint64) worldData.size() / 2, (qint64) worldData.size() - 1}) {
+        HashLife restored;
+        StateReader reader(reinterpret_cast<const uchar*>(worldData.constData()), size);
+        QVERIFY(!restored.readState(reader));
+        QCOMPARE(restored.getNodeCount(), HashLife().getNodeCount());
+    }
+    const QByteArray& matrixData = matrixWriter.getData();
+    for(qint64 size : {(qint64) 0, (qint64) 4, (qint64) matrixData.size() / 2, (qint64) matrixData.size() - 1}) {
+        SynapseMatrix restored;
+        StateReader reader(reinterpret_cast<const uchar*>(matrixData.constData()), size);
+        QVERIFY(!restored.readState(reader));
+    }
+
+    // a file cut short has no trailer, and is read as plain project data
+    QByteArray cbor(64, 'c');
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    buffer.write(cbor);
+    QList<QPair<int, QByteArray>> blobs;
+    blobs.append(qMakePair(1, worldData));
+    QVERIFY(StateSnapshot::write(buffer, cbor.size(), blobs));
+    const QByteArray& file = buffer.data();
+    QHash<int, QPair<qint64, qint64>> found;
+    QCOMPARE(StateSnapshot::read(reinterpret_cast<const uchar*>(file.constData()), file.size() - 1, found), (qint64) file.size() - 1);
+    QVERIFY(found.isEmpty());
+
+    // a table offset past the end of the file
+    QByteArray damaged = file;
+    quint64 tableOffset = damaged.size();
+    std::memcpy(damaged.data() + damaged.size() - 16, &tableOffset, sizeof(tableOffset));
+    QCOMPARE(StateSnapshot::read(reinterpret_cast<const uchar*>(damaged.constData()), damaged.size(), found), (qint64) damaged.size());
+    QVERIFY(found.isEmpty());
+}
@@ -9,4 +9,19 @@ class TestAutonomX: public QObject
 
 private slots:
     void test_something();
+
+    // the compute kernels, against straightforward implementations on random inputs
+    void test_hashLifeAgainstNaiveLife();
+    void test_lifeRuleParse();
+    void test_lifeRuleStepWord();
+    void test_wolframRuleDigits();
+    void test_wolframRuleStep();
+    void test_spscRing();
+    void test_dropOldestRing();
+    void test_synapseMatrixScale();
+    void test_philoxKnownAnswers();
+
+    // binary state saved after the project data
+    void test_stateRoundTrip();
+    void test_stateTruncated();
 };
@@ -3,7 +3,7 @@ QT += core
 QT -= gui
 
 CONFIG += sdk_no_version_check
-CONFIG += c++11
+CONFIG += c++17
 
 TARGET = test_autonomx
 CONFIG += console
@@ -12,7 +12,13 @@ CONFIG -= app_bundle
 TEMPLATE = app
 
 SOURCES += main.cpp \
-    TestAutonomX.cpp
+    TestAutonomX.cpp \
+    ../autonomx/HashLife.cpp \
+    ../autonomx/LifeRule.cpp \
+    ../autonomx/PhiloxRandom.cpp \
+    ../autonomx/StateSnapshot.cpp \
+    ../autonomx/SynapseMatrix.cpp \
+    ../autonomx/WolframRule.cpp
 
 HEADERS += \
     TestAutonomX.h